@@ -0,0 +1,712 @@
+#include "bus.hpp"
+#include "log.hpp"
+
+#include <cstdio>
+#include <chrono>
+#include <new>
+
+namespace MobSpkr {
+
+    void * Bus::operator new(std::size_t size) {
+        void * ptr = NULL;
+        if (posix_memalign(&ptr, alignof(Bus), size) != 0)
+            throw std::bad_alloc();
+        return ptr;
+    }
+
+    void Bus::operator delete(void * ptr) {
+        std::free(ptr);
+    }
+
+    bool Bus::open(int baudrate, int bits, enum sp_parity parity, int stopbits, enum sp_flowcontrol flowcontrol) {
+
+        close();
+
+        enum sp_return r;
+
+        if ( (r = sp_get_port_by_name(m_portname, &m_port)) != SP_OK){
+            Log::error("sp_get_port_by_name(%s): %d\n", m_portname, r);
+            goto open_failed;
+        }
+
+        if ( (r = sp_open(m_port, SP_MODE_READ_WRITE)) != SP_OK){
+            Log::error("sp_open(%s): %d\n", m_portname, r);
+            goto open_failed;
+        }
+
+        if ( (r = sp_set_baudrate(m_port, baudrate)) != SP_OK){
+            Log::error("set_baudrate(%s, %d): %d\n", m_portname, baudrate, r);
+            goto open_failed;
+        }
+
+        if ( (r = sp_set_bits(m_port, bits)) != SP_OK){
+            Log::error("sp_set_bits(%s, %d): %d\n", m_portname, bits, r);
+            goto open_failed;
+        }
+
+        if ( (r = sp_set_parity(m_port, parity)) != SP_OK){
+            Log::error("sp_set_parity(%s, %d): %d\n", m_portname, parity, r);
+            goto open_failed;
+        }
+
+        if ( (r = sp_set_stopbits(m_port, stopbits)) != SP_OK){
+            Log::error("sp_set_stopbits(%s, %d): %d\n", m_portname, stopbits, r);
+            goto open_failed;
+        }
+
+        if ( (r = sp_set_flowcontrol(m_port, flowcontrol)) != SP_OK){
+            Log::error("sp_set_flowcontrol(%s, %d): %d\n", m_portname, flowcontrol, r);
+            goto open_failed;
+        }
+
+
+        return true;
+
+    open_failed:
+
+        sp_free_port(m_port);
+        m_port = NULL;
+
+        return false;
+    }
+
+    void Bus::close() {
+        stop();
+
+        if (m_port) {
+            sp_close(m_port);
+            sp_free_port(m_port);
+            m_port = NULL;
+        }
+    }
+
+    bool Bus::start() {
+        if (!is_open())
+            return false;
+
+        if (m_running.exchange(true))
+            return true;
+
+        m_polled = false;
+        m_last_rx = clock::now();
+        m_thread = std::thread(&Bus::run, this);
+
+        return true;
+    }
+
+    bool Bus::start_polled(std::function<void()> wakeup) {
+        if (!is_open())
+            return false;
+
+        if (m_running.load())
+            return m_polled;
+
+        m_polled = true;
+        m_poll_wakeup = std::move(wakeup);
+        m_last_rx = clock::now();
+        m_running.store(true);
+
+        return true;
+    }
+
+    void Bus::stop() {
+        if (!m_running.exchange(false))
+            return;
+
+        if (m_polled){
+            fail_all();
+            m_polled = false;
+        } else {
+            {
+                std::lock_guard<std::mutex> lock(m_wakeup_mutex);
+            }
+            m_wakeup.notify_one();
+
+            if (m_thread.joinable())
+                m_thread.join();
+        }
+
+        // fail whatever is left so nobody waits forever
+        Job job;
+        Response response;
+        while(m_queue.pop(job)){
+            complete(job, Response::Status::Error, response);
+        }
+        while(m_background.pop(job)){
+            complete(job, Response::Status::Error, response);
+        }
+    }
+
+    void Bus::wakeup() {
+        if (m_polled){
+            if (m_poll_wakeup)
+                m_poll_wakeup();
+            return;
+        }
+
+        // pairs with the fence in wait_for_work(): either we see it idle, or it sees the job just queued
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_idle.load(std::memory_order_relaxed)){
+            {
+                std::lock_guard<std::mutex> lock(m_wakeup_mutex);
+            }
+            m_wakeup.notify_one();
+        }
+    }
+
+    void Bus::wait_for_work() {
+        m_idle.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        std::unique_lock<std::mutex> lock(m_wakeup_mutex);
+        m_wakeup.wait(lock, [this]{ return !m_queue.empty() || !m_background.empty() || !m_running.load(); });
+
+        m_idle.store(false, std::memory_order_relaxed);
+    }
+
+    int Bus::get_fd() const {
+        int fd = -1;
+        if (m_port == NULL || sp_get_port_handle(m_port, &fd) != SP_OK)
+            return -1;
+        return fd;
+    }
+
+    static uint32_t micros(Bus::clock::duration d) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    }
+
+    void Bus::complete(Job & job, Response::Status status, const Response & response) {
+        if (job.motor && !job.background)
+            job.motor->m_pending--;
+
+        if (status == Response::Status::Error)
+            m_error_count++;
+
+        // superseded ones never made it to the port
+        if (status != Response::Status::Superseded){
+            clock::time_point now = clock::now();
+
+            if (job.motor){
+                uint8_t command_number = job.command.command_number();
+                if (status == Response::Status::Success || status == Response::Status::CommandLoadedIntoEEPROM)
+                    job.motor->m_metrics.record(command_number, micros(job.written - job.queued), micros(now - job.written), micros(now - job.queued));
+                else
+                    job.motor->m_metrics.record_error(command_number);
+            }
+
+            // not if failed before it was written
+            if (m_capture && job.written != clock::time_point())
+                m_capture->record(m_capture_port, job.command.bytes(), response.bytes(), status, job.written, now, job.attempt);
+        }
+
+        if (job.callback)
+            job.callback(status, response);
+    }
+
+    void Bus::sample_rtt(std::chrono::steady_clock::duration rtt) {
+        unsigned int r = std::chrono::duration_cast<std::chrono::microseconds>(rtt).count();
+        unsigned int srtt = m_srtt_us.load();
+
+        if (srtt == 0){
+            srtt = r;
+            m_rttvar_us = r / 2;
+        } else {
+            unsigned int delta = srtt > r ? srtt - r : r - srtt;
+            m_rttvar_us = (3 * m_rttvar_us + delta) / 4;
+            srtt = (7 * srtt + r) / 8;
+        }
+        m_srtt_us.store(srtt);
+
+        unsigned int rto = srtt + 4 * m_rttvar_us;
+        if (rto < MIN_RTO_US)
+            rto = MIN_RTO_US;
+        if (rto > MAX_RTO_US)
+            rto = MAX_RTO_US;
+        m_rto_us.store(rto);
+    }
+
+    void Bus::back_off() {
+        m_timeout_count++;
+
+        // until the next reply says otherwise, the link is slower than we thought
+        unsigned int rto = 2 * m_rto_us.load();
+        m_rto_us.store(rto > MAX_RTO_US ? MAX_RTO_US : rto);
+    }
+
+    std::chrono::microseconds Bus::timeout_of(const Job & job) const {
+        if (job.timeout_ms != Motor::ADAPTIVE_TIMEOUT)
+            return std::chrono::milliseconds(job.timeout_ms);
+
+        unsigned int timeout_us = m_rto_us.load() << job.attempt;
+        return std::chrono::microseconds(timeout_us > MAX_RTO_US ? MAX_RTO_US : timeout_us);
+    }
+
+    bool Bus::may_retry(const Job & job) const {
+        return job.timeout_ms == Motor::ADAPTIVE_TIMEOUT
+            && job.attempt < m_retries.load()
+            && TMCL::is_query(job.command.command_number());
+    }
+
+    // libserialport takes 0 as no timeout at all
+    static unsigned int to_ms(std::chrono::microseconds timeout){
+        return (timeout.count() + 999) / 1000 + 1;
+    }
+
+    bool Bus::enqueue(Job && job) {
+        if (!is_running())
+            return false;
+
+        job.queued = clock::now();
+
+        if (job.background){
+            // the poller will simply try again
+            if (!m_background.push(std::move(job)))
+                return false;
+        } else if (!m_queue.push(std::move(job))){
+            Log::warning("bus %s: command queue full\n", m_portname);
+            return false;
+        }
+
+        wakeup();
+
+        return true;
+    }
+
+    Bus::Job Bus::take(unsigned int i) {
+        Job job = std::move(m_inflight[i]);
+        for(unsigned int j = i + 1; j < m_inflight_count; j++){
+            m_inflight[j - 1] = std::move(m_inflight[j]);
+            m_sent[j - 1] = m_sent[j];
+            m_deadline[j - 1] = m_deadline[j];
+        }
+        m_inflight_count--;
+        m_inflight[m_inflight_count] = Job();
+
+        if (i < m_tx_first)
+            m_tx_first--;
+
+        return job;
+    }
+
+    void Bus::finish(unsigned int i, Response::Status status, const Response & response) {
+        Job job = take(i);
+        complete(job, status, response);
+    }
+
+    void Bus::fail_all() {
+        Response response;
+        while(m_inflight_count > 0)
+            finish(0, Response::Status::Error, response);
+        for(unsigned int i = 0; i < m_resend_count; i++){
+            Job job = std::move(m_resend[i]);
+            m_resend[i] = Job();
+            complete(job, Response::Status::Error, response);
+        }
+        m_resend_count = 0;
+        m_resyncing = false;
+        m_tx_len = m_tx_done = 0;
+        m_tx_first = 0;
+        m_rx_len = 0;
+    }
+
+    void Bus::resync(uint8_t module) {
+        m_probe = Job();
+        m_probe.command = Command(module, TMCL::GetVersion, 1, 0, 0);
+        m_probe.timeout_ms = Motor::ADAPTIVE_TIMEOUT;
+        m_resyncing = true;
+    }
+
+    Bus::clock::time_point Bus::quiet_until() const {
+        return m_last_rx + std::chrono::microseconds(m_turnaround_us.load());
+    }
+
+    // top up the window, all new commands go out in one write
+    void Bus::fill() {
+        bool half_duplex = m_half_duplex.load();
+        unsigned int window = half_duplex ? 1 : m_window.load();
+
+        m_tx_first = m_inflight_count;
+        m_tx_len = m_tx_done = 0;
+
+        if (m_resyncing){
+            if (m_inflight_count == 0){
+                m_inflight[0] = m_probe;
+                std::memcpy(m_tx, m_probe.command.bytes(), Command::SIZE);
+                m_tx_len = Command::SIZE;
+                m_deadline[0] = clock::now() + timeout_of(m_probe);
+                m_inflight_count = 1;
+            }
+            return;
+        }
+
+        unsigned int resent = 0;
+        while(m_inflight_count < window){
+            if (resent < m_resend_count){
+                m_inflight[m_inflight_count] = std::move(m_resend[resent]);
+                m_resend[resent++] = Job();
+            } else if (!m_queue.pop(m_inflight[m_inflight_count])){
+                if (m_inflight_count > 0 || !m_background.pop(m_inflight[m_inflight_count]))
+                    break;
+            }
+
+            Job & job = m_inflight[m_inflight_count];
+
+            // when polled, all buses are driven by the same thread and thus sent back to back anyway
+            if (job.sync && job.sync->id() != m_synced && !m_polled){
+                m_synced = job.sync->id();
+                if (half_duplex)
+                    std::this_thread::sleep_until(quiet_until());
+                job.sync->arrive(to_ms(timeout_of(job)));
+            }
+
+            if (job.generation != 0 && job.motor && job.generation != job.motor->m_setpoint_generation.load()){
+                job.motor->m_superseded_count++;
+                Response response;
+                response.set_status(Response::Status::Superseded);
+                Job superseded = std::move(job);
+                job = Job();
+                complete(superseded, Response::Status::Superseded, response);
+                continue;
+            }
+
+            std::memcpy(m_tx + m_tx_len, job.command.bytes(), Command::SIZE);
+            m_tx_len += Command::SIZE;
+            // until written
+            m_deadline[m_inflight_count] = clock::now() + timeout_of(job);
+            m_inflight_count++;
+
+            // the others are just being released, don't linger
+            if (job.sync)
+                break;
+        }
+
+        for(unsigned int i = resent; i < m_resend_count; i++){
+            m_resend[i - resent] = std::move(m_resend[i]);
+            m_resend[i] = Job();
+        }
+        m_resend_count -= resent;
+    }
+
+    void Bus::written() {
+        // don't talk over the reply (the event loop can't afford to wait, the adapter has to take care)
+        if (m_half_duplex.load() && !m_polled)
+            sp_drain(m_port);
+
+        clock::time_point now = clock::now();
+        m_bytes_tx += m_tx_len;
+
+        for(unsigned int i = m_tx_first; i < m_inflight_count; i++){
+            m_inflight[i].written = now;
+            m_sent[i] = now;
+            m_deadline[i] = now + timeout_of(m_inflight[i]);
+            if (m_inflight[i].sync)
+                m_inflight[i].sync->sent(now);
+        }
+
+        m_tx_len = m_tx_done = 0;
+        m_tx_first = m_inflight_count;
+    }
+
+    void Bus::write_failed() {
+        // partially written frames would desync the module, start over
+        sp_flush(m_port, SP_BUF_BOTH);
+        fail_all();
+    }
+
+    void Bus::read_failed() {
+        fail_all();
+    }
+
+    void Bus::received(std::size_t len) {
+        m_rx_len += len;
+        if (len > 0)
+            m_last_rx = clock::now();
+        m_bytes_rx += len;
+
+        std::size_t offset = 0;
+        bool resyncing = false;
+        while(m_rx_len - offset >= (std::size_t)Response::SIZE){
+            Response response;
+            response.set(m_rx + offset);
+
+            if (!response.valid()){
+                // lost framing, resync byte by byte
+                if (!resyncing)
+                    m_checksum_errors++;
+                resyncing = true;
+                offset++;
+                continue;
+            }
+            resyncing = false;
+            offset += Response::SIZE;
+
+            if (m_resyncing){
+                if (m_tx_first == 0 || response.module() != m_probe.command.bytes()[Command::ADDRESS] || response.command_number() != TMCL::GetVersion){
+                    Log::info("bus %s: dropped late reply (module %d, command %d)\n", m_portname, response.module(), response.command_number());
+                    m_late_count++;
+                    continue;
+                }
+                // in step again (no RTT sample, it waited behind the late ones)
+                m_resyncing = false;
+                finish(0, response.status(), response);
+                continue;
+            }
+
+            unsigned int i = 0;
+            while(i < m_tx_first &&
+                    (m_inflight[i].command.bytes()[Command::ADDRESS] != response.module() ||
+                     m_inflight[i].command.bytes()[Command::COMMAND_NUMBER] != response.command_number())){
+                i++;
+            }
+
+            // that of an earlier probe, given up on
+            if (i == m_tx_first && response.command_number() == TMCL::GetVersion){
+                Log::info("bus %s: dropped late reply (module %d, command %d)\n", m_portname, response.module(), response.command_number());
+                m_late_count++;
+                continue;
+            }
+
+            if (i == m_tx_first){
+                Log::warning("bus %s: unmatched reply (module %d, command %d)\n", m_portname, response.module(), response.command_number());
+                continue;
+            }
+
+            // replies to repeated queries are ambiguous (Karn's algorithm)
+            if (m_inflight[i].attempt == 0)
+                sample_rtt(m_last_rx - m_sent[i]);
+
+            finish(i, response.status(), response);
+
+            // the module answers in order, the clock of a pipelined command starts once the one before is answered
+            for(unsigned int j = 0; j < m_tx_first; j++){
+                if (m_sent[j] < m_last_rx){
+                    m_sent[j] = m_last_rx;
+                    m_deadline[j] = m_last_rx + timeout_of(m_inflight[j]);
+                }
+            }
+        }
+
+        if (offset > 0){
+            std::memmove(m_rx, m_rx + offset, m_rx_len - offset);
+            m_rx_len -= offset;
+        }
+
+        if (len > 0 && m_rx_len > 0)
+            m_short_reads++;
+    }
+
+    // handles the oldest command in flight timing out, false if it hasn't
+    bool Bus::expire(clock::time_point now) {
+        if (m_inflight_count == 0 || now < m_deadline[0])
+            return false;
+
+        uint8_t module = m_inflight[0].command.bytes()[Command::ADDRESS];
+
+        if (wants_write()){
+            Log::warning("bus %s: write timeout\n", m_portname);
+            back_off();
+            // replies to those written before may yet come
+            bool pending = m_tx_first > 0;
+            write_failed();
+            if (pending)
+                resync(module);
+            return true;
+        }
+
+        Log::warning("bus %s: timeout (module %d, command %d)\n", m_portname, module, m_inflight[0].command.bytes()[Command::COMMAND_NUMBER]);
+        m_last_rx = now;
+        back_off();
+
+        Response response;
+
+        if (m_resyncing){
+            Job probe = take(0);
+            if (may_retry(probe)){
+                m_retry_count++;
+                m_probe.attempt = probe.attempt + 1;
+                return true;
+            }
+
+            // nothing answers at all, whatever might still come is given up on
+            complete(probe, Response::Status::Error, response);
+            sp_flush(m_port, SP_BUF_INPUT);
+            m_rx_len = 0;
+            m_resyncing = false;
+            return true;
+        }
+
+        // its reply may yet come, and would be taken for the next alike: queries in flight are asked again
+        // once the late replies are out of the way, the others (which may have been executed) fail
+        while(m_inflight_count > 0){
+            Job job = take(0);
+            if (may_retry(job)){
+                m_retry_count++;
+                job.attempt++;
+                m_resend[m_resend_count++] = std::move(job);
+            } else {
+                complete(job, Response::Status::Error, response);
+            }
+        }
+        m_tx_first = 0;
+        resync(module);
+        return true;
+    }
+
+    void Bus::run() {
+
+        while(m_running.load()){
+
+            fill();
+
+            if (wants_write()){
+                if (m_half_duplex.load()){
+                    // give the previous sender time to release the line
+                    std::this_thread::sleep_until(quiet_until());
+                }
+
+                int r = sp_blocking_write(m_port, m_tx, m_tx_len, to_ms(timeout_of(m_inflight[m_tx_first])));
+                if (r < (int)m_tx_len){
+                    Log::error("sp_blocking_write(): %d\n", r);
+                    write_failed();
+                    continue;
+                }
+                m_tx_done = m_tx_len;
+                written();
+            }
+
+            if (m_inflight_count == 0){
+                wait_for_work();
+                continue;
+            }
+
+            // wait for replies; new commands are picked up as soon as any reply arrives
+            clock::time_point now = clock::now();
+            if (expire(now))
+                continue;
+
+            unsigned int remaining_ms = to_ms(std::chrono::duration_cast<std::chrono::microseconds>(m_deadline[0] - now));
+
+            int r = sp_blocking_read_next(m_port, m_rx + m_rx_len, sizeof(m_rx) - m_rx_len, remaining_ms);
+            if (r < 0){
+                Log::error("sp_blocking_read_next(): %d\n", r);
+                read_failed();
+                continue;
+            }
+            received(r);
+        }
+
+        fail_all();
+    }
+
+    void Bus::process(bool readable) {
+        if (!m_running.load() || !m_polled)
+            return;
+
+        if (readable){
+            int r = sp_nonblocking_read(m_port, m_rx + m_rx_len, sizeof(m_rx) - m_rx_len);
+            if (r < 0){
+                Log::error("sp_nonblocking_read(): %d\n", r);
+                read_failed();
+            } else if (r > 0){
+                received(r);
+            }
+        }
+
+        clock::time_point now = clock::now();
+        while(expire(now))
+            ;
+
+        if (!wants_write() && !(m_half_duplex.load() && now < quiet_until()))
+            fill();
+
+        if (wants_write()){
+            int r = sp_nonblocking_write(m_port, m_tx + m_tx_done, m_tx_len - m_tx_done);
+            if (r < 0){
+                Log::error("sp_nonblocking_write(): %d\n", r);
+                write_failed();
+                return;
+            }
+            m_tx_done += r;
+            if (!wants_write())
+                written();
+        }
+    }
+
+    bool Bus::next_deadline(clock::time_point & deadline) const {
+        bool any = false;
+
+        if (m_inflight_count > 0){
+            deadline = m_deadline[0];
+            any = true;
+        }
+
+        // waiting for the line to be released
+        if (m_resyncing || m_resend_count > 0 || (m_half_duplex.load() && !wants_write() && !(m_queue.empty() && m_background.empty()))){
+            clock::time_point quiet = quiet_until();
+            if (!any || quiet < deadline)
+                deadline = quiet;
+            any = true;
+        }
+
+        return any;
+    }
+
+    Bus::Response::Status Bus::transfer(const uint8_t * command, uint8_t * response, unsigned int timeout_ms) {
+        if (!is_open()){
+            Log::error("is not open?\n");
+            return Response::Status::Error;
+        }
+
+        typedef std::chrono::steady_clock clock;
+
+        Job job;
+        job.command = Command(command);
+        job.timeout_ms = timeout_ms;
+
+        while(true){
+            int r;
+            unsigned int attempt_ms = to_ms(timeout_of(job));
+
+            if ( (r = sp_blocking_write(m_port, command, Command::SIZE, attempt_ms)) < Command::SIZE ){
+                Log::error("sp_blocking_write(): %d\n", r);
+                return Response::Status::Error;
+            }
+
+            if (is_half_duplex())
+                sp_drain(m_port);
+
+            clock::time_point sent = clock::now();
+
+            if ( (r = sp_blocking_read(m_port, response, Response::SIZE, attempt_ms)) < Response::SIZE ){
+                Log::error("sp_blocking_read(): %d\n", r);
+                back_off();
+
+                // a late reply must not be taken for the next one
+                sp_flush(m_port, SP_BUF_INPUT);
+
+                if (r < 0 || !may_retry(job)){
+                    if (m_capture)
+                        m_capture->record(m_capture_port, command, NULL, Response::Status::Error, sent, clock::now(), job.attempt);
+                    return Response::Status::Error;
+                }
+
+                m_retry_count++;
+                job.attempt++;
+                continue;
+            }
+
+            clock::time_point now = clock::now();
+            if (job.attempt == 0)
+                sample_rtt(now - sent);
+
+            if (m_capture)
+                m_capture->record(m_capture_port, command, response, response[Response::STATUS], sent, now, job.attempt);
+
+            if (is_half_duplex() && m_turnaround_us.load() > 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(m_turnaround_us.load()));
+
+            return (Response::Status)response[Response::STATUS];
+        }
+    }
+
+}
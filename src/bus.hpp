@@ -0,0 +1,285 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_BUS_HPP
+#define MOBSPKR_VEHICLE_CTRL_BUS_HPP
+
+#include "motor.hpp"
+#include "sync.hpp"
+#include "capture.hpp"
+
+#include <chrono>
+
+namespace MobSpkr {
+
+/**
+ * A serial port and the state machine driving it, either from an I/O thread of its own (start())
+ * or from an event loop that watches the port along with others (start_polled(), see Reactor).
+ *
+ * Usually a bus carries a single module (USB), but any number of modules with distinct addresses may
+ * share a half-duplex RS485 bus: then only one transaction is on the line at a time, the transmitter
+ * is drained before listening and a turnaround pause separates a reply from the next command.
+ */
+class Bus {
+
+    public:
+
+        typedef std::chrono::steady_clock clock;
+
+        typedef Motor::Command Command;
+        typedef Motor::Response Response;
+        typedef Motor::Callback Callback;
+
+        const static std::size_t QUEUE_SIZE = 64;
+        const static std::size_t BACKGROUND_QUEUE_SIZE = 16;
+
+        // upper limit of commands in flight (ie sent, but not yet answered) on the port
+        const static unsigned int MAX_WINDOW = 8;
+
+        // bounds of the adaptive timeout, which starts out at INITIAL_RTO_US until the first reply
+        const static unsigned int INITIAL_RTO_US = 250000;
+        const static unsigned int MIN_RTO_US = 20000;
+        const static unsigned int MAX_RTO_US = 1000000;
+
+        const static unsigned int DEFAULT_RETRIES = 2;
+
+        struct Job {
+            Motor * motor = NULL;
+            Command command;
+            unsigned int timeout_ms = 0;
+            Callback callback;
+            // non-zero for setpoints that may be superseded
+            uint32_t generation = 0;
+            // held back until all buses of the group are ready, then sent right away
+            std::shared_ptr<SyncGroup> sync;
+            // retries so far (adaptive timeouts only)
+            unsigned int attempt = 0;
+            // only sent while nothing else is queued or in flight (eg telemetry)
+            bool background = false;
+            // for the metrics
+            clock::time_point queued;
+            clock::time_point written;
+        };
+
+    protected:
+
+        char * m_portname;
+        struct sp_port * m_port;
+
+        Queue<Job, QUEUE_SIZE> m_queue;
+        Queue<Job, BACKGROUND_QUEUE_SIZE> m_background;
+
+        std::thread m_thread;
+        std::atomic<bool> m_running{false};
+        std::atomic<bool> m_idle{false};
+        std::mutex m_wakeup_mutex;
+        std::condition_variable m_wakeup;
+
+        std::atomic<unsigned int> m_window{1};
+        std::atomic<bool> m_half_duplex{false};
+        std::atomic<unsigned int> m_turnaround_us{0};
+
+        // round-trip time estimate (as for TCP, RFC 6298), only updated by whoever does the I/O
+        std::atomic<unsigned int> m_srtt_us{0};
+        unsigned int m_rttvar_us = 0;
+        std::atomic<unsigned int> m_rto_us{INITIAL_RTO_US};
+        std::atomic<unsigned int> m_retries{DEFAULT_RETRIES};
+        std::atomic<uint32_t> m_timeout_count{0};
+        std::atomic<uint32_t> m_retry_count{0};
+
+        std::atomic<uint64_t> m_bytes_tx{0};
+        std::atomic<uint64_t> m_bytes_rx{0};
+        std::atomic<uint32_t> m_checksum_errors{0};
+        std::atomic<uint32_t> m_short_reads{0};
+        std::atomic<uint32_t> m_error_count{0};
+        std::atomic<uint32_t> m_late_count{0};
+
+        Capture * m_capture = NULL;
+        int m_capture_port = -1;
+
+        // without I/O thread: called whenever there is new work
+        bool m_polled = false;
+        std::function<void()> m_poll_wakeup;
+
+        // I/O state, only touched by whoever drives the bus
+
+        // commands in flight, oldest first; those from m_tx_first on are (still) in m_tx
+        Job m_inflight[MAX_WINDOW];
+        clock::time_point m_sent[MAX_WINDOW];
+        clock::time_point m_deadline[MAX_WINDOW];
+        unsigned int m_inflight_count = 0;
+
+        // what was in flight when a command timed out, to be sent again before anything else (oldest first)
+        Job m_resend[MAX_WINDOW];
+        unsigned int m_resend_count = 0;
+
+        // after a timeout, the only command sent until answered: the module answers in order and replies are
+        // matched by address and command number only, so whatever comes in before its reply is late and dropped
+        Job m_probe;
+        bool m_resyncing = false;
+
+        uint8_t m_tx[MAX_WINDOW * Command::SIZE];
+        std::size_t m_tx_len = 0;
+        std::size_t m_tx_done = 0;
+        unsigned int m_tx_first = 0;
+
+        uint8_t m_rx[MAX_WINDOW * Response::SIZE];
+        std::size_t m_rx_len = 0;
+
+        // end of the last reply, for the turnaround of half-duplex buses
+        clock::time_point m_last_rx;
+
+        // last sync group this bus has met the others for
+        uint32_t m_synced = 0;
+
+        void run();
+        void wakeup();
+        void wait_for_work();
+        void complete(Job & job, Response::Status status, const Response & response);
+
+        Job take(unsigned int i);
+        void finish(unsigned int i, Response::Status status, const Response & response);
+        void fail_all();
+        void resync(uint8_t module);
+        void fill();
+        void written();
+        void write_failed();
+        void read_failed();
+        void received(std::size_t len);
+        bool expire(clock::time_point now);
+        clock::time_point quiet_until() const;
+
+        void sample_rtt(std::chrono::steady_clock::duration rtt);
+        void back_off();
+        std::chrono::microseconds timeout_of(const Job & job) const;
+        bool may_retry(const Job & job) const;
+
+    public:
+
+        Bus(const char * portname){
+            m_portname = portname ? strdup(portname) : NULL;
+            m_port = NULL;
+        }
+        Bus(const Bus &) = delete;
+        Bus & operator=(const Bus &) = delete;
+
+        // the queue is cache line aligned, which plain new doesn't respect before C++17
+        static void * operator new(std::size_t size);
+        static void operator delete(void * ptr);
+        ~Bus(){
+            close();
+            if (m_portname)
+                std::free(m_portname);
+        }
+
+        const char * get_portname() const { return m_portname; }
+
+        bool open(int baudrate = 9600, int bits = 8, enum sp_parity parity = SP_PARITY_NONE, int stopbits = 1, enum sp_flowcontrol flowcontrol = SP_FLOWCONTROL_NONE);
+        void close();
+
+        bool is_open() const { return m_port != NULL; }
+
+        /**
+         * Starts the I/O thread; from then on all transactions are serialized through the queue.
+         */
+        bool start();
+        void stop();
+
+        bool is_running() const { return m_running.load(); }
+
+        /**
+         * Starts without I/O thread, the caller then has to call process()
+         *  - whenever the port (get_fd()) is readable (or writable, if wants_write()),
+         *  - at next_deadline() and
+         *  - after wakeup has been called (from whatever thread queued a command).
+         */
+        bool start_polled(std::function<void()> wakeup);
+
+        bool is_polled() const { return m_polled; }
+
+        int get_fd() const;
+
+        void process(bool readable);
+
+        bool wants_write() const { return m_tx_done < m_tx_len; }
+
+        /**
+         * Next point in time process() wants to be called at, false if none.
+         */
+        bool next_deadline(clock::time_point & deadline) const;
+
+        /**
+         * Number of commands kept in flight; 1 (default) is plain stop-and-wait.
+         * Replies are matched to their command by module address and command number;
+         * after a timeout, late replies are skipped by sending a probe (GetVersion) and waiting for its reply.
+         * Ignored on half-duplex buses.
+         */
+        void set_window(unsigned int window){
+            if (window < 1)
+                window = 1;
+            if (window > MAX_WINDOW)
+                window = MAX_WINDOW;
+            m_window.store(window);
+        }
+        unsigned int get_window() const { return m_window.load(); }
+
+        /**
+         * Shared RS485 bus: one transaction at a time, with turnaround_us of silence after each reply.
+         */
+        void set_half_duplex(bool half_duplex, unsigned int turnaround_us = 0){
+            m_half_duplex.store(half_duplex);
+            m_turnaround_us.store(turnaround_us);
+        }
+        bool is_half_duplex() const { return m_half_duplex.load(); }
+
+        std::size_t queue_depth() const { return m_queue.size(); }
+
+        /**
+         * How often a timed out query (see TMCL::is_query()) with adaptive timeout is repeated,
+         * each time with twice the timeout.
+         */
+        void set_retries(unsigned int retries){ m_retries.store(retries); }
+        unsigned int get_retries() const { return m_retries.load(); }
+
+        // current adaptive timeout
+        unsigned int get_rto_us() const { return m_rto_us.load(); }
+        unsigned int get_srtt_us() const { return m_srtt_us.load(); }
+
+        uint32_t timeout_count() const { return m_timeout_count.load(); }
+        uint32_t retry_count() const { return m_retry_count.load(); }
+
+        uint64_t bytes_tx() const { return m_bytes_tx.load(); }
+        uint64_t bytes_rx() const { return m_bytes_rx.load(); }
+
+        // garbled replies, resynchronized on
+        uint32_t checksum_errors() const { return m_checksum_errors.load(); }
+
+        // reads ending within a reply, ie replies trickling in
+        uint32_t short_reads() const { return m_short_reads.load(); }
+
+        // commands failed (timed out or I/O error)
+        uint32_t error_count() const { return m_error_count.load(); }
+
+        // replies dropped while resynchronizing after a timeout
+        uint32_t late_count() const { return m_late_count.load(); }
+
+        /**
+         * Records every exchange from now on into capture (before start()).
+         */
+        void set_capture(Capture * capture){
+            m_capture = capture;
+            m_capture_port = capture ? capture->add_port(m_portname) : -1;
+        }
+
+        /**
+         * Hands job to the I/O thread (or event loop), false if not running or the queue is full.
+         * Background jobs get a queue of their own and never delay others by more than one round-trip.
+         */
+        bool enqueue(Job && job);
+
+        /**
+         * Blocking transaction, only to be used while the I/O thread is not running.
+         */
+        Response::Status transfer(const uint8_t * command, uint8_t * response, unsigned int timeout_ms);
+};
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_BUS_HPP
@@ -0,0 +1,128 @@
+#include "capture.hpp"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <cstring>
+
+namespace MobSpkr {
+
+    static_assert(sizeof(Capture::Entry) == 64, "one entry per cache line");
+
+    const char Capture::MAGIC[8] = {'M', 'S', 'P', 'K', 'T', 'M', 'C', 'L'};
+
+    bool Capture::open(std::size_t entries, const char * path) {
+        close();
+
+        std::size_t count = 1;
+        while(count < entries)
+            count <<= 1;
+
+        m_size = sizeof(Header) + count * sizeof(Entry);
+
+        void * map;
+        if (path){
+            int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0)
+                return false;
+            if (ftruncate(fd, m_size)){
+                ::close(fd);
+                return false;
+            }
+            map = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+        } else {
+            map = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+        if (map == MAP_FAILED)
+            return false;
+
+        // zero filled either way
+        m_map = (char *)map;
+        m_header = (Header *)m_map;
+        m_entries = (Entry *)(m_map + sizeof(Header));
+        m_mask = count - 1;
+
+        std::memcpy(m_header->magic, MAGIC, sizeof(m_header->magic));
+        m_header->version = VERSION;
+        m_header->entry_size = sizeof(Entry);
+        m_header->entries = count;
+        m_header->unix_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        m_header->steady_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now().time_since_epoch()).count();
+
+        m_next.store(0);
+        m_ports.store(0);
+
+        return true;
+    }
+
+    void Capture::close() {
+        if (m_map == NULL)
+            return;
+
+        munmap(m_map, m_size);
+        m_map = NULL;
+        m_header = NULL;
+        m_entries = NULL;
+    }
+
+    int Capture::add_port(const char * name) {
+        if (m_header == NULL)
+            return -1;
+
+        unsigned int port = m_ports.fetch_add(1);
+        if (port >= MAX_PORTS)
+            return -1;
+
+        std::strncpy(m_header->ports[port], name ? name : "", PORT_NAME_SIZE - 1);
+        return port;
+    }
+
+    void Capture::record(int port, const uint8_t * command, const uint8_t * response, unsigned int status,
+                         clock::time_point written, clock::time_point completed, unsigned int attempt) {
+        if (m_entries == NULL || port < 0)
+            return;
+
+        uint64_t sequence = m_next.fetch_add(1, std::memory_order_relaxed) + 1;
+        Entry & entry = m_entries[sequence & m_mask];
+
+        // invalid while being overwritten
+        entry.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        entry.written_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(written.time_since_epoch()).count();
+        entry.response_us = std::chrono::duration_cast<std::chrono::microseconds>(completed - written).count();
+        entry.status = status;
+        entry.port = port;
+        entry.attempt = attempt;
+        std::memcpy(entry.command, command, FRAME_SIZE);
+        if (response)
+            std::memcpy(entry.response, response, FRAME_SIZE);
+        else
+            std::memset(entry.response, 0, FRAME_SIZE);
+
+        entry.sequence.store(sequence, std::memory_order_release);
+    }
+
+    bool Capture::dump(const char * path) const {
+        if (m_map == NULL)
+            return false;
+
+        int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+
+        std::size_t done = 0;
+        while(done < m_size){
+            ssize_t n = ::write(fd, m_map + done, m_size - done);
+            if (n <= 0){
+                ::close(fd);
+                return false;
+            }
+            done += n;
+        }
+
+        return ::close(fd) == 0;
+    }
+
+}
@@ -0,0 +1,103 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_CAPTURE_HPP
+#define MOBSPKR_VEHICLE_CTRL_CAPTURE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace MobSpkr {
+
+/**
+ * The last so many TMCL commands and their replies as sent and received by the buses, with timestamps, port and
+ * status, kept in a fixed-size memory-mapped ring for when something went wrong (decoded by tmcl-decode).
+ *
+ * Recording an exchange claims a slot with one atomic increment and copies 64 bytes, once it has completed,
+ * from any thread. dump() writes the ring as is using only async-signal-safe calls, ie may be called from
+ * a signal handler. With a file given to open() the ring is that file, so it outlives a crash.
+ */
+class Capture {
+
+    public:
+
+        typedef std::chrono::steady_clock clock;
+
+        const static uint32_t VERSION = 1;
+        const static std::size_t DEFAULT_ENTRIES = 16384;
+        const static std::size_t MAX_PORTS = 16;
+        const static std::size_t PORT_NAME_SIZE = 64;
+        const static std::size_t FRAME_SIZE = 9;
+
+        static const char MAGIC[8];
+
+        struct Entry {
+            // 1, 2, .. in order of completion, 0 while (being) empty
+            std::atomic<uint64_t> sequence;
+            // steady clock (see Header) when the command was written
+            uint64_t written_ns;
+            // until answered or given up on
+            uint32_t response_us;
+            uint16_t status;
+            uint8_t port;
+            uint8_t attempt;
+            uint8_t command[FRAME_SIZE];
+            uint8_t response[FRAME_SIZE];
+            uint8_t reserved[22];
+        };
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t entry_size;
+            uint64_t entries;
+            // to convert entry times: wall clock at steady_ns
+            int64_t unix_ns;
+            int64_t steady_ns;
+            char ports[MAX_PORTS][PORT_NAME_SIZE];
+        };
+
+    protected:
+
+        char * m_map;
+        std::size_t m_size;
+        Header * m_header;
+        Entry * m_entries;
+        std::size_t m_mask;
+
+        std::atomic<uint64_t> m_next{0};
+        std::atomic<unsigned int> m_ports{0};
+
+    public:
+
+        Capture() : m_map(NULL), m_size(0), m_header(NULL), m_entries(NULL), m_mask(0) {}
+        Capture(const Capture &) = delete;
+        Capture & operator=(const Capture &) = delete;
+        ~Capture(){ close(); }
+
+        /**
+         * Maps a ring of entries (rounded up to a power of two), backed by path if given, false on failure.
+         */
+        bool open(std::size_t entries, const char * path = NULL);
+        void close();
+
+        bool is_open() const { return m_map != NULL; }
+
+        /**
+         * Index to record the port's exchanges under, -1 if there are too many.
+         */
+        int add_port(const char * name);
+
+        void record(int port, const uint8_t * command, const uint8_t * response, unsigned int status,
+                    clock::time_point written, clock::time_point completed, unsigned int attempt);
+
+        /**
+         * Writes the ring to path, false on failure. Async-signal-safe.
+         */
+        bool dump(const char * path) const;
+
+        uint64_t count() const { return m_next.load(std::memory_order_relaxed); }
+};
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_CAPTURE_HPP
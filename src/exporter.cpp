@@ -0,0 +1,137 @@
+#include "exporter.hpp"
+#include "log.hpp"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+// a client gone away must not take the process down (SIGPIPE)
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace MobSpkr {
+
+    // how often the thread checks whether to stop
+    static const int ACCEPT_TIMEOUT_MS = 250;
+
+    bool Exporter::start(int port) {
+        if (m_running.load())
+            return true;
+
+        m_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (m_fd < 0){
+            perror("socket");
+            return false;
+        }
+
+        int reuse = 1;
+        setsockopt(m_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+
+        if (bind(m_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(m_fd, 4) != 0){
+            perror("metrics");
+            close(m_fd);
+            m_fd = -1;
+            return false;
+        }
+
+        m_running.store(true);
+        m_thread = std::thread(&Exporter::run, this);
+
+        return true;
+    }
+
+    void Exporter::stop() {
+        if (!m_running.exchange(false))
+            return;
+
+        if (m_thread.joinable())
+            m_thread.join();
+
+        close(m_fd);
+        m_fd = -1;
+    }
+
+    void Exporter::run() {
+        while(m_running.load()){
+            struct pollfd pfd = {m_fd, POLLIN, 0};
+            if (poll(&pfd, 1, ACCEPT_TIMEOUT_MS) <= 0)
+                continue;
+
+            int client = accept(m_fd, NULL, NULL);
+            if (client < 0)
+                continue;
+
+            serve(client);
+            close(client);
+        }
+    }
+
+    void Exporter::serve(int client) {
+        struct timeval timeout;
+        timeout.tv_sec = CLIENT_TIMEOUT_MS / 1000;
+        timeout.tv_usec = (CLIENT_TIMEOUT_MS % 1000) * 1000;
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+        int nosigpipe = 1;
+        setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &nosigpipe, sizeof(nosigpipe));
+#endif
+
+        // the request itself doesn't matter, but it must have been read before closing
+        char request[2048];
+        std::size_t length = 0;
+        while(length < sizeof(request) - 1){
+            ssize_t r = recv(client, request + length, sizeof(request) - 1 - length, 0);
+            if (r <= 0)
+                return;
+            length += r;
+            request[length] = '\0';
+            if (std::strstr(request, "\r\n\r\n") || std::strstr(request, "\n\n"))
+                break;
+        }
+
+        std::string body;
+        const char * status = "200 OK";
+        if (std::strncmp(request, "GET ", 4) == 0){
+            m_render(body);
+        } else {
+            status = "405 Method Not Allowed";
+        }
+
+        char header[256];
+        int header_length = snprintf(header, sizeof(header),
+                "HTTP/1.0 %s\r\n"
+                "Content-Type: text/plain; version=0.0.4\r\n"
+                "Content-Length: %zu\r\n"
+                "Connection: close\r\n"
+                "\r\n", status, body.size());
+
+        std::string response(header, header_length);
+        response += body;
+
+        std::size_t sent = 0;
+        while(sent < response.size()){
+            ssize_t r = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (r <= 0){
+                Log::warning("metrics: %s\n", strerror(errno));
+                return;
+            }
+            sent += r;
+        }
+    }
+
+}
@@ -0,0 +1,51 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_EXPORTER_HPP
+#define MOBSPKR_VEHICLE_CTRL_EXPORTER_HPP
+
+#include <string>
+#include <functional>
+#include <atomic>
+#include <thread>
+
+namespace MobSpkr {
+
+/**
+ * Minimal HTTP server on localhost answering any GET (eg /metrics) with text rendered on request,
+ * as scraped by Prometheus. Runs a thread of its own so a slow client never holds up anything else.
+ */
+class Exporter {
+
+    public:
+
+        // appends the current metrics in Prometheus text format
+        typedef std::function<void(std::string & out)> Render;
+
+        const static unsigned int CLIENT_TIMEOUT_MS = 1000;
+
+    protected:
+
+        Render m_render;
+        int m_fd;
+
+        std::thread m_thread;
+        std::atomic<bool> m_running{false};
+
+        void run();
+        void serve(int client);
+
+    public:
+
+        Exporter(Render render) : m_render(std::move(render)), m_fd(-1) {}
+        Exporter(const Exporter &) = delete;
+        Exporter & operator=(const Exporter &) = delete;
+        ~Exporter(){ stop(); }
+
+        /**
+         * Listens on 127.0.0.1:port, false if that fails.
+         */
+        bool start(int port);
+        void stop();
+};
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_EXPORTER_HPP
@@ -0,0 +1,148 @@
+#include "log.hpp"
+
+#include <cstdio>
+
+namespace MobSpkr {
+
+    // how long it may take for a record to show
+    static const std::chrono::milliseconds FLUSH(20);
+
+    static const char * level_names[Log::LEVEL_COUNT] = {
+        "error",
+        "warning",
+        "info",
+        "debug",
+    };
+
+    Log::~Log() {
+        stop();
+        poll(clock::now());
+    }
+
+    Log & Log::instance() {
+        static Log log;
+        return log;
+    }
+
+    const char * Log::level_name(Level level) {
+        return level < LEVEL_COUNT ? level_names[level] : "?";
+    }
+
+    bool Log::parse_level(const char * name, Level & level) {
+        for(int l = 0; l < LEVEL_COUNT; l++){
+            if (std::strcmp(name, level_names[l]) == 0){
+                level = (Level)l;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Log::submit(Record & record) {
+        if (!m_running.load()){
+            output(record);
+            return;
+        }
+
+        if (!m_ring.push(std::move(record))){
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // otherwise written within FLUSH anyway
+        if (m_ring.size() > RING_SIZE / 2)
+            wake();
+    }
+
+    // one conversion at a time, with the length modifier of the argument as recorded
+    std::size_t Log::format(const Record & record, char * buffer, std::size_t size) {
+        std::size_t length = 0;
+        std::size_t next = 0;
+        const char * f = record.format;
+
+        while(*f && length < size - 1){
+            if (*f != '%'){
+                buffer[length++] = *f++;
+                continue;
+            }
+            if (f[1] == '%'){
+                buffer[length++] = '%';
+                f += 2;
+                continue;
+            }
+
+            // flags, width and precision as given
+            char spec[32] = "%";
+            std::size_t s = 1;
+            f++;
+            while(*f && std::strchr("-+ #0123456789.", *f) && s < sizeof(spec) - 4)
+                spec[s++] = *f++;
+            while(*f && std::strchr("hlLqjzt", *f))
+                f++;
+            char conversion = *f ? *f++ : 'd';
+
+            if (next >= record.count){
+                length += snprintf(buffer + length, size - length, "(?)");
+            } else {
+                const Arg & arg = record.args[next++];
+                bool floating = std::strchr("fFeEgGaA", conversion) != NULL;
+
+                if (arg.type == Arg::String){
+                    spec[s++] = 's';
+                    length += snprintf(buffer + length, size - length, spec, record.strings + arg.offset);
+                } else if (arg.type == Arg::Float || floating){
+                    spec[s++] = floating ? conversion : 'g';
+                    length += snprintf(buffer + length, size - length, spec, arg.type == Arg::Float ? arg.d : arg.type == Arg::Signed ? (double)arg.i : (double)arg.u);
+                } else if (conversion == 'c'){
+                    spec[s++] = 'c';
+                    length += snprintf(buffer + length, size - length, spec, (int)arg.i);
+                } else {
+                    spec[s++] = 'l';
+                    spec[s++] = 'l';
+                    spec[s++] = std::strchr("diouxX", conversion) ? conversion : 'd';
+                    length += snprintf(buffer + length, size - length, spec, arg.i);
+                }
+            }
+
+            // snprintf reports what would have been written
+            if (length > size - 1)
+                length = size - 1;
+        }
+
+        buffer[length] = '\0';
+        return length;
+    }
+
+    void Log::output(const Record & record) {
+        char buffer[512];
+        format(record, buffer, sizeof(buffer));
+
+        // as before, problems to stderr and everything else to stdout
+        std::fputs(buffer, record.level <= Warning ? stderr : stdout);
+    }
+
+    Log::clock::time_point Log::poll(clock::time_point now) {
+        bool written = false;
+
+        Record record;
+        while(m_ring.pop(record)){
+            output(record);
+            written = true;
+        }
+
+        unsigned long dropped = m_dropped.load(std::memory_order_relaxed);
+        if (dropped != m_reported){
+            std::fprintf(stderr, "log: %lu messages dropped\n", dropped - m_reported);
+            m_reported = dropped;
+            written = true;
+        }
+
+        if (written){
+            std::fflush(stdout);
+            std::fflush(stderr);
+        }
+
+        return now + FLUSH;
+    }
+
+}
@@ -0,0 +1,197 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_LOG_HPP
+#define MOBSPKR_VEHICLE_CTRL_LOG_HPP
+
+#include "poller.hpp"
+#include "queue.hpp"
+
+#include <atomic>
+#include <string>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+
+namespace MobSpkr {
+
+/**
+ * printf-style logging off the calling thread: records (format and arguments as is) are put into a
+ * preallocated lock-free ring and formatted and written by a thread of its own (start()).
+ *
+ * Messages above the current level are discarded before anything is copied. The format must be a literal
+ * (it is kept by pointer), strings are copied. When the ring is full records are dropped and counted.
+ * Records show within a few 10 ms, before start() and after stop() records are written right away.
+ *
+ *      Log::warning("motor %d: %s failed\n", motor, what);
+ */
+class Log : public Poller {
+
+    public:
+
+        enum Level {
+            Error,
+            Warning,
+            Info,
+            Debug,
+            LEVEL_COUNT
+        };
+
+        const static std::size_t RING_SIZE = 1024;
+        const static std::size_t MAX_ARGS = 8;
+        const static std::size_t STRING_SPACE = 128;
+
+    protected:
+
+        struct Arg {
+            enum Type : uint8_t {
+                Signed,
+                Unsigned,
+                Float,
+                String,
+            } type;
+            union {
+                long long i;
+                unsigned long long u;
+                double d;
+                // into Record::strings
+                std::size_t offset;
+            };
+        };
+
+        struct Record {
+            Level level;
+            const char * format;
+            std::size_t count;
+            std::size_t used;
+            Arg args[MAX_ARGS];
+            char strings[STRING_SPACE];
+        };
+
+        std::atomic<int> m_level{Info};
+        std::atomic<unsigned long> m_dropped{0};
+        unsigned long m_reported;
+
+        Queue<Record, RING_SIZE> m_ring;
+
+        template<typename T>
+        static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+        pack(Record & record, T value){
+            Arg & arg = record.args[record.count++];
+            arg.type = Arg::Signed;
+            arg.i = value;
+        }
+
+        template<typename T>
+        static typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value>::type
+        pack(Record & record, T value){
+            Arg & arg = record.args[record.count++];
+            arg.type = Arg::Unsigned;
+            arg.u = value;
+        }
+
+        template<typename T>
+        static typename std::enable_if<std::is_enum<T>::value>::type
+        pack(Record & record, T value){
+            Arg & arg = record.args[record.count++];
+            arg.type = Arg::Signed;
+            arg.i = (long long)value;
+        }
+
+        template<typename T>
+        static typename std::enable_if<std::is_floating_point<T>::value>::type
+        pack(Record & record, T value){
+            Arg & arg = record.args[record.count++];
+            arg.type = Arg::Float;
+            arg.d = value;
+        }
+
+        // truncated to whatever space is left
+        static void pack(Record & record, const char * value){
+            Arg & arg = record.args[record.count++];
+            arg.type = Arg::String;
+            arg.offset = record.used;
+
+            if (value == NULL)
+                value = "(null)";
+
+            std::size_t space = STRING_SPACE - record.used - 1;
+            std::size_t length = std::strlen(value);
+            if (length > space)
+                length = space;
+
+            std::memcpy(record.strings + record.used, value, length);
+            record.strings[record.used + length] = '\0';
+            record.used += length + 1;
+            if (record.used > STRING_SPACE - 1)
+                record.used = STRING_SPACE - 1;
+        }
+
+        static void pack(Record & record, char * value){ pack(record, (const char *)value); }
+        static void pack(Record & record, const std::string & value){ pack(record, value.c_str()); }
+
+        static void pack_all(Record & record){}
+
+        template<typename T, typename... Args>
+        static void pack_all(Record & record, T && value, Args && ... args){
+            pack(record, value);
+            pack_all(record, std::forward<Args>(args)...);
+        }
+
+        void submit(Record & record);
+
+        static std::size_t format(const Record & record, char * buffer, std::size_t size);
+        static void output(const Record & record);
+
+        template<typename... Args>
+        static void write(Level level, const char * format, Args && ... args){
+            static_assert(sizeof...(Args) <= MAX_ARGS, "too many log arguments");
+
+            Log & log = instance();
+            if (level > log.m_level.load(std::memory_order_relaxed))
+                return;
+
+            Record record;
+            record.level = level;
+            record.format = format;
+            record.count = 0;
+            record.used = 0;
+            pack_all(record, std::forward<Args>(args)...);
+
+            log.submit(record);
+        }
+
+        Log() : m_reported(0) {}
+
+    public:
+
+        ~Log();
+
+        static Log & instance();
+
+        static const char * level_name(Level level);
+        static bool parse_level(const char * name, Level & level);
+
+        void set_level(Level level){ m_level.store(level); }
+        Level get_level() const { return (Level)m_level.load(); }
+
+        unsigned long dropped() const { return m_dropped.load(); }
+
+        template<typename... Args>
+        static void error(const char * format, Args && ... args){ write(Error, format, std::forward<Args>(args)...); }
+
+        template<typename... Args>
+        static void warning(const char * format, Args && ... args){ write(Warning, format, std::forward<Args>(args)...); }
+
+        template<typename... Args>
+        static void info(const char * format, Args && ... args){ write(Info, format, std::forward<Args>(args)...); }
+
+        template<typename... Args>
+        static void debug(const char * format, Args && ... args){ write(Debug, format, std::forward<Args>(args)...); }
+
+        /**
+         * Writes whatever is queued, returns when to call again.
+         */
+        clock::time_point poll(clock::time_point now) override;
+};
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_LOG_HPP
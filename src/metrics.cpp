@@ -0,0 +1,128 @@
+#include "metrics.hpp"
+
+#include <cstdio>
+
+namespace MobSpkr {
+
+    static const char * command_names[Metrics::COMMAND_SLOTS] = {
+        "other",
+        "ROR",
+        "ROL",
+        "MST",
+        "MVP",
+        "SAP",
+        "GAP",
+        "STAP",
+        "RSAP",
+        "SGP",
+        "GGP",
+        "STGP",
+        "RSGP",
+        "RFS",
+        "SIO",
+        "GIO",
+    };
+
+    static const char * latency_names[Metrics::LATENCY_COUNT] = {
+        "wait",
+        "response",
+        "total",
+    };
+
+    Histogram::Histogram() {
+        for(std::atomic<uint32_t> & bucket : m_buckets){
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    unsigned int Histogram::bucket_of(uint32_t us) {
+        if (us < SUB_BUCKETS)
+            return us;
+
+        // the top SUB_BITS below the leading one select the sub bucket
+        unsigned int magnitude = 31 - __builtin_clz(us);
+        unsigned int sub = (us >> (magnitude - SUB_BITS)) & (SUB_BUCKETS - 1);
+        return (magnitude - SUB_BITS + 1) * SUB_BUCKETS + sub;
+    }
+
+    uint32_t Histogram::lowest_of(unsigned int bucket) {
+        if (bucket < SUB_BUCKETS)
+            return bucket;
+
+        unsigned int magnitude = bucket / SUB_BUCKETS + SUB_BITS - 1;
+        unsigned int sub = bucket % SUB_BUCKETS;
+        return (uint32_t)(SUB_BUCKETS + sub) << (magnitude - SUB_BITS);
+    }
+
+    uint32_t Histogram::highest_of(unsigned int bucket) {
+        if (bucket < SUB_BUCKETS)
+            return bucket;
+
+        unsigned int magnitude = bucket / SUB_BUCKETS + SUB_BITS - 1;
+        return lowest_of(bucket) + ((uint32_t)1 << (magnitude - SUB_BITS)) - 1;
+    }
+
+    void Histogram::record(uint32_t us) {
+        m_buckets[bucket_of(us)].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(us, std::memory_order_relaxed);
+
+        uint32_t max = m_max.load(std::memory_order_relaxed);
+        while(us > max && !m_max.compare_exchange_weak(max, us, std::memory_order_relaxed))
+            ;
+    }
+
+    uint32_t Histogram::percentile(double fraction) const {
+        uint64_t total = count();
+        if (total == 0)
+            return 0;
+
+        uint64_t rank = (uint64_t)(fraction * total + 0.5);
+        if (rank < 1)
+            rank = 1;
+
+        uint64_t seen = 0;
+        for(unsigned int b = 0; b < BUCKETS; b++){
+            seen += m_buckets[b].load(std::memory_order_relaxed);
+            if (seen >= rank){
+                uint32_t highest = highest_of(b);
+                return highest < max() ? highest : max();
+            }
+        }
+
+        return max();
+    }
+
+    void Histogram::prometheus(std::string & out, const char * name, const std::string & labels) const {
+        char line[256];
+        uint64_t cumulative = 0;
+        unsigned int b = 0;
+
+        // buckets end right below each power of two, up to 16 s (the same set every time)
+        for(unsigned int magnitude = SUB_BITS; magnitude <= 24; magnitude++){
+            uint32_t bound = (uint32_t)1 << magnitude;
+            while(b < BUCKETS && highest_of(b) < bound){
+                cumulative += m_buckets[b].load(std::memory_order_relaxed);
+                b++;
+            }
+            snprintf(line, sizeof(line), "%s_bucket{%s,le=\"%g\"} %llu\n", name, labels.c_str(), bound / 1e6, (unsigned long long)cumulative);
+            out += line;
+        }
+
+        snprintf(line, sizeof(line), "%s_bucket{%s,le=\"+Inf\"} %llu\n", name, labels.c_str(), (unsigned long long)count());
+        out += line;
+        snprintf(line, sizeof(line), "%s_sum{%s} %g\n", name, labels.c_str(), sum() / 1e6);
+        out += line;
+        snprintf(line, sizeof(line), "%s_count{%s} %llu\n", name, labels.c_str(), (unsigned long long)count());
+        out += line;
+    }
+
+    const char * Metrics::command_name(unsigned int slot) {
+        return slot < COMMAND_SLOTS ? command_names[slot] : "?";
+    }
+
+    const char * Metrics::latency_name(Latency latency) {
+        return latency < LATENCY_COUNT ? latency_names[latency] : "?";
+    }
+
+}
@@ -0,0 +1,120 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_METRICS_HPP
+#define MOBSPKR_VEHICLE_CTRL_METRICS_HPP
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+namespace MobSpkr {
+
+/**
+ * Latency histogram in microseconds, log-linear (HDR-like) buckets: 8 per power of two, ie values are
+ * known to within 12.5%, from 1 us to over an hour in fixed space. Recording is a few relaxed atomic
+ * increments, readers may look at it any time.
+ */
+class Histogram {
+
+    public:
+
+        const static unsigned int SUB_BITS = 3;
+        const static unsigned int SUB_BUCKETS = 1 << SUB_BITS;
+        const static unsigned int BUCKETS = (32 - SUB_BITS + 1) * SUB_BUCKETS;
+
+    protected:
+
+        std::atomic<uint32_t> m_buckets[BUCKETS];
+        std::atomic<uint64_t> m_count{0};
+        std::atomic<uint64_t> m_sum{0};
+        std::atomic<uint32_t> m_max{0};
+
+    public:
+
+        Histogram();
+        Histogram(const Histogram &) = delete;
+        Histogram & operator=(const Histogram &) = delete;
+
+        static unsigned int bucket_of(uint32_t us);
+        static uint32_t lowest_of(unsigned int bucket);
+        static uint32_t highest_of(unsigned int bucket);
+
+        void record(uint32_t us);
+
+        uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+        uint64_t sum() const { return m_sum.load(std::memory_order_relaxed); }
+        uint32_t max() const { return m_max.load(std::memory_order_relaxed); }
+        uint32_t mean() const { uint64_t n = count(); return n ? sum() / n : 0; }
+
+        /**
+         * Upper bound of the bucket the given fraction (0 - 1) of values is at or below of, 0 if empty.
+         */
+        uint32_t percentile(double fraction) const;
+
+        /**
+         * Appends <name>_bucket (at powers of two), <name>_sum and <name>_count in Prometheus text format,
+         * labels as in name{labels}.
+         */
+        void prometheus(std::string & out, const char * name, const std::string & labels) const;
+};
+
+/**
+ * Per command (TMCL instruction) latencies and counters of a motor, recorded by the bus:
+ *  - wait: queued (ie received over OSC) until written to the port
+ *  - response: written until answered
+ *  - total: queued until answered
+ */
+class Metrics {
+
+    public:
+
+        enum Latency {
+            Wait,
+            Response,
+            Total,
+            LATENCY_COUNT
+        };
+
+        // instructions 1 - 15 each, all others in slot 0
+        const static unsigned int COMMAND_SLOTS = 16;
+
+        struct Command {
+            Histogram latency[LATENCY_COUNT];
+            std::atomic<uint32_t> count{0};
+            std::atomic<uint32_t> errors{0};
+        };
+
+    protected:
+
+        Command m_commands[COMMAND_SLOTS];
+
+    public:
+
+        static unsigned int slot_of(uint8_t command_number){ return command_number < COMMAND_SLOTS ? command_number : 0; }
+        static const char * command_name(unsigned int slot);
+        static const char * latency_name(Latency latency);
+
+        /**
+         * Latencies of a command answered successfully.
+         */
+        void record(uint8_t command_number, uint32_t wait_us, uint32_t response_us, uint32_t total_us){
+            Command & command = m_commands[slot_of(command_number)];
+            command.count.fetch_add(1, std::memory_order_relaxed);
+            command.latency[Wait].record(wait_us);
+            command.latency[Response].record(response_us);
+            command.latency[Total].record(total_us);
+        }
+
+        /**
+         * Failed, timed out or refused by the module.
+         */
+        void record_error(uint8_t command_number){
+            Command & command = m_commands[slot_of(command_number)];
+            command.count.fetch_add(1, std::memory_order_relaxed);
+            command.errors.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        const Command & command(unsigned int slot) const { return m_commands[slot]; }
+};
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_METRICS_HPP
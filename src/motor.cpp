@@ -1,145 +1,213 @@
 #include "motor.hpp"
+#include "log.hpp"
+#include "bus.hpp"
 
 #include <cstdio>
+#include <memory>
+#include <chrono>
 
 namespace MobSpkr {
 
+    Motor::~Motor(){
+        if (m_own_bus)
+            delete m_bus;
+        if (m_portname)
+            std::free(m_portname);
+    }
+
+    void Motor::attach(Bus * bus) {
+        if (m_own_bus)
+            delete m_bus;
+
+        m_bus = bus;
+        m_own_bus = false;
+    }
+
     bool Motor::open(int baudrate, int bits, enum sp_parity parity, int stopbits, enum sp_flowcontrol flowcontrol) {
 
+        if (m_bus && !m_own_bus)
+            return m_bus->is_open() || m_bus->open(baudrate, bits, parity, stopbits, flowcontrol);
+
+        // the port name might have changed
+        unsigned int window = m_bus ? m_bus->get_window() : 1;
+
         close();
+        delete m_bus;
 
-        enum sp_return r;
+        m_bus = new Bus(m_portname);
+        m_own_bus = true;
+        m_bus->set_window(window);
 
-        if ( (r = sp_get_port_by_name(m_portname, &m_port)) != SP_OK){
-            std::fprintf(stderr, "sp_get_port_by_name(%s): %d\n", m_portname, r);
-            goto open_failed;
-        }
+        return m_bus->open(baudrate, bits, parity, stopbits, flowcontrol);
+    }
 
-        if ( (r = sp_open(m_port, SP_MODE_READ_WRITE)) != SP_OK){
-            std::fprintf(stderr, "sp_open(%s): %d\n", m_portname, r);
-            goto open_failed;
-        }
+    void Motor::close() {
+        if (m_own_bus && m_bus)
+            m_bus->close();
+    }
 
-        if ( (r = sp_set_baudrate(m_port, baudrate)) != SP_OK){
-            std::fprintf(stderr, "set_baudrate(%s, %d): %d\n", m_portname, baudrate, r);
-            goto open_failed;
-        }
+    bool Motor::is_open() {
+        return m_bus && m_bus->is_open();
+    }
 
-        if ( (r = sp_set_bits(m_port, bits)) != SP_OK){
-            std::fprintf(stderr, "sp_set_bits(%s, %d): %d\n", m_portname, bits, r);
-            goto open_failed;
-        }
+    bool Motor::start() {
+        return m_bus && m_bus->start();
+    }
 
-        if ( (r = sp_set_parity(m_port, parity)) != SP_OK){
-            std::fprintf(stderr, "sp_set_parity(%s, %d): %d\n", m_portname, parity, r);
-            goto open_failed;
-        }
+    void Motor::stop() {
+        if (m_own_bus && m_bus)
+            m_bus->stop();
+    }
 
-        if ( (r = sp_set_stopbits(m_port, stopbits)) != SP_OK){
-            std::fprintf(stderr, "sp_set_stopbits(%s, %d): %d\n", m_portname, stopbits, r);
-            goto open_failed;
-        }
+    bool Motor::is_running() const {
+        return m_bus && m_bus->is_running();
+    }
 
-        if ( (r = sp_set_flowcontrol(m_port, flowcontrol)) != SP_OK){
-            std::fprintf(stderr, "sp_set_flowcontrol(%s, %d): %d\n", m_portname, flowcontrol, r);
-            goto open_failed;
-        }
+    void Motor::set_window(unsigned int window) {
+        if (m_bus)
+            m_bus->set_window(window);
+    }
+
+    bool Motor::enqueue(Command command, unsigned int timeout_ms, Callback callback, uint32_t generation, std::shared_ptr<SyncGroup> sync, bool background) {
+        if (!is_running())
+            return false;
+
+        command.set_address(m_address);
 
+        Bus::Job job;
+        job.motor = this;
+        job.command = command;
+        job.timeout_ms = timeout_ms;
+        job.callback = std::move(callback);
+        job.generation = generation;
+        job.sync = std::move(sync);
+        job.background = background;
+
+        if (background)
+            return m_bus->enqueue(std::move(job));
+
+        m_pending++;
+
+        if (!m_bus->enqueue(std::move(job))){
+            m_pending--;
+            return false;
+        }
 
         return true;
+    }
+
+    bool Motor::submit(Command command, unsigned int timeout_ms, Callback callback) {
+        return enqueue(command, timeout_ms, std::move(callback), 0);
+    }
 
-    open_failed:
+    uint32_t Motor::next_setpoint_generation() {
+        uint32_t generation = ++m_setpoint_generation;
 
-        sp_free_port(m_port);
-        m_port = NULL;
+        // never use 0, it marks plain commands
+        if (generation == 0)
+            generation = ++m_setpoint_generation;
 
-        return false;
+        return generation;
     }
 
-    void Motor::close() {
-        if (m_port) {
-            sp_close(m_port);
-            sp_free_port(m_port);
-            m_port = NULL;
+    bool Motor::submit_setpoint(Command command, unsigned int timeout_ms, Callback callback) {
+        return enqueue(command, timeout_ms, std::move(callback), next_setpoint_generation());
+    }
+
+    bool Motor::submit_background(Command command, unsigned int timeout_ms, Callback callback) {
+        return enqueue(command, timeout_ms, std::move(callback), 0, nullptr, true);
+    }
+
+    std::future<Motor::Response> Motor::submit(Command command, unsigned int timeout_ms) {
+        // std::function must be copyable, thus the shared promise
+        std::shared_ptr<std::promise<Response>> promise = std::make_shared<std::promise<Response>>();
+        std::future<Response> future = promise->get_future();
+
+        bool queued = submit(command, timeout_ms, [promise](Response::Status status, const Response & response){
+            promise->set_value(response);
+        });
+
+        if (!queued){
+            Response response;
+            promise->set_value(response);
         }
+
+        return future;
     }
 
     Motor::Response::Status Motor::execute_raw(uint8_t command[], uint8_t response[], unsigned int timeout_ms) {
         if (!is_open()){
-            fprintf(stderr, "is not open?\n");
+            Log::error("is not open?\n");
             return Response::Status::Error;
         }
 
-        int r;
+        return m_bus->transfer(command, response, timeout_ms);
+    }
 
+    Motor::Response::Status Motor::execute(Command command, Response * response, unsigned int timeout_ms) {
+        command.set_address(m_address);
 
-//        printf("tx (%d) ", Command::SIZE);
-//        for(int i = 0; i < Command::SIZE; i++){
-//            printf("%02x ", command[i]);
-//        }
-//        printf("\n");
+        if (is_running()){
+            Response rx = submit(command, timeout_ms).get();
 
-        if ( (r = sp_blocking_write(m_port, command, Command::SIZE, timeout_ms)) < Command::SIZE ){
-            fprintf(stderr, "sp_blocking_write(): %d\n", r);
-            return Response::Status::Error;
-        }
+            if (response)
+                *response = rx;
 
-        if ( (r = sp_blocking_read(m_port, response, Response::SIZE, timeout_ms)) < Response::SIZE ){
-            fprintf(stderr, "sp_blocking_read(): %d\n", r);
-            return Response::Status::Error;
+            return rx.status();
         }
 
-//        printf("rx (%d) ", r);
-//        for(int i = 0; i < r; i++){
-//            printf("%02x ", response[i]);
-//        }
-//        printf("\n");
+        uint8_t rx[Response::SIZE] = {0};
+
+        Response::Status status = execute_raw(command.bytes(), rx, timeout_ms);
+
+        if (response){
+            response->set(rx);
+            response->set_status(status);
+        }
 
-        return (Response::Status)response[Response::STATUS];
+        return status;
     }
 
     Motor::Response::Status Motor::command_stopMotor(unsigned int timeout_ms){
-        return execute(MobSpkr::PD_1160::MotorStop, NULL, 1000);
+        return execute(MobSpkr::PD_1160::Catalogue::MotorStop, NULL, timeout_ms);
     }
 
     Motor::Response::Status Motor::command_rotateRight(uint32_t value, unsigned int timeout_ms){
-        return execute_with_value(MobSpkr::PD_1160::RotateRight, value, NULL, 1000) ;
+        return execute_with_value(MobSpkr::PD_1160::Catalogue::RotateRight, value, NULL, timeout_ms) ;
     }
 
     Motor::Response::Status Motor::command_rotateLeft(uint32_t value, unsigned int timeout_ms){
-        return execute_with_value(MobSpkr::PD_1160::RotateLeft, value, NULL, 1000) ;
+        return execute_with_value(MobSpkr::PD_1160::Catalogue::RotateLeft, value, NULL, timeout_ms) ;
     }
 
     Motor::Response::Status Motor::command_moveToPosition(int32_t pos, enum MovementType type, uint8_t coord, unsigned int timeout_ms){
-        uint8_t cmd[sizeof(MobSpkr::PD_1160::MoveToPosition)];
-
-        std::memcpy(cmd, MobSpkr::PD_1160::MoveToPosition, sizeof(MobSpkr::PD_1160::MoveToPosition));
+        Command cmd(MobSpkr::PD_1160::Catalogue::MoveToPosition);
 
         switch(type){
             case MovementType_Absolute:
-                cmd[2] = MovementType_Absolute;
-                cmd[3] = 0;
+                cmd.set_type(MovementType_Absolute);
+                cmd.set_motor(0);
                 break;
             case MovementType_Relative:
-                cmd[2] = MovementType_Relative;
-                cmd[3] = 0;
+                cmd.set_type(MovementType_Relative);
+                cmd.set_motor(0);
                 break;
             case MovementType_Coordinate:
-                cmd[2] = MovementType_Coordinate;
-                cmd[3] = coord;
+                cmd.set_type(MovementType_Coordinate);
+                cmd.set_motor(coord);
                 break;
             default:
                 return Motor::Response::InvalidValue;
         }
 
-        return execute_with_value(cmd, pos, NULL, 1000);
+        return execute_with_value(cmd, pos, NULL, timeout_ms);
     }
 
 
     Motor::Response::Status Motor::command_getAxisParam_ActualPosition(int32_t & value, unsigned int timeout_ms){
         Response response;
 
-        Response::Status status = execute_with_value(MobSpkr::PD_1160::GetAxisParam_ActualPosition, value, &response, 1000) ;
+        Response::Status status = execute_with_value(MobSpkr::PD_1160::Catalogue::GetAxisParam_ActualPosition, value, &response, timeout_ms) ;
 
         if (status == Response::Status::Success){
             value = response.value();
@@ -149,41 +217,41 @@ namespace MobSpkr {
     }
 
     Motor::Response::Status Motor::command_setAxisParam_ActualPosition(int32_t value, unsigned int timeout_ms){
-        return execute_with_value(MobSpkr::PD_1160::SetAxisParam_ActualPosition, value, NULL, 1000) ;
+        return execute_with_value(MobSpkr::PD_1160::Catalogue::SetAxisParam_ActualPosition, value, NULL, timeout_ms) ;
     }
 
     Motor::Response::Status Motor::command_setAxisParam_MaxCurrent(uint32_t value, unsigned int timeout_ms){
-        return execute_with_value(MobSpkr::PD_1160::SetAxisParam_MaxCurrent, value, NULL, 1000);
+        return execute_with_value(MobSpkr::PD_1160::Catalogue::SetAxisParam_MaxCurrent, value, NULL, timeout_ms);
     }
 
     Motor::Response::Status Motor::command_setAxisParam_StandbyCurrent(uint32_t value, unsigned int timeout_ms){
-        return execute_with_value(MobSpkr::PD_1160::SetAxisParam_StandbyCurrent, value, NULL, 1000);
+        return execute_with_value(MobSpkr::PD_1160::Catalogue::SetAxisParam_StandbyCurrent, value, NULL, timeout_ms);
     }
 
     Motor::Response::Status Motor::command_setAxisParam_PowerDownDelay(uint32_t value, unsigned int timeout_ms){
-        return execute_with_value(MobSpkr::PD_1160::SetAxisParam_PowerDownDelay, value, NULL, 1000) ;
+        return execute_with_value(MobSpkr::PD_1160::Catalogue::SetAxisParam_PowerDownDelay, value, NULL, timeout_ms) ;
     }
 
     Motor::Response::Status Motor::command_setAxisParam_Interpolation(uint32_t value, unsigned int timeout_ms){
-        return execute_with_value(MobSpkr::PD_1160::SetAxisParam_Interpolation, value, NULL, 1000) ;
+        return execute_with_value(MobSpkr::PD_1160::Catalogue::SetAxisParam_Interpolation, value, NULL, timeout_ms) ;
     }
 
     Motor::Response::Status Motor::command_setAxisParam_PulseDivisor(uint32_t value, unsigned int timeout_ms){
-        return execute_with_value(MobSpkr::PD_1160::SetAxisParam_PulseDivisor, value, NULL, 1000) ;
+        return execute_with_value(MobSpkr::PD_1160::Catalogue::SetAxisParam_PulseDivisor, value, NULL, timeout_ms) ;
     }
 
     Motor::Response::Status Motor::command_setAxisParam_RampDivisor(uint32_t value, unsigned int timeout_ms){
-        return execute_with_value(MobSpkr::PD_1160::SetAxisParam_RampDivisor, value, NULL, 1000) ;
+        return execute_with_value(MobSpkr::PD_1160::Catalogue::SetAxisParam_RampDivisor, value, NULL, timeout_ms) ;
     }
 
     Motor::Response::Status Motor::command_setAxisParam_MaxAcceleration(uint32_t value, unsigned int timeout_ms){
-        return execute_with_value(MobSpkr::PD_1160::SetAxisParam_MaxAcceleration, value, NULL, 1000);
+        return execute_with_value(MobSpkr::PD_1160::Catalogue::SetAxisParam_MaxAcceleration, value, NULL, timeout_ms);
     }
 
     Motor::Response::Status Motor::command_getAxisParam_MicroStepResolution(enum MicroStepResolution & value, unsigned int timeout_ms){
         Response response;
 
-        Response::Status status = execute_with_value(MobSpkr::PD_1160::GetAxisParam_MicroStepResolution, value, &response, 1000) ;
+        Response::Status status = execute_with_value(MobSpkr::PD_1160::Catalogue::GetAxisParam_MicroStepResolution, value, &response, timeout_ms) ;
 
         if (status == Response::Status::Success){
             value = (enum MicroStepResolution)response.value();
@@ -193,14 +261,14 @@ namespace MobSpkr {
     }
 
     Motor::Response::Status Motor::command_setAxisParam_MicroStepResolution(enum MicroStepResolution value, unsigned int timeout_ms){
-        return execute_with_value(MobSpkr::PD_1160::SetAxisParam_MicroStepResolution, value, NULL, 1000) ;
+        return execute_with_value(MobSpkr::PD_1160::Catalogue::SetAxisParam_MicroStepResolution, value, NULL, timeout_ms) ;
     }
 
 
     Motor::Response::Status Motor::command_getGIOVoltage(uint32_t & value, unsigned int timeout_ms){
         Response response;
 
-        Response::Status status = execute_with_value(MobSpkr::PD_1160::GetGIOVoltage, value, &response, 1000) ;
+        Response::Status status = execute_with_value(MobSpkr::PD_1160::Catalogue::GetGIOVoltage, value, &response, timeout_ms) ;
 
         if (status == Response::Status::Success){
             value = (enum MicroStepResolution)response.value();
@@ -212,7 +280,7 @@ namespace MobSpkr {
     Motor::Response::Status Motor::command_getGIOTemperature(uint32_t & value, unsigned int timeout_ms){
         Response response;
 
-        Response::Status status = execute_with_value(MobSpkr::PD_1160::GetGIOTemperature, value, &response, 1000) ;
+        Response::Status status = execute_with_value(MobSpkr::PD_1160::Catalogue::GetGIOTemperature, value, &response, timeout_ms) ;
 
         if (status == Response::Status::Success){
             value = (enum MicroStepResolution)response.value();
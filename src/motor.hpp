@@ -5,37 +5,56 @@
 #include <cstdint>
 #include <cstring>
 #include <cstdlib>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
 #include <libserialport.h>
 
+#include "queue.hpp"
+#include "tmcl.hpp"
+#include "metrics.hpp"
+
 namespace MobSpkr {
 
+class Bus;
+class SyncGroup;
+
 class Motor {
 
+    friend class Bus;
+    friend class SyncGroup;
+
     protected:
         char * m_portname;
         uint8_t m_address;
 
-        struct sp_port *m_port;
+        // either private to this motor (opened on open()) or shared with other motors (see attach())
+        Bus * m_bus;
+        bool m_own_bus;
 
     public:
-        Motor(){}
+        Motor(){
+            m_portname = NULL;
+            m_address = 0;
+            m_bus = NULL;
+            m_own_bus = false;
+        }
         Motor(char portname[], uint8_t address){
             if (portname)
                 m_portname = strdup(portname);
             else
                 m_portname = NULL;
             m_address = address;
-            m_port = NULL;
-        }
-        ~Motor(){
-            if (m_portname)
-                std::free(m_portname);
-            if (m_port) {
-                sp_close(m_port);
-                sp_free_port(m_port);
-                m_port = NULL;
-            }
+            m_bus = NULL;
+            m_own_bus = false;
         }
+        Motor(const Motor &) = delete;
+        Motor & operator=(const Motor &) = delete;
+        ~Motor();
 
         const char * get_portname() { return m_portname; }
         void set_portname(char portname[]){
@@ -51,10 +70,17 @@ class Motor {
             m_address = address;
         }
 
+        /**
+         * Use bus (ie a shared RS485 port) instead of opening a port of its own, the bus must outlive the motor.
+         * Opening, closing, starting and stopping a shared bus is up to its owner.
+         */
+        void attach(Bus * bus);
+        Bus * get_bus() { return m_bus; }
+
         bool open(int baudrate = 9600, int bits = 8, enum sp_parity parity = SP_PARITY_NONE, int stopbits = 1, enum sp_flowcontrol flowcontrol = SP_FLOWCONTROL_NONE);
         void close();
 
-        bool is_open(){ return m_port != NULL; }
+        bool is_open();
 
 
         class Command {
@@ -73,15 +99,36 @@ class Motor {
             protected:
                 uint8_t m_bytes[SIZE];
 
+                // keeps the checksum valid without summing up the whole frame again
+                void patch(int i, uint8_t byte){
+                    m_bytes[CHECKSUM] += (uint8_t)(byte - m_bytes[i]);
+                    m_bytes[i] = byte;
+                }
+
             public:
+                Command(){
+                    std::memset(m_bytes, 0, SIZE);
+                }
+
                 Command(const uint8_t bytes[9]){
                     std::memcpy(m_bytes, bytes, SIZE);
+                    compute_checksum();
+                }
+
+                // frames of the catalogue are already complete, including the checksum
+                Command(const TMCL::Frame & frame){
+                    std::memcpy(m_bytes, frame.bytes, SIZE);
                 }
 
                 Command(const Command &other){
                     std::memcpy(m_bytes, other.m_bytes, SIZE);
                 }
 
+                Command & operator=(const Command &other){
+                    std::memcpy(m_bytes, other.m_bytes, SIZE);
+                    return *this;
+                }
+
                 Command(uint8_t address, uint8_t command_number, uint8_t type, uint8_t motor, uint32_t value){
                     m_bytes[0] = address;
                     m_bytes[1] = command_number;
@@ -91,41 +138,41 @@ class Motor {
                     m_bytes[5] = (value >> 16) & 0xff;
                     m_bytes[6] = (value >> 8) & 0xff;
                     m_bytes[7] = value & 0xff;
-                    m_bytes[8] = 0; // checksum
+                    compute_checksum();
                 }
 
-                Command & with_value(uint32_t value){
-                    Command * cmd = new Command(*this);
-                    cmd->m_bytes[4] = (value >> 24) & 0xff;
-                    cmd->m_bytes[5] = (value >> 16) & 0xff;
-                    cmd->m_bytes[6] = (value >> 8) & 0xff;
-                    cmd->m_bytes[7] = value & 0xff;
-                    return *cmd;
+                Command with_value(uint32_t value) const {
+                    Command cmd(*this);
+                    cmd.set_value(value);
+                    return cmd;
                 }
 
                 void set_address(uint8_t address){
-                    m_bytes[0] = address;
+                    patch(ADDRESS, address);
                 }
 
                 void set_command_number(uint8_t command_number){
-                    m_bytes[1] = command_number;
+                    patch(COMMAND_NUMBER, command_number);
                 }
 
                 void set_type(uint8_t type){
-                    m_bytes[2] = type;
+                    patch(TYPE, type);
                 }
 
                 void set_motor(uint8_t motor){
-                    m_bytes[3] = motor;
+                    patch(MOTOR, motor);
                 }
 
                 void set_value(uint32_t value){
-                    m_bytes[4] = (value >> 24) & 0xff;
-                    m_bytes[5] = (value >> 16) & 0xff;
-                    m_bytes[6] = (value >> 8) & 0xff;
-                    m_bytes[7] = value & 0xff;
+                    patch(4, (value >> 24) & 0xff);
+                    patch(5, (value >> 16) & 0xff);
+                    patch(6, (value >> 8) & 0xff);
+                    patch(7, value & 0xff);
                 }
 
+                uint8_t command_number() const { return m_bytes[COMMAND_NUMBER]; }
+                uint32_t value() const { return (m_bytes[4] << 24) | (m_bytes[5] << 16) | (m_bytes[6] << 8) | m_bytes[7]; }
+
                 void compute_checksum(){
                     m_bytes[8] = 0;
                     for(int i = 0; i < 8; i++){
@@ -134,6 +181,7 @@ class Motor {
                 }
 
                 uint8_t * bytes(){ return m_bytes; }
+                const uint8_t * bytes() const { return m_bytes; }
 
 //                void get_bytes(uint8_t dst[]){
 //                    std::memcpy(dst, m_bytes, SIZE);
@@ -175,6 +223,7 @@ class Motor {
                     CommandLoadedIntoEEPROM     = 101,
 
                     Error                       = 1000,
+                    Superseded                  = 1001, // dropped in favour of a newer setpoint, never sent
                 };
 
                 const static int SIZE = 9;
@@ -190,15 +239,23 @@ class Motor {
 
                 uint8_t m_bytes[SIZE];
                 uint8_t m_checksum;
+                Status m_status;
 
             public:
 
+                Response(){
+                    std::memset(m_bytes, 0, SIZE);
+                    m_checksum = 0;
+                    m_status = Error;
+                }
+
                 uint8_t address() const { return m_bytes[0]; }
                 uint8_t module() const { return m_bytes[1]; }
-                Status status() const { return (Status)m_bytes[2]; }
+                Status status() const { return m_status; }
                 uint8_t command_number() const { return m_bytes[3]; }
                 uint32_t value() const { return (m_bytes[4] << 24) | (m_bytes[5] << 16) | (m_bytes[6] << 8) | m_bytes[7]; }
                 uint8_t checksum() const { return m_bytes[8]; }
+                const uint8_t * bytes() const { return m_bytes; }
 
                 bool valid() const { return m_bytes[8] == m_checksum; }
 
@@ -210,26 +267,95 @@ class Motor {
                     for(int i = 0; i < 8; i++){
                         m_checksum += response[i];
                     }
+
+                    m_status = (Status)response[STATUS];
+                }
+
+                void set_status(Status status){
+                    m_status = status;
                 }
 
         };
 
+        /**
+         * Completion handler of a submitted command, called from the bus' I/O thread.
+         * Must not wait on this motor (ie call execute()), but may submit further commands.
+         */
+        typedef std::function<void(Response::Status status, const Response & response)> Callback;
 
-    Response::Status execute_raw(uint8_t * command, uint8_t * response, unsigned int timeout_ms);
+        /**
+         * Pass as timeout_ms to have it derived from the measured round-trip time of the port,
+         * queries are then retried a few times (see Bus::set_retries()).
+         */
+        const static unsigned int ADAPTIVE_TIMEOUT = 0;
+
+    protected:
 
-    Response::Status execute(Command command, Response * response, unsigned int timeout_ms) {
-        command.set_address(m_address);
-        command.compute_checksum();
+        // bumped by every new setpoint, queued setpoints of older generations are dropped
+        std::atomic<uint32_t> m_setpoint_generation{0};
+        std::atomic<uint32_t> m_superseded_count{0};
 
-        uint8_t rx[Response::SIZE];
+        // commands of this motor queued or in flight
+        std::atomic<uint32_t> m_pending{0};
 
-        Response::Status status = execute_raw(command.bytes(), rx, timeout_ms);
+        // recorded by the bus
+        Metrics m_metrics;
 
-        if (response)
-            response->set(rx);
+        bool enqueue(Command command, unsigned int timeout_ms, Callback callback, uint32_t generation, std::shared_ptr<SyncGroup> sync = nullptr, bool background = false);
 
-        return status;
-    }
+        uint32_t next_setpoint_generation();
+
+    public:
+
+    /**
+     * Starts the I/O thread of the (own) bus; from then on all commands (including the blocking command_* calls)
+     * are serialized through the command queue.
+     */
+    bool start();
+    void stop();
+
+    bool is_running() const;
+
+    /**
+     * See Bus::set_window(), applies to the own bus once opened.
+     */
+    void set_window(unsigned int window);
+
+    std::size_t queue_depth() const { return m_pending.load(); }
+
+    /**
+     * Enqueues command for the I/O thread, returns false (without calling callback) if the queue is full.
+     */
+    bool submit(Command command, unsigned int timeout_ms, Callback callback);
+    std::future<Response> submit(Command command, unsigned int timeout_ms);
+
+    /**
+     * Enqueues a setpoint (rotation velocity, target position) where only the latest one matters:
+     * while still queued it is dropped (status Superseded) as soon as a newer setpoint is submitted.
+     */
+    bool submit_setpoint(Command command, unsigned int timeout_ms, Callback callback);
+
+    /**
+     * Low priority command (eg telemetry), only sent while the bus has nothing else to do.
+     * Not counted in queue_depth().
+     */
+    bool submit_background(Command command, unsigned int timeout_ms, Callback callback);
+
+    /**
+     * Drops all queued setpoints, ie before an explicit stop.
+     */
+    void supersede_setpoints(){ m_setpoint_generation++; }
+
+    uint32_t superseded_count() const { return m_superseded_count.load(); }
+
+    /**
+     * Latencies and errors of the commands sent through the queue (ie once started).
+     */
+    const Metrics & metrics() const { return m_metrics; }
+
+    Response::Status execute_raw(uint8_t * command, uint8_t * response, unsigned int timeout_ms);
+
+    Response::Status execute(Command command, Response * response, unsigned int timeout_ms);
     Response::Status execute_with_value(Command command, uint32_t value, Response * response, unsigned int timeout_ms){
         command.set_value(value);
         return execute(command, response, timeout_ms);
@@ -280,31 +406,198 @@ class Motor {
 
     namespace PD_1160 {
 
-        const uint8_t GetVersion0[] = {01, 0x80, 00, 00, 00, 00, 00, 00, 0x89};
-        const uint8_t GetVersion1[] = {01, 00, 01, 00, 00, 00, 00, 00, 0x8A};
+        // axis parameters of motor 0 (SAP, GAP, STAP, RSAP)
+        namespace Axis {
+            enum : uint8_t {
+                TargetPosition              = 0,
+                ActualPosition              = 1,
+                TargetSpeed                 = 2,
+                ActualSpeed                 = 3,
+                MaxPositioningSpeed         = 4,
+                MaxAcceleration             = 5,
+                MaxCurrent                  = 6,
+                StandbyCurrent              = 7,
+                TargetPositionReached       = 8,
+                ReferenceSwitchStatus       = 9,
+                RightLimitSwitchStatus      = 10,
+                LeftLimitSwitchStatus       = 11,
+                RightLimitSwitchDisable     = 12,
+                LeftLimitSwitchDisable      = 13,
+                MinimumSpeed                = 130,
+                ActualAcceleration          = 135,
+                RampMode                    = 138,
+                MicroStepResolution         = 140,
+                ReferenceSwitchTolerance    = 141,
+                SoftStopFlag                = 149,
+                EndSwitchPowerDown          = 150,
+                RampDivisor                 = 153,
+                PulseDivisor                = 154,
+                Interpolation               = 160,
+                DoubleStepEnable            = 161,
+                ChopperBlankTime            = 162,
+                ChopperMode                 = 163,
+                ChopperHysteresisDecrement  = 164,
+                ChopperHysteresisEnd        = 165,
+                ChopperHysteresisStart      = 166,
+                ChopperOffTime              = 167,
+                SmartEnergyCurrentMinimum   = 168,
+                SmartEnergyCurrentDownStep  = 169,
+                SmartEnergyHysteresis       = 170,
+                SmartEnergyCurrentUpStep    = 171,
+                SmartEnergyHysteresisStart  = 172,
+                StallGuard2FilterEnable     = 173,
+                StallGuard2Threshold        = 174,
+                SlopeControlHighSide        = 175,
+                SlopeControlLowSide         = 176,
+                ShortProtectionDisable      = 177,
+                ShortDetectionTimer         = 178,
+                Vsense                      = 179,
+                SmartEnergyActualCurrent    = 180,
+                StopOnStall                 = 181,
+                SmartEnergyThresholdSpeed   = 182,
+                SmartEnergySlowRunCurrent   = 183,
+                RandomChopperOffTime        = 184,
+                ReferenceSearchMode         = 193,
+                ReferenceSearchSpeed        = 194,
+                ReferenceSwitchSpeed        = 195,
+                EndSwitchDistance           = 196,
+                LastReferencePosition       = 197,
+                BoostCurrent                = 200,
+                EncoderMode                 = 201,
+                MotorFullStepResolution     = 202,
+                FreewheelingDelay           = 204,
+                LoadValue                   = 206,
+                ExtendedErrorFlags          = 207,
+                DriverErrorFlags            = 208,
+                EncoderPosition             = 209,
+                EncoderResolution           = 210,
+                MaxEncoderDeviation         = 212,
+                PowerDownDelay              = 214,
+            };
+        }
 
-        const uint8_t MotorStop[] = {01, 03, 00, 00, 00, 00, 00, 00, 04};
+        // global parameters of bank 0 (SGP, GGP, STGP, RSGP)
+        namespace Global {
+            enum : uint8_t {
+                EEPROMMagic                 = 64,
+                RS485BaudRate               = 65,
+                SerialAddress               = 66,
+                ASCIIMode                   = 67,
+                SerialHeartbeat             = 68,
+                CANBitRate                  = 69,
+                CANReplyID                  = 70,
+                CANID                       = 71,
+                ConfigurationEEPROMLock     = 73,
+                TelegramPauseTime           = 75,
+                SerialHostAddress           = 76,
+                AutoStartMode               = 77,
+                EndSwitchPolarity           = 79,
+                ShutdownPinFunction         = 80,
+                TMCLCodeProtection          = 81,
+                CANHeartbeat                = 82,
+                CANSecondaryAddress         = 83,
+                CoordinateStorage           = 84,
+                DoNotRestoreUserVariables   = 85,
+                SerialSecondaryAddress      = 87,
+                ApplicationStatus           = 128,
+                DownloadMode                = 129,
+                ProgramCounter              = 130,
+                TickTimer                   = 132,
+                RandomNumber                = 133,
+                SuppressReply               = 255,
+            };
+
+            const static uint8_t USER_VARIABLE_BANK = 2;
+            const static uint8_t USER_VARIABLE_COUNT = 56;
+        }
 
-        const uint8_t RotateRight[]  = {0, 01, 00, 00, 00, 00, 00, 0, 0};
-        const uint8_t RotateLeft[] = {0, 02, 00, 00, 00, 00, 00, 0, 0};
-        const uint8_t MoveToPosition[] = {0, 04, 00, 00, 00, 01, 0x5f, 0x90, 0xF5};
+        // inputs (GIO)
+        namespace Input {
+            const static uint8_t DIGITAL_BANK = 0;
+            const static uint8_t ANALOG_BANK = 1;
 
-        const uint8_t GetAxisParam_ActualPosition[] = {01, 06, 01, 00, 00, 00, 00, 00, 0x0A};
-        const uint8_t SetAxisParam_ActualPosition[] = {01, 05, 01, 00, 00, 00, 00, 00, 00};
+            enum : uint8_t {
+                SupplyVoltage               = 8,   // analog, in 0.1 V
+                Temperature                 = 9,   // analog, in deg C
+            };
+        }
+
+        // fully encoded frames (module address 1, value 0 unless noted), patch value and address as needed
+        namespace Catalogue {
+            constexpr TMCL::Frame GetVersion0 = TMCL::Instruction<TMCL::GetVersion, 0>::frame();
+            constexpr TMCL::Frame GetVersion1 = TMCL::Instruction<TMCL::GetVersion, 1>::frame();
+
+            constexpr TMCL::Frame MotorStop = TMCL::Instruction<TMCL::MST>::frame();
+
+            constexpr TMCL::Frame RotateRight = TMCL::Instruction<TMCL::ROR>::frame();
+            constexpr TMCL::Frame RotateLeft = TMCL::Instruction<TMCL::ROL>::frame();
+            constexpr TMCL::Frame MoveToPosition = TMCL::Instruction<TMCL::MVP, 0>::frame();
+            constexpr TMCL::Frame MoveByPosition = TMCL::Instruction<TMCL::MVP, 1>::frame();
 
-        const uint8_t GetAxisParam_MicroStepResolution[] = {01, 06, 0x8C, 00, 00, 00, 00, 00, 0x93};
-        const uint8_t SetAxisParam_MicroStepResolution[] = {01, 05, 0x8C, 00, 00, 00, 00, 00, 00};
+            constexpr TMCL::Frame GetAxisParam_ActualPosition = TMCL::GetAxisParam<Axis::ActualPosition>::frame();
+            constexpr TMCL::Frame SetAxisParam_ActualPosition = TMCL::SetAxisParam<Axis::ActualPosition>::frame();
+            constexpr TMCL::Frame GetAxisParam_ActualSpeed = TMCL::GetAxisParam<Axis::ActualSpeed>::frame();
 
-	    const uint8_t SetAxisParam_Interpolation[] = {01, 05, 0xa0, 00, 00, 00, 00, 00, 00};
-        const uint8_t SetAxisParam_PulseDivisor[] = {01, 05, 0x9a, 00, 00, 00, 00, 00, 00};
-        const uint8_t SetAxisParam_RampDivisor[] = {01, 05, 0x99, 00, 00, 00, 00, 00, 00};
-        const uint8_t SetAxisParam_MaxCurrent[] = {01, 05, 06, 00, 00, 00, 00, 00, 00};
-        const uint8_t SetAxisParam_StandbyCurrent[] = {01, 05, 07, 00, 00, 00, 00, 00, 00};
-        const uint8_t SetAxisParam_PowerDownDelay[] = {01, 05, 0xd6, 00, 00, 00, 00, 00, 00};
-        const uint8_t SetAxisParam_MaxAcceleration[] = {01, 05, 05, 00, 00, 00, 00, 00, 00};
+            constexpr TMCL::Frame GetAxisParam_MicroStepResolution = TMCL::GetAxisParam<Axis::MicroStepResolution>::frame();
+            constexpr TMCL::Frame SetAxisParam_MicroStepResolution = TMCL::SetAxisParam<Axis::MicroStepResolution>::frame();
+
+            constexpr TMCL::Frame SetAxisParam_Interpolation = TMCL::SetAxisParam<Axis::Interpolation>::frame();
+            constexpr TMCL::Frame SetAxisParam_PulseDivisor = TMCL::SetAxisParam<Axis::PulseDivisor>::frame();
+            constexpr TMCL::Frame SetAxisParam_RampDivisor = TMCL::SetAxisParam<Axis::RampDivisor>::frame();
+            constexpr TMCL::Frame SetAxisParam_MaxCurrent = TMCL::SetAxisParam<Axis::MaxCurrent>::frame();
+            constexpr TMCL::Frame SetAxisParam_StandbyCurrent = TMCL::SetAxisParam<Axis::StandbyCurrent>::frame();
+            constexpr TMCL::Frame SetAxisParam_PowerDownDelay = TMCL::SetAxisParam<Axis::PowerDownDelay>::frame();
+            constexpr TMCL::Frame SetAxisParam_MaxAcceleration = TMCL::SetAxisParam<Axis::MaxAcceleration>::frame();
+
+            constexpr TMCL::Frame GetGIOVoltage = TMCL::GetInput<Input::SupplyVoltage, Input::ANALOG_BANK>::frame();
+            constexpr TMCL::Frame GetGIOTemperature = TMCL::GetInput<Input::Temperature, Input::ANALOG_BANK>::frame();
+        }
 
-	    const uint8_t GetGIOVoltage[] = {01, 0x0f, 8, 1, 00, 00, 00, 00, 0x19};
-	    const uint8_t GetGIOTemperature[] = {01, 0xf, 9, 01, 00, 00, 00, 00, 0x1A};
+        constexpr uint8_t GetVersion0[] = {01, 0x88, 00, 00, 00, 00, 00, 00, 0x89};
+        constexpr uint8_t GetVersion1[] = {01, 0x88, 01, 00, 00, 00, 00, 00, 0x8A};
+
+        constexpr uint8_t MotorStop[] = {01, 03, 00, 00, 00, 00, 00, 00, 04};
+
+        constexpr uint8_t RotateRight[]  = {01, 01, 00, 00, 00, 00, 00, 00, 02};
+        constexpr uint8_t RotateLeft[] = {01, 02, 00, 00, 00, 00, 00, 00, 03};
+        constexpr uint8_t MoveToPosition[] = {01, 04, 00, 00, 00, 01, 0x5f, 0x90, 0xF5};
+
+        constexpr uint8_t GetAxisParam_ActualPosition[] = {01, 06, 01, 00, 00, 00, 00, 00, 0x08};
+        constexpr uint8_t SetAxisParam_ActualPosition[] = {01, 05, 01, 00, 00, 00, 00, 00, 0x07};
+
+        constexpr uint8_t GetAxisParam_MicroStepResolution[] = {01, 06, 0x8C, 00, 00, 00, 00, 00, 0x93};
+        constexpr uint8_t SetAxisParam_MicroStepResolution[] = {01, 05, 0x8C, 00, 00, 00, 00, 00, 0x92};
+
+        constexpr uint8_t SetAxisParam_Interpolation[] = {01, 05, 0xa0, 00, 00, 00, 00, 00, 0xa6};
+        constexpr uint8_t SetAxisParam_PulseDivisor[] = {01, 05, 0x9a, 00, 00, 00, 00, 00, 0xa0};
+        constexpr uint8_t SetAxisParam_RampDivisor[] = {01, 05, 0x99, 00, 00, 00, 00, 00, 0x9f};
+        constexpr uint8_t SetAxisParam_MaxCurrent[] = {01, 05, 06, 00, 00, 00, 00, 00, 0x0c};
+        constexpr uint8_t SetAxisParam_StandbyCurrent[] = {01, 05, 07, 00, 00, 00, 00, 00, 0x0d};
+        constexpr uint8_t SetAxisParam_PowerDownDelay[] = {01, 05, 0xd6, 00, 00, 00, 00, 00, 0xdc};
+        constexpr uint8_t SetAxisParam_MaxAcceleration[] = {01, 05, 05, 00, 00, 00, 00, 00, 0x0b};
+
+        constexpr uint8_t GetGIOVoltage[] = {01, 0x0f, 8, 1, 00, 00, 00, 00, 0x19};
+        constexpr uint8_t GetGIOTemperature[] = {01, 0xf, 9, 01, 00, 00, 00, 00, 0x1A};
+
+        static_assert(TMCL::equal(Catalogue::GetVersion0, GetVersion0), "GetVersion0");
+        static_assert(TMCL::equal(Catalogue::GetVersion1, GetVersion1), "GetVersion1");
+        static_assert(TMCL::equal(Catalogue::MotorStop, MotorStop), "MotorStop");
+        static_assert(TMCL::equal(Catalogue::RotateRight, RotateRight), "RotateRight");
+        static_assert(TMCL::equal(Catalogue::RotateLeft, RotateLeft), "RotateLeft");
+        static_assert(TMCL::equal(TMCL::Instruction<TMCL::MVP, 0>::frame(90000), MoveToPosition), "MoveToPosition");
+        static_assert(TMCL::equal(Catalogue::GetAxisParam_ActualPosition, GetAxisParam_ActualPosition), "GetAxisParam_ActualPosition");
+        static_assert(TMCL::equal(Catalogue::SetAxisParam_ActualPosition, SetAxisParam_ActualPosition), "SetAxisParam_ActualPosition");
+        static_assert(TMCL::equal(Catalogue::GetAxisParam_MicroStepResolution, GetAxisParam_MicroStepResolution), "GetAxisParam_MicroStepResolution");
+        static_assert(TMCL::equal(Catalogue::SetAxisParam_MicroStepResolution, SetAxisParam_MicroStepResolution), "SetAxisParam_MicroStepResolution");
+        static_assert(TMCL::equal(Catalogue::SetAxisParam_Interpolation, SetAxisParam_Interpolation), "SetAxisParam_Interpolation");
+        static_assert(TMCL::equal(Catalogue::SetAxisParam_PulseDivisor, SetAxisParam_PulseDivisor), "SetAxisParam_PulseDivisor");
+        static_assert(TMCL::equal(Catalogue::SetAxisParam_RampDivisor, SetAxisParam_RampDivisor), "SetAxisParam_RampDivisor");
+        static_assert(TMCL::equal(Catalogue::SetAxisParam_MaxCurrent, SetAxisParam_MaxCurrent), "SetAxisParam_MaxCurrent");
+        static_assert(TMCL::equal(Catalogue::SetAxisParam_StandbyCurrent, SetAxisParam_StandbyCurrent), "SetAxisParam_StandbyCurrent");
+        static_assert(TMCL::equal(Catalogue::SetAxisParam_PowerDownDelay, SetAxisParam_PowerDownDelay), "SetAxisParam_PowerDownDelay");
+        static_assert(TMCL::equal(Catalogue::SetAxisParam_MaxAcceleration, SetAxisParam_MaxAcceleration), "SetAxisParam_MaxAcceleration");
+        static_assert(TMCL::equal(Catalogue::GetGIOVoltage, GetGIOVoltage), "GetGIOVoltage");
+        static_assert(TMCL::equal(Catalogue::GetGIOTemperature, GetGIOTemperature), "GetGIOTemperature");
     }
 }
 
@@ -0,0 +1,118 @@
+#include "odometry.hpp"
+
+#include <cmath>
+
+namespace MobSpkr {
+
+    static const int LEFT = 0;
+    static const int RIGHT = 1;
+
+    static double normalize(double angle) {
+        angle = std::fmod(angle + M_PI, 2 * M_PI);
+        if (angle <= 0)
+            angle += 2 * M_PI;
+        return angle - M_PI;
+    }
+
+    Odometry::Odometry() : m_wheelbase(1) {
+        for(Wheel & wheel : m_wheels){
+            wheel.index = (std::size_t)-1;
+            wheel.scale = 0;
+            wheel.last = 0;
+            wheel.known = false;
+            wheel.pending = 0;
+            wheel.fresh = false;
+        }
+    }
+
+    void Odometry::configure(std::size_t left, double left_scale, std::size_t right, double right_scale, double wheelbase) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_wheels[LEFT].index = left;
+        m_wheels[LEFT].scale = left_scale;
+        m_wheels[RIGHT].index = right;
+        m_wheels[RIGHT].scale = right_scale;
+        m_wheelbase = wheelbase;
+
+        for(Wheel & wheel : m_wheels){
+            wheel.known = false;
+            wheel.pending = 0;
+            wheel.fresh = false;
+        }
+    }
+
+    void Odometry::integrate(clock::time_point time) {
+        double left = m_wheels[LEFT].pending;
+        double right = m_wheels[RIGHT].pending;
+
+        // along the arc's chord, ie at the mean heading
+        double distance = (left + right) / 2;
+        double turn = (right - left) / m_wheelbase;
+
+        m_pose.x += distance * std::cos(m_pose.heading + turn / 2);
+        m_pose.y += distance * std::sin(m_pose.heading + turn / 2);
+        m_pose.heading = normalize(m_pose.heading + turn);
+        m_pose.time = time;
+        m_pose.valid = true;
+
+        for(Wheel & wheel : m_wheels){
+            wheel.pending = 0;
+            wheel.fresh = false;
+        }
+    }
+
+    void Odometry::sampled(std::size_t index, int32_t position, clock::time_point time) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        int w = index == m_wheels[LEFT].index ? LEFT : index == m_wheels[RIGHT].index ? RIGHT : -1;
+        if (w < 0)
+            return;
+
+        Wheel & wheel = m_wheels[w];
+        if (!wheel.known){
+            wheel.last = position;
+            wheel.known = true;
+            return;
+        }
+
+        // modulo 2^32, correct across wraparound
+        int32_t delta = (int32_t)((uint32_t)position - (uint32_t)wheel.last);
+        wheel.last = position;
+
+        // the other wheel's sample is late, don't hold this one back
+        if (wheel.fresh)
+            integrate(time);
+
+        wheel.pending += delta * wheel.scale;
+        wheel.fresh = true;
+
+        // both wheels over (about) the same interval
+        if (m_wheels[LEFT].fresh && m_wheels[RIGHT].fresh)
+            integrate(time);
+    }
+
+    void Odometry::rebase(std::size_t index) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for(Wheel & wheel : m_wheels){
+            if (wheel.index == index)
+                wheel.known = false;
+        }
+    }
+
+    void Odometry::set_pose(double x, double y, double heading) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_pose.x = x;
+        m_pose.y = y;
+        m_pose.heading = normalize(heading);
+        m_pose.time = clock::now();
+        m_pose.valid = true;
+    }
+
+    Odometry::Pose Odometry::get_pose() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_pose;
+    }
+
+}
@@ -0,0 +1,77 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_ODOMETRY_HPP
+#define MOBSPKR_VEHICLE_CTRL_ODOMETRY_HPP
+
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace MobSpkr {
+
+/**
+ * Dead reckoning of a differential drive vehicle from the actual positions of its two wheel motors.
+ *
+ * Position samples may come in at any rate and in any order, the distance travelled is taken from the
+ * difference of successive samples (int32 wraparound included), so a missed sample only coarsens the path.
+ * Pose is in m and rad, heading 0 along x and counterclockwise positive.
+ */
+class Odometry {
+
+    public:
+
+        typedef std::chrono::steady_clock clock;
+
+        struct Pose {
+            double x = 0;
+            double y = 0;
+            double heading = 0;
+            // of the latest sample integrated
+            clock::time_point time;
+            bool valid = false;
+        };
+
+    protected:
+
+        struct Wheel {
+            std::size_t index;
+            // m per step, negative if mounted mirrored
+            double scale;
+            int32_t last;
+            bool known;
+            // travelled since the last integration
+            double pending;
+            bool fresh;
+        };
+
+        Wheel m_wheels[2];
+        double m_wheelbase;
+
+        Pose m_pose;
+        std::mutex m_mutex;
+
+        void integrate(clock::time_point time);
+
+    public:
+
+        Odometry();
+
+        void configure(std::size_t left, double left_scale, std::size_t right, double right_scale, double wheelbase);
+
+        /**
+         * Actual position of any motor, those not driving a wheel are ignored.
+         */
+        void sampled(std::size_t index, int32_t position, clock::time_point time);
+
+        /**
+         * The motor's position has been set (eg reset to 0), the next sample is not to be taken as travel.
+         */
+        void rebase(std::size_t index);
+
+        void set_pose(double x, double y, double heading);
+
+        Pose get_pose();
+};
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_ODOMETRY_HPP
@@ -0,0 +1,88 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_POLLER_HPP
+#define MOBSPKR_VEHICLE_CTRL_POLLER_HPP
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+namespace MobSpkr {
+
+/**
+ * Periodic work: either call poll() when due (event loop) or have it run a thread of its own (start()).
+ * Derived classes must stop() in their destructor.
+ */
+class Poller {
+
+    public:
+
+        typedef std::chrono::steady_clock clock;
+
+    protected:
+
+        std::thread m_thread;
+        std::atomic<bool> m_running{false};
+        std::mutex m_stop_mutex;
+        std::condition_variable m_stop;
+        bool m_woken = false;
+
+        void run(){
+            while(m_running.load()){
+                clock::time_point next = poll(clock::now());
+
+                // not while polling, poll() may wait for whoever calls wake()
+                std::unique_lock<std::mutex> lock(m_stop_mutex);
+                m_stop.wait_until(lock, next, [this]{ return !m_running.load() || m_woken; });
+                m_woken = false;
+            }
+        }
+
+    public:
+
+        Poller() {}
+        Poller(const Poller &) = delete;
+        Poller & operator=(const Poller &) = delete;
+        virtual ~Poller() {}
+
+        /**
+         * Does whatever is due, returns when to call again.
+         */
+        virtual clock::time_point poll(clock::time_point now) = 0;
+
+        bool start(){
+            if (m_running.exchange(true))
+                return true;
+
+            m_thread = std::thread(&Poller::run, this);
+            return true;
+        }
+
+        /**
+         * Polls again right away (thread only), eg when something got due earlier than returned by poll().
+         */
+        void wake(){
+            {
+                std::lock_guard<std::mutex> lock(m_stop_mutex);
+                m_woken = true;
+            }
+            m_stop.notify_one();
+        }
+
+        void stop(){
+            if (!m_running.exchange(false))
+                return;
+
+            {
+                std::lock_guard<std::mutex> lock(m_stop_mutex);
+            }
+            m_stop.notify_one();
+
+            if (m_thread.joinable())
+                m_thread.join();
+        }
+};
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_POLLER_HPP
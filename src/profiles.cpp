@@ -0,0 +1,170 @@
+#include "profiles.hpp"
+
+#include <cmath>
+
+namespace MobSpkr {
+
+    // when idle, poll() is to be called again on the next target anyway
+    static const std::chrono::seconds IDLE_POLL(1);
+
+    void Profiles::configure(unsigned int jerk, unsigned int max_acceleration, unsigned int tick_hz) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_jerk = jerk;
+        m_max_acceleration = max_acceleration;
+        m_tick = std::chrono::microseconds(1000000 / tick_hz);
+    }
+
+    void Profiles::resize(std::size_t count) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_states.resize(count);
+    }
+
+    void Profiles::set_target(std::size_t index, int32_t velocity) {
+        bool start;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (index >= m_states.size())
+                return;
+
+            State & state = m_states[index];
+            state.target = velocity;
+            state.active = true;
+
+            start = m_idle;
+            if (start){
+                m_idle = false;
+                m_next = clock::now();
+            }
+        }
+
+        if (!start)
+            return;
+
+        if (m_notify)
+            m_notify(m_next);
+        else
+            wake();
+    }
+
+    void Profiles::reset(std::size_t index, int32_t velocity) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (index >= m_states.size())
+            return;
+
+        State & state = m_states[index];
+        state.velocity = velocity;
+        state.acceleration = 0;
+        state.target = velocity;
+        state.output = velocity;
+        state.active = false;
+    }
+
+    int32_t Profiles::get_target(std::size_t index) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return index < m_states.size() ? m_states[index].target : 0;
+    }
+
+    bool Profiles::is_idle() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_idle;
+    }
+
+    // velocity gained after a tick at acceleration, while bringing it back to 0 one jerk step per tick
+    static float ramp_down(float acceleration, float jerk_step, float dt) {
+        float a = std::fabs(acceleration);
+        float n = std::floor(a / jerk_step);
+        float gained = (n * a - jerk_step * n * (n + 1) / 2) * dt;
+        return acceleration < 0 ? -gained : gained;
+    }
+
+    bool Profiles::step(State & state, float dt) {
+        float error = state.target - state.velocity;
+        float jerk_step = m_jerk * dt;
+
+        // close enough to settle within this tick
+        if (std::fabs(error) <= std::fabs(state.acceleration) * dt + jerk_step * dt && std::fabs(state.acceleration) <= jerk_step){
+            state.velocity = state.target;
+            state.acceleration = 0;
+            return true;
+        }
+
+        float direction = error > 0 ? 1 : -1;
+
+        // push harder, hold or ease off: whichever is the most that still stops at the target
+        float candidates[] = {
+            state.acceleration + direction * jerk_step,
+            state.acceleration,
+            state.acceleration - direction * jerk_step,
+        };
+
+        float acceleration = candidates[2];
+        for(float a : candidates){
+            if (std::fabs(a) > m_max_acceleration)
+                a = a < 0 ? -m_max_acceleration : m_max_acceleration;
+
+            float reached = state.velocity + a * dt + ramp_down(a, jerk_step, dt);
+            if (direction * (state.target - reached) >= 0){
+                acceleration = a;
+                break;
+            }
+        }
+
+        state.acceleration = acceleration;
+        state.velocity += state.acceleration * dt;
+        return false;
+    }
+
+    Profiles::clock::time_point Profiles::poll(clock::time_point now) {
+        std::vector<Change> changes;
+        clock::time_point next;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (m_idle)
+                return now + IDLE_POLL;
+
+            // called early (eg woken), nothing due yet
+            if (now < m_next)
+                return m_next;
+
+            float dt = std::chrono::duration<float>(m_tick).count();
+
+            bool active = false;
+            for(std::size_t i = 0; i < m_states.size(); i++){
+                State & state = m_states[i];
+                if (!state.active)
+                    continue;
+
+                if (step(state, dt))
+                    state.active = false;
+                else
+                    active = true;
+
+                int32_t velocity = (int32_t)std::lround(state.velocity);
+                if (velocity != state.output){
+                    state.output = velocity;
+                    Change change = {i, velocity};
+                    changes.push_back(change);
+                }
+            }
+
+            // fixed rate, unless too late to catch up
+            m_next += m_tick;
+            if (m_next <= now)
+                m_next = now + m_tick;
+
+            m_idle = !active;
+            next = m_idle ? now + IDLE_POLL : m_next;
+        }
+
+        m_output(changes);
+
+        return next;
+    }
+
+}
@@ -0,0 +1,100 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_PROFILES_HPP
+#define MOBSPKR_VEHICLE_CTRL_PROFILES_HPP
+
+#include "poller.hpp"
+
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+namespace MobSpkr {
+
+/**
+ * Jerk limited (S-curve) velocity profiles: velocity targets are approached in steps at a fixed tick rate,
+ * with acceleration and its rate of change (jerk) bounded.
+ *
+ * All motors share one tick, only those still ramping are computed and output gets the velocities changed
+ * in a tick all at once, so they may go out together.
+ */
+class Profiles : public Poller {
+
+    public:
+
+        // velocities in module units, acceleration per second, jerk per second^2
+        const static unsigned int DEFAULT_ACCELERATION = 2000;
+        const static unsigned int DEFAULT_JERK = 8000;
+        const static unsigned int DEFAULT_TICK_HZ = 50;
+        const static unsigned int MAX_TICK_HZ = 1000;
+
+        struct Change {
+            std::size_t index;
+            int32_t velocity;
+        };
+
+        // on every tick with motors ramping, even if none of the velocities changed (eg the target was reached)
+        typedef std::function<void(const std::vector<Change> & changes)> Output;
+
+        // the first target after being idle, for the tick to start
+        typedef std::function<void(clock::time_point tick)> Notify;
+
+    protected:
+
+        struct State {
+            float velocity = 0;
+            float acceleration = 0;
+            int32_t target = 0;
+            int32_t output = 0;
+            bool active = false;
+        };
+
+        Output m_output;
+        Notify m_notify;
+
+        float m_jerk;
+        float m_max_acceleration;
+        clock::duration m_tick;
+        clock::time_point m_next;
+
+        std::vector<State> m_states;
+        bool m_idle;
+        std::mutex m_mutex;
+
+        // true once at the target
+        bool step(State & state, float dt);
+
+    public:
+
+        Profiles(Output output)
+            : m_output(std::move(output)), m_jerk(DEFAULT_JERK), m_max_acceleration(DEFAULT_ACCELERATION),
+              m_tick(std::chrono::microseconds(1000000 / DEFAULT_TICK_HZ)), m_idle(true) {}
+        ~Profiles(){ stop(); }
+
+        void configure(unsigned int jerk, unsigned int max_acceleration, unsigned int tick_hz);
+
+        void set_notify(Notify notify){ m_notify = std::move(notify); }
+
+        void resize(std::size_t count);
+
+        /**
+         * Starts ramping (from wherever the motor is) towards the given velocity.
+         */
+        void set_target(std::size_t index, int32_t velocity);
+
+        /**
+         * Sets the velocity as is, eg after an immediate stop.
+         */
+        void reset(std::size_t index, int32_t velocity = 0);
+
+        int32_t get_target(std::size_t index);
+
+        bool is_idle();
+
+        /**
+         * Steps all ramping motors, returns the next tick.
+         */
+        clock::time_point poll(clock::time_point now) override;
+};
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_PROFILES_HPP
@@ -0,0 +1,109 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_QUEUE_HPP
+#define MOBSPKR_VEHICLE_CTRL_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace MobSpkr {
+
+/**
+ * Bounded lock-free multi-producer/multi-consumer queue (after D. Vyukov).
+ * Producers and consumers never block each other; push() fails when full.
+ */
+template<typename T, std::size_t N>
+class Queue {
+
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "Queue size must be a power of two");
+
+    protected:
+
+        struct Cell {
+            std::atomic<std::size_t> sequence;
+            T data;
+        };
+
+        Cell m_cells[N];
+
+        alignas(64) std::atomic<std::size_t> m_enqueue_pos;
+        alignas(64) std::atomic<std::size_t> m_dequeue_pos;
+
+    public:
+
+        Queue(){
+            for(std::size_t i = 0; i < N; i++){
+                m_cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+            m_enqueue_pos.store(0, std::memory_order_relaxed);
+            m_dequeue_pos.store(0, std::memory_order_relaxed);
+        }
+
+        Queue(const Queue &) = delete;
+        Queue & operator=(const Queue &) = delete;
+
+        bool push(T && value){
+            Cell * cell;
+            std::size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+
+            for(;;){
+                cell = &m_cells[pos & (N - 1)];
+                std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+                std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+
+                if (diff == 0){
+                    if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                } else if (diff < 0){
+                    return false; // full
+                } else {
+                    pos = m_enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
+
+            cell->data = std::move(value);
+            cell->sequence.store(pos + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        bool pop(T & value){
+            Cell * cell;
+            std::size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+
+            for(;;){
+                cell = &m_cells[pos & (N - 1)];
+                std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+                std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)(pos + 1);
+
+                if (diff == 0){
+                    if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                } else if (diff < 0){
+                    return false; // empty
+                } else {
+                    pos = m_dequeue_pos.load(std::memory_order_relaxed);
+                }
+            }
+
+            value = std::move(cell->data);
+            cell->data = T();
+            cell->sequence.store(pos + N, std::memory_order_release);
+
+            return true;
+        }
+
+        // approximate when used concurrently
+        std::size_t size() const {
+            std::size_t enq = m_enqueue_pos.load(std::memory_order_acquire);
+            std::size_t deq = m_dequeue_pos.load(std::memory_order_acquire);
+            return enq > deq ? enq - deq : 0;
+        }
+
+        bool empty() const { return size() == 0; }
+
+        constexpr static std::size_t capacity() { return N; }
+};
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_QUEUE_HPP
@@ -0,0 +1,250 @@
+#include "reactor.hpp"
+#include "log.hpp"
+
+#ifdef __linux__
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <csignal>
+#include <cerrno>
+#include <cstdio>
+
+namespace MobSpkr {
+
+    static sigset_t stop_signals(){
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, SIGINT);
+        sigaddset(&set, SIGTERM);
+        return set;
+    }
+
+    Reactor::Reactor() {
+        m_stopping = false;
+
+        m_epoll = epoll_create1(EPOLL_CLOEXEC);
+        m_timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        m_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        // signals are taken from the signalfd only
+        sigset_t set = stop_signals();
+        sigprocmask(SIG_BLOCK, &set, NULL);
+        m_signal = signalfd(-1, &set, SFD_NONBLOCK | SFD_CLOEXEC);
+
+        if (!is_ok()){
+            perror("reactor");
+            return;
+        }
+
+        add_fd(m_timer, EPOLLIN);
+        add_fd(m_wakeup, EPOLLIN);
+        add_fd(m_signal, EPOLLIN);
+    }
+
+    Reactor::~Reactor() {
+        sigset_t set = stop_signals();
+        sigprocmask(SIG_UNBLOCK, &set, NULL);
+
+        for(int fd : {m_epoll, m_timer, m_signal, m_wakeup}){
+            if (fd >= 0)
+                ::close(fd);
+        }
+    }
+
+    bool Reactor::add_fd(int fd, uint32_t events) {
+        struct epoll_event ev = {};
+        ev.events = events;
+        ev.data.fd = fd;
+
+        if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &ev) != 0){
+            perror("epoll_ctl");
+            return false;
+        }
+        return true;
+    }
+
+    bool Reactor::watch(int fd, Handler handler) {
+        if (!add_fd(fd, EPOLLIN))
+            return false;
+
+        m_handlers[fd] = std::move(handler);
+        return true;
+    }
+
+    void Reactor::unwatch(int fd) {
+        epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, NULL);
+        m_handlers.erase(fd);
+    }
+
+    bool Reactor::add(Bus * bus) {
+        int fd = bus->get_fd();
+        if (fd < 0){
+            Log::error("bus %s: no file descriptor\n", bus->get_portname());
+            return false;
+        }
+
+        // left from before the bus was stopped or reopened (eg after a hangup), its fd may be closed or reused
+        for(std::vector<Port>::iterator it = m_ports.begin(); it != m_ports.end(); ){
+            if (it->bus != bus && it->fd != fd){
+                it++;
+                continue;
+            }
+            if (m_handlers.find(it->fd) == m_handlers.end())
+                epoll_ctl(m_epoll, EPOLL_CTL_DEL, it->fd, NULL);
+            it = m_ports.erase(it);
+        }
+
+        if (!bus->start_polled([this]{ wakeup(); }))
+            return false;
+
+        if (!add_fd(fd, EPOLLIN)){
+            bus->stop();
+            return false;
+        }
+
+        Port port;
+        port.bus = bus;
+        port.fd = fd;
+        port.writing = false;
+        m_ports.push_back(port);
+
+        return true;
+    }
+
+    void Reactor::at(clock::time_point when, Task task) {
+        m_tasks.insert(std::make_pair(when, std::move(task)));
+    }
+
+    void Reactor::wakeup() {
+        uint64_t one = 1;
+        if (::write(m_wakeup, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            perror("reactor wakeup");
+    }
+
+    void Reactor::arm_timer() {
+        bool any = false;
+        clock::time_point next;
+
+        if (!m_tasks.empty()){
+            next = m_tasks.begin()->first;
+            any = true;
+        }
+
+        for(Port & port : m_ports){
+            clock::time_point deadline;
+            if (port.bus->is_running() && port.bus->next_deadline(deadline) && (!any || deadline < next)){
+                next = deadline;
+                any = true;
+            }
+        }
+
+        // steady_clock is CLOCK_MONOTONIC; all zero disarms, so a deadline in the past must not be 0
+        struct itimerspec spec = {};
+        if (any){
+            std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>(next.time_since_epoch());
+            if (ns.count() <= 0)
+                ns = std::chrono::nanoseconds(1);
+            spec.it_value.tv_sec = ns.count() / 1000000000;
+            spec.it_value.tv_nsec = ns.count() % 1000000000;
+        }
+
+        timerfd_settime(m_timer, TFD_TIMER_ABSTIME, &spec, NULL);
+    }
+
+    void Reactor::run() {
+        if (!is_ok())
+            return;
+
+        m_stopping = false;
+
+        const int MAX_EVENTS = 16;
+        struct epoll_event events[MAX_EVENTS];
+
+        while(!m_stopping){
+
+            arm_timer();
+
+            int n = epoll_wait(m_epoll, events, MAX_EVENTS, -1);
+            if (n < 0){
+                if (errno == EINTR)
+                    continue;
+                perror("epoll_wait");
+                break;
+            }
+
+            for(int i = 0; i < n; i++){
+                int fd = events[i].data.fd;
+
+                if (fd == m_timer || fd == m_wakeup){
+                    uint64_t count;
+                    while(::read(fd, &count, sizeof(count)) > 0)
+                        ;
+                    continue;
+                }
+
+                if (fd == m_signal){
+                    struct signalfd_siginfo info;
+                    while(::read(fd, &info, sizeof(info)) > 0){
+                        Log::info("received signal %d, stopping\n", info.ssi_signo);
+                        m_stopping = true;
+                    }
+                    continue;
+                }
+
+                std::vector<Port>::iterator port = m_ports.begin();
+                while(port != m_ports.end() && (port->fd != fd || !port->bus->is_running()))
+                    port++;
+                if (port != m_ports.end()){
+                    if (events[i].events & (EPOLLERR | EPOLLHUP)){
+                        // eg unplugged, would fire forever; closed, so a retry opens the device again
+                        Log::error("bus %s: hangup\n", port->bus->get_portname());
+                        epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, NULL);
+                        Bus * bus = port->bus;
+                        m_ports.erase(port);
+                        bus->close();
+                    } else {
+                        port->bus->process(events[i].events & EPOLLIN);
+                    }
+                    continue;
+                }
+
+                std::map<int, Handler>::iterator it = m_handlers.find(fd);
+                if (it != m_handlers.end()){
+                    // the handler may unwatch itself
+                    Handler handler = it->second;
+                    handler(events[i].events);
+                }
+            }
+
+            clock::time_point now = clock::now();
+            while(!m_tasks.empty() && m_tasks.begin()->first <= now){
+                Task task = std::move(m_tasks.begin()->second);
+                m_tasks.erase(m_tasks.begin());
+                task();
+            }
+
+            // timeouts and whatever has been queued meanwhile
+            for(Port & port : m_ports){
+                if (!port.bus->is_running())
+                    continue;
+
+                port.bus->process(false);
+
+                bool writing = port.bus->wants_write();
+                if (writing != port.writing){
+                    struct epoll_event ev = {};
+                    ev.events = EPOLLIN | (writing ? (uint32_t)EPOLLOUT : 0);
+                    ev.data.fd = port.fd;
+                    epoll_ctl(m_epoll, EPOLL_CTL_MOD, port.fd, &ev);
+                    port.writing = writing;
+                }
+            }
+        }
+    }
+
+}
+
+#endif //__linux__
@@ -0,0 +1,94 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_REACTOR_HPP
+#define MOBSPKR_VEHICLE_CTRL_REACTOR_HPP
+
+#ifdef __linux__
+
+#include "bus.hpp"
+
+#include <map>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+
+namespace MobSpkr {
+
+/**
+ * Single threaded event loop (epoll) for sockets, buses and timers.
+ *
+ * Buses added are driven without I/O threads (see Bus::start_polled()), so all callbacks
+ * are called from the thread calling run(). SIGINT and SIGTERM stop the loop.
+ */
+class Reactor {
+
+    public:
+
+        typedef std::chrono::steady_clock clock;
+
+        // epoll events
+        typedef std::function<void(uint32_t events)> Handler;
+
+        typedef std::function<void()> Task;
+
+    protected:
+
+        struct Port {
+            Bus * bus;
+            int fd;
+            bool writing;
+        };
+
+        int m_epoll;
+        int m_timer;
+        int m_signal;
+        int m_wakeup;
+
+        std::map<int, Handler> m_handlers;
+        std::vector<Port> m_ports;
+        std::multimap<clock::time_point, Task> m_tasks;
+
+        bool m_stopping;
+
+        bool add_fd(int fd, uint32_t events);
+        void arm_timer();
+
+    public:
+
+        Reactor();
+        Reactor(const Reactor &) = delete;
+        Reactor & operator=(const Reactor &) = delete;
+        ~Reactor();
+
+        bool is_ok() const { return m_epoll >= 0 && m_timer >= 0 && m_signal >= 0 && m_wakeup >= 0; }
+
+        /**
+         * Calls handler whenever fd is readable.
+         */
+        bool watch(int fd, Handler handler);
+        void unwatch(int fd);
+
+        /**
+         * Starts driving bus (which must be open), until it is stopped or hangs up (then it is closed as well).
+         */
+        bool add(Bus * bus);
+
+        void at(clock::time_point when, Task task);
+        void after(unsigned int ms, Task task){
+            at(clock::now() + std::chrono::milliseconds(ms), std::move(task));
+        }
+
+        // may be called from any thread
+        void wakeup();
+
+        /**
+         * Runs until SIGINT, SIGTERM or stop().
+         */
+        void run();
+        void stop(){ m_stopping = true; }
+};
+
+}
+
+#endif //__linux__
+
+#endif //MOBSPKR_VEHICLE_CTRL_REACTOR_HPP
@@ -0,0 +1,170 @@
+#include "recorder.hpp"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <cerrno>
+
+namespace MobSpkr {
+
+    const char Recorder::MAGIC[8] = {'M', 'S', 'P', 'K', 'R', 'O', 'S', 'C'};
+
+    static std::size_t aligned(std::size_t size) {
+        return (size + Recorder::ALIGNMENT - 1) & ~(Recorder::ALIGNMENT - 1);
+    }
+
+    bool Recorder::open(const char * path) {
+        close();
+
+        m_fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (m_fd < 0)
+            return false;
+
+        m_used = 0;
+        m_count = 0;
+        if (!grow(sizeof(Header))){
+            close();
+            return false;
+        }
+
+        Header * header = (Header *)m_map;
+        std::memcpy(header->magic, MAGIC, sizeof(header->magic));
+        header->version = VERSION;
+        header->header_size = sizeof(Header);
+        header->started_unix_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        m_used = aligned(sizeof(Header));
+
+        m_started = clock::now();
+
+        return true;
+    }
+
+    void Recorder::close() {
+        if (m_map){
+            munmap(m_map, m_mapped);
+            m_map = NULL;
+            m_mapped = 0;
+        }
+        if (m_fd >= 0){
+            // without the unused rest
+            if (ftruncate(m_fd, m_used) == 0)
+                fsync(m_fd);
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    bool Recorder::grow(std::size_t needed) {
+        if (m_used + needed <= m_mapped)
+            return true;
+
+        std::size_t size = m_mapped + GROW_SIZE;
+        while(size < m_used + needed)
+            size += GROW_SIZE;
+
+        // allocated rather than sparse: a full disk has to fail here, not raise SIGBUS when writing to the mapping
+        int error = posix_fallocate(m_fd, m_mapped, size - m_mapped);
+        if (error){
+            errno = error;
+            return false;
+        }
+
+        // the file is only ever extended, the old mapping stays valid until replaced
+        void * map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (map == MAP_FAILED)
+            return false;
+
+        if (m_map)
+            munmap(m_map, m_mapped);
+        m_map = (char *)map;
+        m_mapped = size;
+
+        return true;
+    }
+
+    bool Recorder::append(const char * data, std::size_t size, uint32_t address, int port) {
+        if (m_map == NULL || size == 0)
+            return false;
+
+        std::size_t length = sizeof(Record) + aligned(size);
+        if (!grow(length))
+            return false;
+
+        Record * record = (Record *)(m_map + m_used);
+        record->time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - m_started).count();
+        record->address = address;
+        record->port = port;
+        std::memcpy(m_map + m_used + sizeof(Record), data, size);
+        // last, a reader stops at a size of 0
+        record->size = size;
+
+        m_used += length;
+        m_count++;
+
+        return true;
+    }
+
+    bool Recording::open(const char * path) {
+        close();
+
+        m_fd = ::open(path, O_RDONLY);
+        if (m_fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(m_fd, &st) || (std::size_t)st.st_size < sizeof(Recorder::Header)){
+            close();
+            return false;
+        }
+
+        void * map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+        if (map == MAP_FAILED){
+            close();
+            return false;
+        }
+        m_map = (const char *)map;
+        m_size = st.st_size;
+
+        if (std::memcmp(header().magic, Recorder::MAGIC, sizeof(Recorder::MAGIC)) != 0 || header().version != Recorder::VERSION){
+            close();
+            return false;
+        }
+
+        rewind();
+        return true;
+    }
+
+    void Recording::close() {
+        if (m_map){
+            munmap((void *)m_map, m_size);
+            m_map = NULL;
+            m_size = 0;
+        }
+        if (m_fd >= 0){
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    void Recording::rewind() {
+        m_offset = m_map ? aligned(header().header_size) : 0;
+    }
+
+    bool Recording::next(const Recorder::Record *& record, const char *& data) {
+        if (m_map == NULL || m_offset + sizeof(Recorder::Record) > m_size)
+            return false;
+
+        record = (const Recorder::Record *)(m_map + m_offset);
+        // the end, or cut short
+        if (record->size == 0 || m_offset + sizeof(Recorder::Record) + record->size > m_size)
+            return false;
+
+        data = m_map + m_offset + sizeof(Recorder::Record);
+        m_offset += sizeof(Recorder::Record) + aligned(record->size);
+
+        return true;
+    }
+
+}
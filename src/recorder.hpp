@@ -0,0 +1,122 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_RECORDER_HPP
+#define MOBSPKR_VEHICLE_CTRL_RECORDER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+
+namespace MobSpkr {
+
+/**
+ * Append-only log of received datagrams (monotonic time, source and contents) in a memory-mapped file,
+ * eg to be replayed with osc-replay.
+ *
+ * Appending is a copy into the mapping: the file grows by GROW_SIZE at a time (allocated before it is mapped,
+ * so a full disk fails append() instead of raising SIGBUS) and is cut to what was written by close(). Should the process die, the records written so far are intact (followed by zeros).
+ * Not thread-safe, meant to be called by whoever receives.
+ */
+class Recorder {
+
+    public:
+
+        typedef std::chrono::steady_clock clock;
+
+        const static uint32_t VERSION = 1;
+        const static std::size_t GROW_SIZE = 4 * 1024 * 1024;
+        // records (and their data) start at multiples of
+        const static std::size_t ALIGNMENT = 8;
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t header_size;
+            // wall clock at open(), for reference
+            int64_t started_unix_ns;
+        };
+
+        struct Record {
+            // since open()
+            uint64_t time_ns;
+            // source, host byte order
+            uint32_t address;
+            uint16_t port;
+            uint16_t reserved;
+            // of the data following, 0 marks the end
+            uint32_t size;
+            uint32_t reserved2;
+        };
+
+        static const char MAGIC[8];
+
+    protected:
+
+        int m_fd;
+        char * m_map;
+        std::size_t m_mapped;
+        std::size_t m_used;
+        clock::time_point m_started;
+        unsigned long m_count;
+
+        bool grow(std::size_t needed);
+
+    public:
+
+        Recorder() : m_fd(-1), m_map(NULL), m_mapped(0), m_used(0), m_count(0) {}
+        Recorder(const Recorder &) = delete;
+        Recorder & operator=(const Recorder &) = delete;
+        ~Recorder(){ close(); }
+
+        /**
+         * Creates (or truncates) the file, false on failure.
+         */
+        bool open(const char * path);
+        void close();
+
+        bool is_open() const { return m_map != NULL; }
+
+        /**
+         * Appends a datagram as received now, false if the log is not open or could not be grown (see errno).
+         */
+        bool append(const char * data, std::size_t size, uint32_t address, int port);
+
+        unsigned long count() const { return m_count; }
+};
+
+/**
+ * Reads a log written by Recorder (mapped read-only).
+ */
+class Recording {
+
+    protected:
+
+        int m_fd;
+        const char * m_map;
+        std::size_t m_size;
+        std::size_t m_offset;
+
+    public:
+
+        Recording() : m_fd(-1), m_map(NULL), m_size(0), m_offset(0) {}
+        Recording(const Recording &) = delete;
+        Recording & operator=(const Recording &) = delete;
+        ~Recording(){ close(); }
+
+        /**
+         * False if the file cannot be read or is no such log.
+         */
+        bool open(const char * path);
+        void close();
+
+        const Recorder::Header & header() const { return *(const Recorder::Header *)m_map; }
+
+        /**
+         * The next record and its data, false at the end.
+         */
+        bool next(const Recorder::Record *& record, const char *& data);
+
+        void rewind();
+};
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_RECORDER_HPP
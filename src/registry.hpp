@@ -0,0 +1,90 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_REGISTRY_HPP
+#define MOBSPKR_VEHICLE_CTRL_REGISTRY_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace MobSpkr {
+
+/**
+ * Per-motor (or per-axis) state, in one contiguous block sized once at startup,
+ * looked up by index or by name (both constant time).
+ *
+ * Items are default constructed and never move, so pointers to them (eg the Motor kept by Telemetry) stay valid.
+ * Every item has a name, its index unless given another one; names must be unique.
+ */
+template<typename T>
+class Registry {
+
+    protected:
+
+        std::unique_ptr<T[]> m_items;
+        std::size_t m_size = 0;
+        std::vector<std::string> m_names;
+        std::unordered_map<std::string, std::size_t> m_index;
+
+    public:
+
+        Registry() {}
+        Registry(const Registry &) = delete;
+        Registry & operator=(const Registry &) = delete;
+
+        /**
+         * Creates one item per name (empty for its index), false if a name is taken twice.
+         * Only once, before anyone looks items up.
+         */
+        bool create(const std::vector<std::string> & names){
+            m_items.reset(new T[names.size()]);
+            m_size = names.size();
+            m_names.clear();
+            m_index.clear();
+
+            for(std::size_t i = 0; i < names.size(); i++){
+                m_names.push_back(names[i].empty() ? std::to_string(i) : names[i]);
+                if (!m_index.insert(std::make_pair(m_names[i], i)).second)
+                    return false;
+            }
+            return true;
+        }
+
+        std::size_t size() const { return m_size; }
+
+        T & operator[](std::size_t index){ return m_items[index]; }
+        const T & operator[](std::size_t index) const { return m_items[index]; }
+
+        T * begin(){ return m_items.get(); }
+        T * end(){ return m_items.get() + m_size; }
+
+        const std::string & name(std::size_t index) const { return m_names[index]; }
+
+        /**
+         * Index of the item named name, -1 if there is none.
+         */
+        int find(const char * name) const {
+            typename std::unordered_map<std::string, std::size_t>::const_iterator it = m_index.find(name);
+            return it == m_index.end() ? -1 : (int)it->second;
+        }
+
+        /**
+         * name, or else an index as text (eg given on the command line), -1 if neither.
+         */
+        int resolve(const char * ref) const {
+            int index = find(ref);
+            if (index >= 0)
+                return index;
+
+            char * end;
+            long i = std::strtol(ref, &end, 10);
+            if (end == ref || *end != '\0' || i < 0 || (std::size_t)i >= m_size)
+                return -1;
+            return (int)i;
+        }
+};
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_REGISTRY_HPP
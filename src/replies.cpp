@@ -0,0 +1,226 @@
+#include "replies.hpp"
+#include "log.hpp"
+
+#include "osc/OscException.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+namespace MobSpkr {
+
+    // at most as many names as clients, but don't let it grow without bound
+    static const std::size_t MAX_HOSTS = 256;
+
+    Replies::Replies() : m_queued(0), m_count(0) {
+        m_fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (m_fd < 0){
+            perror("socket");
+            return;
+        }
+
+        fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+
+        // allow multicast groups as destination, within the local network
+        unsigned char ttl = 1;
+        setsockopt(m_fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    }
+
+    Replies::~Replies() {
+        stop();
+        flush();
+
+        if (m_fd >= 0)
+            close(m_fd);
+    }
+
+    bool Replies::resolve(const char * host, int port, Endpoint & endpoint) {
+        endpoint.port = port;
+
+        struct in_addr addr;
+        if (inet_pton(AF_INET, host, &addr) == 1){
+            endpoint.address = ntohl(addr.s_addr);
+            return true;
+        }
+
+        std::lock_guard<std::mutex> lock(m_hosts_mutex);
+
+        std::unordered_map<std::string, uint32_t>::iterator it = m_hosts.find(host);
+        if (it != m_hosts.end()){
+            endpoint.address = it->second;
+            return true;
+        }
+
+        struct addrinfo hints;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+
+        struct addrinfo * result = NULL;
+        int error = getaddrinfo(host, NULL, &hints, &result);
+        if (error != 0 || result == NULL){
+            Log::warning("failed to resolve %s: %s\n", host, gai_strerror(error));
+            return false;
+        }
+
+        endpoint.address = ntohl(((struct sockaddr_in *)result->ai_addr)->sin_addr.s_addr);
+        freeaddrinfo(result);
+
+        if (m_hosts.size() >= MAX_HOSTS)
+            m_hosts.clear();
+        m_hosts[host] = endpoint.address;
+
+        return true;
+    }
+
+    bool Replies::send(const Endpoint & to, const Builder & build) {
+        bool first;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (m_count == SLOTS){
+                Log::warning("reply queue full, dropping reply\n");
+                return false;
+            }
+
+            Slot & slot = m_slots[m_queued][m_count];
+            try {
+                slot.size = build(slot.data, SLOT_SIZE);
+            } catch (const osc::Exception & e) {
+                // eg out of buffer memory, the builder has to split it up
+                Log::warning("failed to build reply: %s\n", e.what());
+                return false;
+            }
+            if (slot.size == 0 || SLOT_SIZE < slot.size)
+                return false;
+
+            slot.to = to;
+            first = m_count++ == 0;
+        }
+
+        if (first){
+            if (m_running.load())
+                m_pending.notify_one();
+            else if (m_notify)
+                m_notify();
+        }
+
+        return true;
+    }
+
+    std::size_t Replies::flush() {
+        std::lock_guard<std::mutex> flush_lock(m_flush_mutex);
+
+        Slot * slots;
+        std::size_t count;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            slots = m_slots[m_queued];
+            count = m_count;
+
+            m_queued = 1 - m_queued;
+            m_count = 0;
+        }
+
+        if (count == 0 || m_fd < 0)
+            return 0;
+
+        struct sockaddr_in addrs[SLOTS];
+        for(std::size_t i = 0; i < count; i++){
+            std::memset(&addrs[i], 0, sizeof(addrs[i]));
+            addrs[i].sin_family = AF_INET;
+            addrs[i].sin_addr.s_addr = htonl(slots[i].to.address);
+            addrs[i].sin_port = htons(slots[i].to.port);
+        }
+
+        std::size_t sent = 0;
+        // eg EAGAIN under load, reported once per flush rather than on each
+        std::size_t dropped = 0;
+        int error = 0;
+
+#ifdef __linux__
+        struct iovec iovs[SLOTS];
+        struct mmsghdr msgs[SLOTS];
+        for(std::size_t i = 0; i < count; i++){
+            iovs[i].iov_base = slots[i].data;
+            iovs[i].iov_len = slots[i].size;
+
+            std::memset(&msgs[i], 0, sizeof(msgs[i]));
+            msgs[i].msg_hdr.msg_name = &addrs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        while(sent < count){
+            int n = sendmmsg(m_fd, msgs + sent, count - sent, 0);
+            if (n < 0){
+                if (errno == EINTR)
+                    continue;
+                // the failing one is dropped, maybe the next can be sent
+                error = errno;
+                dropped++;
+                sent++;
+                continue;
+            }
+            sent += n;
+        }
+#else
+        for(; sent < count; sent++){
+            if (sendto(m_fd, slots[sent].data, slots[sent].size, 0, (struct sockaddr *)&addrs[sent], sizeof(addrs[sent])) < 0){
+                error = errno;
+                dropped++;
+            }
+        }
+#endif
+
+        if (dropped)
+            Log::warning("dropped %u of %u replies: %s\n", (unsigned int)dropped, (unsigned int)count, std::strerror(error));
+
+        return sent;
+    }
+
+    bool Replies::start() {
+        if (m_running.exchange(true))
+            return true;
+
+        m_thread = std::thread(&Replies::run, this);
+        return true;
+    }
+
+    void Replies::stop() {
+        if (!m_running.exchange(false))
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+        }
+        m_pending.notify_one();
+
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    void Replies::run() {
+        while(m_running.load()){
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_pending.wait(lock, [this]{ return m_count > 0 || !m_running.load(); });
+            }
+
+            flush();
+        }
+    }
+
+}
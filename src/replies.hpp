@@ -0,0 +1,106 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_REPLIES_HPP
+#define MOBSPKR_VEHICLE_CTRL_REPLIES_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace MobSpkr {
+
+/**
+ * Outgoing UDP datagrams (OSC replies) through a single socket.
+ *
+ * Datagrams are built right into preallocated slots and sent in batches (sendmmsg on Linux) by flush(),
+ * either from a sender thread (start()) or by whoever is notified (set_notify()), eg an event loop.
+ * Host names are resolved once and cached.
+ */
+class Replies {
+
+    public:
+
+        const static std::size_t SLOTS = 64;
+        const static std::size_t SLOT_SIZE = 2048;
+
+        struct Endpoint {
+            // host byte order
+            uint32_t address = 0;
+            int port = 0;
+        };
+
+        // fills buffer, returns the size used (0 to cancel)
+        typedef std::function<std::size_t(char * buffer, std::size_t size)> Builder;
+
+        typedef std::function<void()> Notify;
+
+    protected:
+
+        struct Slot {
+            Endpoint to;
+            std::size_t size;
+            char data[SLOT_SIZE];
+        };
+
+        int m_fd;
+
+        // queued and being sent, swapped by flush()
+        Slot m_slots[2][SLOTS];
+        int m_queued;
+        std::size_t m_count;
+        std::mutex m_mutex;
+        std::mutex m_flush_mutex;
+
+        std::unordered_map<std::string, uint32_t> m_hosts;
+        std::mutex m_hosts_mutex;
+
+        Notify m_notify;
+
+        std::thread m_thread;
+        std::atomic<bool> m_running{false};
+        std::condition_variable m_pending;
+
+        void run();
+
+    public:
+
+        Replies();
+        Replies(const Replies &) = delete;
+        Replies & operator=(const Replies &) = delete;
+        ~Replies();
+
+        bool is_ok() const { return m_fd >= 0; }
+
+        /**
+         * Numeric addresses are not looked up, names only once.
+         */
+        bool resolve(const char * host, int port, Endpoint & endpoint);
+
+        /**
+         * Queues a datagram built into a free slot (of SLOT_SIZE), false if none is left or the builder fails
+         * (returns 0 or throws an osc::Exception, eg as it would not fit).
+         */
+        bool send(const Endpoint & to, const Builder & build);
+
+        /**
+         * Sends whatever is queued, returns the number of datagrams sent.
+         */
+        std::size_t flush();
+
+        /**
+         * Called (outside any lock) when the first datagram is queued after a flush.
+         */
+        void set_notify(Notify notify){ m_notify = std::move(notify); }
+
+        // sender thread
+        bool start();
+        void stop();
+};
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_REPLIES_HPP
@@ -0,0 +1,209 @@
+#include "router.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+namespace MobSpkr {
+
+    bool Router::is_pattern(const char * address) {
+        return std::strpbrk(address, "?*[]{}") != NULL;
+    }
+
+    namespace {
+        // where to go on after the alternative being matched, for each enclosing {}
+        struct Continuations {
+            const char * after[Router::MAX_PATTERN_DEPTH];
+            unsigned int depth;
+        };
+    }
+
+    // steps counts the calls, so backtracking over many alternatives or * gives up instead of taking forever
+    static bool match_here(const char * pattern, const char * address, Continuations open, unsigned int & steps) {
+        if (++steps > Router::MAX_MATCH_STEPS)
+            return false;
+
+        while(true){
+            if (open.depth > 0 && (*pattern == ',' || *pattern == '}')){
+                // end of an alternative, on with what follows its braces
+                pattern = open.after[--open.depth];
+                continue;
+            }
+
+            switch(*pattern){
+
+                case '\0':
+                    return *address == '\0';
+
+                case '?':
+                    if (*address == '\0' || *address == '/')
+                        return false;
+                    pattern++;
+                    address++;
+                    break;
+
+                case '*':
+                    // any number of characters within one part
+                    while(*pattern == '*')
+                        pattern++;
+                    while(true){
+                        if (match_here(pattern, address, open, steps))
+                            return true;
+                        if (*address == '\0' || *address == '/' || steps > Router::MAX_MATCH_STEPS)
+                            return false;
+                        address++;
+                    }
+
+                case '[': {
+                    if (*address == '\0' || *address == '/')
+                        return false;
+                    pattern++;
+
+                    bool negate = *pattern == '!';
+                    if (negate)
+                        pattern++;
+
+                    bool found = false;
+                    while(*pattern && *pattern != ']'){
+                        if (pattern[1] == '-' && pattern[2] && pattern[2] != ']'){
+                            if (pattern[0] <= *address && *address <= pattern[2])
+                                found = true;
+                            pattern += 3;
+                        } else {
+                            if (*pattern == *address)
+                                found = true;
+                            pattern++;
+                        }
+                    }
+                    if (*pattern != ']' || found == negate)
+                        return false;
+
+                    pattern++;
+                    address++;
+                    break;
+                }
+
+                case '{': {
+                    if (open.depth == Router::MAX_PATTERN_DEPTH)
+                        return false;
+
+                    // the matching brace, alternatives may be nested or contain patterns themselves
+                    const char * end = pattern + 1;
+                    for(int depth = 1; *end; end++){
+                        if (*end == '{')
+                            depth++;
+                        else if (*end == '}' && --depth == 0)
+                            break;
+                    }
+                    if (*end == '\0')
+                        return false;
+
+                    // each alternative in place, continuing after the braces where it ends
+                    Continuations inner = open;
+                    inner.after[inner.depth++] = end + 1;
+
+                    const char * option = pattern + 1;
+                    while(option <= end){
+                        if (match_here(option, address, inner, steps))
+                            return true;
+
+                        for(int depth = 0; option < end && (depth > 0 || *option != ','); option++){
+                            if (*option == '{')
+                                depth++;
+                            else if (*option == '}')
+                                depth--;
+                        }
+                        option++;
+                    }
+                    return false;
+                }
+
+                default:
+                    if (*pattern != *address)
+                        return false;
+                    pattern++;
+                    address++;
+            }
+        }
+    }
+
+    bool Router::match(const char * pattern, const char * address) {
+        if (std::strlen(pattern) > MAX_PATTERN_LENGTH)
+            return false;
+
+        Continuations open;
+        open.depth = 0;
+        unsigned int steps = 0;
+        return match_here(pattern, address, open, steps);
+    }
+
+    void Router::add(const char * address, Invoker invoke) {
+        Route route;
+        route.hash = hash(address);
+        route.address = address;
+        route.invoke = std::move(invoke);
+
+        // after those of the same hash, so overloads are tried in order
+        std::vector<Route>::iterator it = std::upper_bound(m_routes.begin(), m_routes.end(), route.hash,
+            [](uint32_t h, const Route & r){ return h < r.hash; });
+        m_routes.insert(it, std::move(route));
+
+        m_patterns.clear();
+    }
+
+    const std::vector<std::size_t> & Router::matches(const char * pattern) {
+        // not worth remembering, matches nothing
+        static const std::vector<std::size_t> none;
+        if (std::strlen(pattern) > MAX_PATTERN_LENGTH)
+            return none;
+
+        std::unordered_map<std::string, std::vector<std::size_t>>::iterator it = m_patterns.find(pattern);
+        if (it != m_patterns.end())
+            return it->second;
+
+        if (m_patterns.size() >= MAX_PATTERNS)
+            m_patterns.clear();
+
+        std::vector<std::size_t> & indices = m_patterns[pattern];
+        for(std::size_t i = 0; i < m_routes.size(); i++){
+            if (match(pattern, m_routes[i].address))
+                indices.push_back(i);
+        }
+        return indices;
+    }
+
+    Router::Result Router::dispatch(const osc::ReceivedMessage & m, const IpEndpointName & from) {
+        const char * address = m.AddressPattern();
+
+        if (is_pattern(address)){
+            const std::vector<std::size_t> & indices = matches(address);
+            if (indices.empty())
+                return NoRoute;
+
+            // each matching address once
+            const char * done = NULL;
+            for(std::size_t i : indices){
+                if (done && std::strcmp(done, m_routes[i].address) == 0)
+                    continue;
+                if (m_routes[i].invoke(m, from))
+                    done = m_routes[i].address;
+            }
+            return done ? Dispatched : InvalidArguments;
+        }
+
+        uint32_t h = hash(address);
+        std::vector<Route>::iterator it = std::lower_bound(m_routes.begin(), m_routes.end(), h,
+            [](const Route & r, uint32_t h){ return r.hash < h; });
+
+        bool found = false;
+        for(; it != m_routes.end() && it->hash == h; it++){
+            if (std::strcmp(it->address, address) != 0)
+                continue;
+            found = true;
+            if (it->invoke(m, from))
+                return Dispatched;
+        }
+
+        return found ? InvalidArguments : NoRoute;
+    }
+
+}
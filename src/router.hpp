@@ -0,0 +1,190 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_ROUTER_HPP
+#define MOBSPKR_VEHICLE_CTRL_ROUTER_HPP
+
+#include "osc/OscReceivedElements.h"
+#include "ip/IpEndpointName.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <functional>
+#include <unordered_map>
+
+namespace MobSpkr {
+
+/**
+ * OSC address table, eg
+ *
+ *      router.route<int, int>("/motor/rotate", [](const IpEndpointName & from, int motor, int velocity){ .. });
+ *
+ * Addresses are looked up by (FNV-1a) hash, arguments are type checked and decoded without exceptions.
+ * The same address may be routed more than once with different arguments, the first fitting one is called.
+ * Incoming address patterns (eg /motor/{stop,init}) are dispatched to every matching route, the matches
+ * of a pattern are remembered.
+ *
+ * Not thread safe, dispatch() from one thread only.
+ */
+class Router {
+
+    public:
+
+        // false if the arguments don't fit
+        typedef std::function<bool(const osc::ReceivedMessage & m, const IpEndpointName & from)> Invoker;
+
+        typedef std::function<void(const osc::ReceivedMessage & m, const IpEndpointName & from)> RawHandler;
+
+        template<typename... Args>
+        struct Handler {
+            typedef std::function<void(const IpEndpointName & from, Args...)> type;
+        };
+
+        template<typename T>
+        struct Argument;
+
+        enum Result {
+            Dispatched,
+            NoRoute,
+            InvalidArguments
+        };
+
+        const static std::size_t MAX_PATTERNS = 64;
+        // longer patterns, deeper nested alternatives or ones taking more steps to match don't match anything
+        const static std::size_t MAX_PATTERN_LENGTH = 256;
+        const static unsigned int MAX_PATTERN_DEPTH = 4;
+        const static unsigned int MAX_MATCH_STEPS = 10000;
+
+        static constexpr uint32_t hash(const char * address){
+            uint32_t h = 2166136261u;
+            while(*address)
+                h = (h ^ (uint8_t)*address++) * 16777619u;
+            return h;
+        }
+
+        /**
+         * OSC 1.0 pattern matching: ? * [abc] [a-z] [!abc] {foo,bar}, where ? and * stay within one part
+         * (ie don't match /) and alternatives may be patterns or alternatives themselves ({st{op,art},rot*}).
+         * Within the limits above, so a pattern can't stall whoever dispatches.
+         */
+        static bool match(const char * pattern, const char * address);
+
+        static bool is_pattern(const char * address);
+
+    protected:
+
+        struct Route {
+            uint32_t hash;
+            const char * address;
+            Invoker invoke;
+        };
+
+        // by hash
+        std::vector<Route> m_routes;
+
+        std::unordered_map<std::string, std::vector<std::size_t>> m_patterns;
+
+        template<typename... Args, std::size_t... I>
+        static bool invoke(const typename Handler<Args...>::type & handler, const osc::ReceivedMessage & m, const IpEndpointName & from, std::index_sequence<I...>){
+            if (m.ArgumentCount() != sizeof...(Args))
+                return false;
+
+            std::tuple<Args...> values;
+            osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+            bool ok = true;
+
+            // in order, stops at the first mismatch
+            int expand[] = { 0, (ok = ok && Argument<Args>::decode(*arg++, std::get<I>(values)), 0)... };
+            (void)expand;
+
+            if (!ok)
+                return false;
+
+            handler(from, std::get<I>(values)...);
+            return true;
+        }
+
+        const std::vector<std::size_t> & matches(const char * pattern);
+
+    public:
+
+        /**
+         * address must outlive the router (ie a literal).
+         */
+        void add(const char * address, Invoker invoke);
+
+        template<typename... Args>
+        void route(const char * address, typename Handler<Args...>::type handler){
+            add(address, [handler](const osc::ReceivedMessage & m, const IpEndpointName & from){
+                return invoke<Args...>(handler, m, from, std::index_sequence_for<Args...>());
+            });
+        }
+
+        /**
+         * Any arguments, for the handler to check.
+         */
+        void route_raw(const char * address, RawHandler handler){
+            add(address, [handler](const osc::ReceivedMessage & m, const IpEndpointName & from){
+                handler(m, from);
+                return true;
+            });
+        }
+
+        Result dispatch(const osc::ReceivedMessage & m, const IpEndpointName & from);
+};
+
+template<>
+struct Router::Argument<int> {
+    static bool decode(const osc::ReceivedMessageArgument & arg, int & value){
+        if (!arg.IsInt32())
+            return false;
+        value = arg.AsInt32Unchecked();
+        return true;
+    }
+};
+
+// integers too
+template<>
+struct Router::Argument<float> {
+    static bool decode(const osc::ReceivedMessageArgument & arg, float & value){
+        if (arg.IsFloat())
+            value = arg.AsFloatUnchecked();
+        else if (arg.IsInt32())
+            value = (float)arg.AsInt32Unchecked();
+        else
+            return false;
+        return true;
+    }
+};
+
+// integers too
+template<>
+struct Router::Argument<bool> {
+    static bool decode(const osc::ReceivedMessageArgument & arg, bool & value){
+        if (arg.IsBool())
+            value = arg.AsBoolUnchecked();
+        else if (arg.IsInt32())
+            value = arg.AsInt32Unchecked() != 0;
+        else
+            return false;
+        return true;
+    }
+};
+
+// symbols too
+template<>
+struct Router::Argument<const char *> {
+    static bool decode(const osc::ReceivedMessageArgument & arg, const char * & value){
+        if (arg.IsString())
+            value = arg.AsStringUnchecked();
+        else if (arg.IsSymbol())
+            value = arg.AsSymbolUnchecked();
+        else
+            return false;
+        return true;
+    }
+};
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_ROUTER_HPP
@@ -2,13 +2,20 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <getopt.h>
+#include <errno.h>
+#include <string.h>
 
 #include <pigpio.h>
 
 #include "osc/OscReceivedElements.h"
 #include "osc/OscPacketListener.h"
+#include <osc/OscOutboundPacketStream.h>
 #include "ip/UdpSocket.h"
 
+#include "router.hpp"
+#include "log.hpp"
+#include "recorder.hpp"
+
 /*
 # servo_demo.c
 # 2016-10-08
@@ -20,6 +27,10 @@ sudo ./servo_demo          # Send servo pulses to GPIO 4.
 sudo ./servo_demo 23 24 25 # Send servo pulses to GPIO 23, 24, 25.
 */
 
+#ifndef HOSTNAME
+#define HOSTNAME "unknown"
+#endif
+
 #define DEFAULT_PORT    9393
 
 #define NUM_GPIO 32
@@ -35,10 +46,16 @@ static char * argv0;
 
 static struct {
     int port;
+    MobSpkr::Log::Level log_level;
+    const char * record_path;
 } opts {
-    .port = DEFAULT_PORT
+    .port = DEFAULT_PORT,
+    .log_level = MobSpkr::Log::Info,
+    .record_path = NULL
 };
 
+static MobSpkr::Recorder recorder;
+
 //static int run = 1;
 
 static struct {
@@ -63,6 +80,8 @@ static void print_usage(FILE * f){
             "Start OSC server to act as proxy for GPIO pins acting as PWM\n"
             "Options:\n"
             "\t -p,--port <port>\t OSC server port (default %d)\n"
+            "\t -V, --verbosity <level>\t Log level error, warning, info or debug (default info)\n"
+            "\t -R, --record <path>\t Log every received datagram to <path>, for osc-replay\n"
             ,argv0, DEFAULT_PORT);
 }
 
@@ -79,81 +98,96 @@ static int position_map(float posf)
     return posi;
 }
 
-class packet_listener : public osc::OscPacketListener {
-        protected:
+static void on_pwm(const IpEndpointName& remoteEndpoint, int pwm_index, float position)
+{
+    if (pwm_index < 0 || NUM_GPIO <= pwm_index){
+        MobSpkr::Log::warning("Invalid pwm index: %d\n", pwm_index);
+        return;
+    }
+    if (pwms[pwm_index].used == 0){
+        MobSpkr::Log::warning("pwm %d NOT used, ignoring\n", pwm_index);
+        return;
+    }
 
-        virtual void ProcessMessage( const osc::ReceivedMessage& m,
-        const IpEndpointName& remoteEndpoint )
-        {
-            (void) remoteEndpoint; // suppress unused parameter warning
+    int w = position_map(position);
+
+    MobSpkr::Log::debug("Position %f %d\n", position, w);
 
-            try{
+    // don't update if unchannged value
+    if (pwms[pwm_index].width == w){
+        return;
+    }
 
-                printf("OSC rx %s\n", m.AddressPattern());
+    MobSpkr::Log::debug("updating!\n");
+    pwms[pwm_index].width = w;
 
-                if (std::strcmp( m.AddressPattern(), "/pwm") == 0){
+    gpioServo(pwm_index, w);
+}
 
-                    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                    int pwm_index = (arg++)->AsInt32();
-                    float position = (arg++)->AsFloat();
-                    if( arg != m.ArgumentsEnd() )
-                        throw osc::ExcessArgumentException();
+static void on_log_level(const IpEndpointName& remoteEndpoint, const char *name)
+{
+    MobSpkr::Log::Level level;
+    if (!MobSpkr::Log::parse_level(name, level)) {
+        MobSpkr::Log::warning("Invalid log level: %s\n", name);
+        return;
+    }
+    MobSpkr::Log::instance().set_level(level);
+}
 
-                    if (pwm_index < 0 || NUM_GPIO <= pwm_index){
-                        fprintf(stderr, "Invalid pwm index: %d\n", pwm_index);
-                        return;
-                    }
-                    if (pwms[pwm_index].used == 0){
-                        fprintf(stderr, "pwm %d NOT used, ignoring\n", pwm_index);
-                        return;
-                    }
+// answered right away, tells the sender all it sent before has been handled
+static void on_ping(const IpEndpointName& remoteEndpoint, const char *host, int port, int id)
+{
+    static UdpSocket reply_socket;
+
+    char buffer[128];
+    osc::OutboundPacketStream p( buffer, sizeof(buffer) );
+    p << osc::BeginMessage( "/pong" )
+      << HOSTNAME << id
+      << osc::EndMessage;
+
+    try {
+        reply_socket.SendTo(IpEndpointName(host, port), p.Data(), p.Size());
+    } catch( std::exception& e ){
+        MobSpkr::Log::warning("failed to reply to %s:%d: %s\n", host, port, e.what());
+    }
+}
 
-                    int w = position_map(position);
+class packet_listener : public osc::OscPacketListener {
+        protected:
 
-printf("Position %f %d\n", position, w);
+        MobSpkr::Router m_router;
 
-                    // don't update if unchannged value
-                    if (pwms[pwm_index].width == w){
-                        return;
-                    }
+        virtual void ProcessMessage( const osc::ReceivedMessage& m,
+        const IpEndpointName& remoteEndpoint )
+        {
+            MobSpkr::Log::debug("OSC rx %s\n", m.AddressPattern());
 
-printf("updating!\n");
-                    pwms[pwm_index].width = w;
+            if (m_router.dispatch(m, remoteEndpoint) == MobSpkr::Router::InvalidArguments)
+                MobSpkr::Log::warning("invalid arguments: %s ,%s\n", m.AddressPattern(), m.TypeTags());
+        }
 
-                    gpioServo(pwm_index, w);
+        public:
 
-                }
+        packet_listener(){
+            m_router.route<int, float>("/pwm", on_pwm);
+            m_router.route<const char *>("/log/level", on_log_level);
+            m_router.route<const char *, int, int>("/ping", on_ping);
+        }
 
+        // malformed packets throw while being parsed
+        virtual void ProcessPacket( const char *data, int size,
+        const IpEndpointName& remoteEndpoint )
+        {
+            // keeping what was recorded so far, eg when the disk is full
+            if (recorder.is_open() && !recorder.append(data, size, remoteEndpoint.address, remoteEndpoint.port)){
+                MobSpkr::Log::error("recording stopped after %lu datagrams: %s\n", recorder.count(), strerror(errno));
+                recorder.close();
+            }
 
-//            if( std::strcmp( m.AddressPattern(), "/test1" ) == 0 ){
-//                // example #1 -- argument stream interface
-//                osc::ReceivedMessageArgumentStream args = m.ArgumentStream();
-//                bool a1;
-//                osc::int32 a2;
-//                float a3;
-//                const char *a4;
-//                args >> a1 >> a2 >> a3 >> a4 >> osc::EndMessage;
-//
-//                std::cout << "received '/test1' message with arguments: "
-//                          << a1 << " " << a2 << " " << a3 << " " << a4 << "\n";
-//
-//            }else if( std::strcmp( m.AddressPattern(), "/test2" ) == 0 ){
-//                // example #2 -- argument iterator interface, supports
-//                // reflection for overloaded messages (eg you can call
-//                // (*arg)->IsBool() to check if a bool was passed etc).
-//                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-//                bool a1 = (arg++)->AsBool();
-//                int a2 = (arg++)->AsInt32();
-//                float a3 = (arg++)->AsFloat();
-//                const char *a4 = (arg++)->AsString();
-//
-//                std::cout << "received '/test2' message with arguments: "
-//                          << a1 << " " << a2 << " " << a3 << " " << a4 << "\n";
-//            }
-            }catch( osc::Exception& e ){
-                // any parsing errors such as unexpected argument types, or
-                // missing arguments get thrown as exceptions.
-                fprintf(stderr, "error while parsing message: %s: %s\n", m.AddressPattern(), e.what());
+            try {
+                osc::OscPacketListener::ProcessPacket(data, size, remoteEndpoint);
+            } catch( osc::Exception& e ){
+                MobSpkr::Log::warning("malformed packet: %s\n", e.what());
             }
         }
 };
@@ -174,10 +208,12 @@ int main(int argc, char *argv[])
         static struct option long_options[] = {
                 {"port",     required_argument, 0,  'p' },
                 {"gpio",     required_argument, 0,  'g' },
+                {"verbosity", required_argument, 0, 'V'},
+                {"record", required_argument, 0, 'R'},
                 {0,         0,                 0,  0 }
         };
 
-        c = getopt_long(argc, argv, "h?p:g:",
+        c = getopt_long(argc, argv, "h?p:g:V:R:",
                         long_options, &option_index);
         if (c == -1)
             break;
@@ -192,6 +228,17 @@ int main(int argc, char *argv[])
                 }
                 break;
 
+            case 'V': // --verbosity <level>
+                if (!MobSpkr::Log::parse_level(optarg, opts.log_level)) {
+                    fprintf(stderr, "invalid log level: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'R': // --record <path>
+                opts.record_path = optarg;
+                break;
+
             case 'h':
             case '?':
                 print_usage(stdout);
@@ -203,6 +250,8 @@ int main(int argc, char *argv[])
         }
     }
 
+    MobSpkr::Log::instance().set_level(opts.log_level);
+
     if (optind == argc) {
         fprintf(stderr, "Missing arguments. Try %s -h\n", argv0);
         return EXIT_FAILURE;
@@ -222,6 +271,11 @@ int main(int argc, char *argv[])
         pwms[pin].used = 1;
     }
 
+    if (opts.record_path && !recorder.open(opts.record_path)){
+        fprintf(stderr, "failed to open %s: %s\n", opts.record_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
     int i, g;
 
    if (gpioInitialise() < 0) return -1;
@@ -271,11 +325,21 @@ int main(int argc, char *argv[])
 //   }
 
     printf("press Ctrl+C (SIGINT) to stop\n");
+    fflush(stdout);
+
+    MobSpkr::Log::instance().start();
     osc_rx_socket.RunUntilSigInt();
+    MobSpkr::Log::instance().stop();
+    MobSpkr::Log::instance().poll(MobSpkr::Log::clock::now());
 
 
    printf("\ntidying up\n");
 
+   if (recorder.is_open()){
+      printf("Recorded %lu datagrams\n", recorder.count());
+      recorder.close();
+   }
+
    for (g=0; g<NUM_GPIO; g++)
    {
       if (pwms[g].used) gpioServo(g, 0);
@@ -1,24 +1,53 @@
 
 #include <unistd.h>
 #include <getopt.h>
+#include <signal.h>
 #include <cstdlib>
 #include <cstring>
 #include <cerrno>
 #include <cstdio>
+#include <atomic>
+#include <string>
+#include <map>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
 
 #include "motor.hpp"
+#include "bus.hpp"
+#include "sync.hpp"
+#include "reactor.hpp"
+#include "telemetry.hpp"
+#include "replies.hpp"
+#include "subscriptions.hpp"
+#include "router.hpp"
+#include "scheduler.hpp"
+#include "profiles.hpp"
+#include "odometry.hpp"
+#include "metrics.hpp"
+#include "exporter.hpp"
+#include "recorder.hpp"
+#include "capture.hpp"
+#include "startup.hpp"
+#include "registry.hpp"
+#include "log.hpp"
 
 #include "osc/OscReceivedElements.h"
 #include "osc/OscPacketListener.h"
 #include <osc/OscOutboundPacketStream.h>
 #include "ip/UdpSocket.h"
 
+#ifdef __linux__
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
 #ifndef HOSTNAME
 #define HOSTNAME "unknown"
 #endif
 
 
-#define MAX_MOTORS      3
 #define DEFAULT_PORT    9292
 //#define BROADCAST_ADDR          "255.255.255.255"
 #define DEFAULT_RESPONSE_PORT   9393
@@ -34,477 +63,1370 @@
 #define PULSE_DIVISOR 6
 #define RAMP_DIVISOR 8
 #define MAX_ACCELERATION 200
-#define TIMEOUT_MS 1000
+// derived from the measured round-trip time of each port
+#define TIMEOUT_MS MobSpkr::Motor::ADAPTIVE_TIMEOUT
+// commands in flight per port, 1 = stop-and-wait
+#define DEFAULT_WINDOW 1
+// silence after each reply on shared (RS485) ports
+#define DEFAULT_TURNAROUND_US 100
+// telemetry stream to a multicast group
+#define DEFAULT_MULTICAST_RATE_HZ 10
 
 // the number of steps required for a complete rotation given the above configuration
 #define NSTEPS_ONE_ROTATION 3200
 
+// the modules' clock, velocities are in units of CLOCK_HZ / (2^PULSE_DIVISOR * 2048 * 32) microsteps per second
+#define CLOCK_HZ 16000000
+#define MAX_VELOCITY 2047
+// /vehicle/twist: motor indices of the left and right wheel, distance between the wheels and their radius in m
+#define DEFAULT_DRIVE_LEFT 0
+#define DEFAULT_DRIVE_RIGHT 1
+#define DEFAULT_WHEELBASE 0.5
+#define DEFAULT_WHEEL_RADIUS 0.1
+
 
 
 static char * argv0;
 
 static struct {
-    struct {
-        char * name;
-        int address;
-        bool direction_right;
-    } motors[MAX_MOTORS];
     int port;
     int response_port;
+    int window;
+    int busy_threshold;
+    int turnaround_us;
+    bool threads;
+    int poll_active_ms;
+    int poll_idle_ms;
+    const char * multicast_group;
+    int multicast_port;
+    float multicast_rate_hz;
+    int max_late_ms;
+    bool profiles;
+    int jerk;
+    int max_acceleration;
+    int tick_hz;
+    int drive_left;
+    int drive_right;
+    float wheelbase;
+    float wheel_radius;
+    int odometry_rate_hz;
+    MobSpkr::Log::Level log_level;
+    int metrics_port;
+    const char * record_path;
+    int capture_entries;
+    const char * capture_path;
+    bool eeprom;
+    // applied once the motors are known (by index or name)
+    std::vector<const char *> addresses;
+    std::vector<const char *> directions;
+    const char * drive;
 } opts {
     .port = DEFAULT_PORT,
-    .response_port = DEFAULT_RESPONSE_PORT
+    .response_port = DEFAULT_RESPONSE_PORT,
+    .window = DEFAULT_WINDOW,
+    .busy_threshold = 0,
+    .turnaround_us = DEFAULT_TURNAROUND_US,
+#ifdef __linux__
+    .threads = false,
+#else
+    .threads = true,
+#endif
+    .poll_active_ms = MobSpkr::Telemetry::DEFAULT_ACTIVE_MS,
+    .poll_idle_ms = MobSpkr::Telemetry::DEFAULT_IDLE_MS,
+    .multicast_group = NULL,
+    .multicast_port = 0,
+    .multicast_rate_hz = DEFAULT_MULTICAST_RATE_HZ,
+    .max_late_ms = 0,
+    .profiles = false,
+    .jerk = MobSpkr::Profiles::DEFAULT_JERK,
+    .max_acceleration = MobSpkr::Profiles::DEFAULT_ACCELERATION,
+    .tick_hz = MobSpkr::Profiles::DEFAULT_TICK_HZ,
+    .drive_left = DEFAULT_DRIVE_LEFT,
+    .drive_right = DEFAULT_DRIVE_RIGHT,
+    .wheelbase = DEFAULT_WHEELBASE,
+    .wheel_radius = DEFAULT_WHEEL_RADIUS,
+    .odometry_rate_hz = 0,
+    .log_level = MobSpkr::Log::Info,
+    .metrics_port = 0,
+    .record_path = NULL,
+    .capture_entries = MobSpkr::Capture::DEFAULT_ENTRIES,
+    .capture_path = NULL,
+    .eeprom = false,
+    .addresses = {},
+    .directions = {},
+    .drive = NULL
 };
 
-static int motor_count = 0;
-static MobSpkr::Motor motors[MAX_MOTORS];
-static int32_t current_movement[MAX_MOTORS];
+// per motor, as many as given
+struct Axis {
+    MobSpkr::Motor motor;
+    bool direction_right = true;
+    std::atomic<int32_t> current_movement{0};
+    // last /busy sent, and to whom (it is taken back from the I/O thread once the queue drained)
+    std::atomic<bool> busy{false};
+    std::atomic<uint32_t> busy_to{0};
+    // last to set a ramp target (-J), told about /busy as the ramp is sent
+    std::atomic<uint32_t> ramp_sender{0};
+};
 
-static int init_motor(int motor);
+static MobSpkr::Registry<Axis> axes;
+static int motor_count = 0;
+static std::vector<MobSpkr::Bus *> buses;
+static MobSpkr::Telemetry telemetry;
+static MobSpkr::Replies replies;
+static MobSpkr::Subscriptions subscriptions(telemetry, replies, HOSTNAME);
+static MobSpkr::Odometry odometry;
+static MobSpkr::Recorder recorder;
+static MobSpkr::Capture capture;
+static MobSpkr::Startup startup(TIMEOUT_MS);
+// where SIGUSR1 dumps the capture to
+static char capture_dump_path[64];
+
+static std::vector<MobSpkr::Startup::Step> init_sequence();
 static int set_motor_msr(int motor, int msr);
+static int issue(int motor, MobSpkr::Motor::Command command, const char * what);
+static int issue_setpoint(int motor, MobSpkr::Motor::Command command, const char * what);
+static MobSpkr::Motor::Callback report_failure(int motor, const char * what);
+static MobSpkr::Motor::Command rotate_command(int motor, int velocity);
+#ifdef __linux__
+static int open_osc_socket(int port);
+static void receive_osc(int fd, osc::OscPacketListener & listener);
+static void run_poller(MobSpkr::Reactor * reactor, MobSpkr::Poller * poller);
+static void run_profiles(MobSpkr::Reactor * reactor);
+#endif
+static void send_value(const MobSpkr::Replies::Endpoint & to, const char * address, int motor_index, int value, int age_ms);
+static int sample_age_ms(const MobSpkr::Telemetry::Sample & sample);
+static void issue_sync(std::shared_ptr<MobSpkr::SyncGroup> group, const char * what, std::vector<uint32_t> reply_addresses);
+static void send_skew(uint32_t reply_address, long skew_us, MobSpkr::Motor::Response::Status status);
+static void ramp(const std::vector<MobSpkr::Profiles::Change> & changes);
+
+// velocity ramps of /motor/rotate, /vehicle/rotate and /vehicle/twist (-J)
+static MobSpkr::Profiles profiles(ramp);
+
+// senders of /vehicle/* targets (-J) since the last tick, to be sent /vehicle/skew once its steps are out
+static std::mutex ramp_mutex;
+static std::vector<uint32_t> ramp_requests;
+
+// "<motor>:<value>" of -a, -d and -D, the motor by index or name (-1 if there is none)
+static int motor_option(const char * arg, const char ** value)
+{
+    const char * colon = std::strchr(arg, ':');
+    if (colon == NULL)
+        return -1;
+
+    *value = colon + 1;
+    return axes.resolve(std::string(arg, colon - arg).c_str());
+}
 
 static void print_usage(FILE * f){
     fprintf(f,
-            "Usage: %s <motor1-path> <motor2-path> ...\n"
-            "Start OSC server to act as proxy for given motors (max %d)\n"
+            "Usage: %s [<name>=]<motor1-path> [<name>=]<motor2-path> ...\n"
+            "Start OSC server to act as proxy for given motors\n"
             "Options:\n"
             "\t -p,--port <port>\t OSC server port (default %d)\n"
             "\t -r, --response-port <port>\t OSC response port (default %d)\n"
-            "\t -a, --addr <motor-index>:<addr1>\n"
+            "\t -a, --addr <motor>:<addr1>\n"
             "\t\t\t Set address of given motor (default %d)\n"
-            "\t -d, --dir <motor-index>:[l,r]\n"
+            "\t -d, --dir <motor>:[l,r]\n"
             "\t\t\t Set direction of given motor to turn left or right\n"
+            "\t -w, --window <n>\t Commands in flight per motor port (1 - %d, default %d)\n"
+            "\t -b, --busy <depth>\t Send /busy to the response port when a motor's queue reaches <depth> (default off)\n"
+            "\t -t, --turnaround <usec>\t Pause after each reply on shared ports (default %d)\n"
+            "\t -T, --threads\t One I/O thread per port instead of a single event loop (always on but Linux)\n"
+            "\t -P, --poll <msec>[:<idle-msec>]\t Poll position and speed every <msec> while turning, every <idle-msec> otherwise;\n"
+            "\t\t\t temperature and voltage every <idle-msec> (default %d:%d, 0 = off)\n"
+            "\t -M, --multicast <group>:<port>[:<rate-hz>]\t Stream all telemetry to the given multicast group (default rate %d)\n"
+            "\t -L, --max-late <msec>\t Drop timetagged bundles more than <msec> late (default 0 = execute however late)\n"
+            "\t -J, --jerk <jerk>[:<accel>[:<tick-hz>]]\t Ramp rotation velocities with limited jerk (per s^2) and acceleration (per s),\n"
+            "\t\t\t updating the velocity <tick-hz> times a second (default %d:%d:%d)\n"
+            "\t -D, --drive <left-motor>:<right-motor>\t Motors driving the left and right wheel for /vehicle/twist (default %d:%d)\n"
+            "\t -G, --geometry <wheelbase>:<wheel-radius>\t Distance between the wheels and their radius in m (default %g:%g)\n"
+            "\t -O, --odometry <rate-hz>\t Poll positions at <rate-hz> while turning, for a finer tracked pose (default as -P)\n"
+            "\t -V, --verbosity <level>\t Log level error, warning, info or debug (default info)\n"
+            "\t -C, --capture <entries>[:<path>]\t Keep the last <entries> TMCL exchanges, in <path> if given (default %d, 0 = off);\n"
+            "\t\t\t SIGUSR1 or /capture/dump dumps them to /tmp/mobspkr-capture-<pid>.tmcl, see tmcl-decode\n"
+            "\t -E, --eeprom\t Store configuration parameters written to the modules' EEPROM, so they keep them when power cycled\n"
+            "\t -R, --record <path>\t Log every received datagram to <path>, for osc-replay\n"
+            "\t -S, --metrics <port>\t Serve latencies and counters to Prometheus at http://127.0.0.1:<port>/metrics (default off)\n"
             "Note:\n"
+            "\t Motors are referred to by index (0, 1, ..) or name, in options as well as OSC messages\n"
+            "\t Motors given the same path share it as RS485 bus (one command at a time), their addresses must differ\n"
             "\t Compiled with hostname %s\n"
 //            "\t Sending responses to %s\n"
-            , argv0, MAX_MOTORS, DEFAULT_PORT, DEFAULT_RESPONSE_PORT, DEFAULT_ADDRESS, HOSTNAME);
+            , argv0, DEFAULT_PORT, DEFAULT_RESPONSE_PORT, DEFAULT_ADDRESS, MobSpkr::Bus::MAX_WINDOW, DEFAULT_WINDOW, DEFAULT_TURNAROUND_US, MobSpkr::Telemetry::DEFAULT_ACTIVE_MS, MobSpkr::Telemetry::DEFAULT_IDLE_MS, DEFAULT_MULTICAST_RATE_HZ, MobSpkr::Profiles::DEFAULT_JERK, MobSpkr::Profiles::DEFAULT_ACCELERATION, MobSpkr::Profiles::DEFAULT_TICK_HZ, DEFAULT_DRIVE_LEFT, DEFAULT_DRIVE_RIGHT, DEFAULT_WHEELBASE, DEFAULT_WHEEL_RADIUS, (int)MobSpkr::Capture::DEFAULT_ENTRIES, HOSTNAME);
 }
 
 
-class packet_listener : public osc::OscPacketListener {
-protected:
+static void send_busy(int motor_index, uint32_t address, bool busy, int depth)
+{
+    MobSpkr::Replies::Endpoint to;
+    to.address = address;
+    to.port = opts.response_port;
 
-    virtual void ProcessMessage( const osc::ReceivedMessage& m,
-                                 const IpEndpointName& remoteEndpoint )
-    {
-        (void) remoteEndpoint; // suppress unused parameter warning
+    replies.send(to, [motor_index, busy, depth](char * buffer, std::size_t size){
+        osc::OutboundPacketStream p( buffer, size );
 
-        try{
+        p << osc::BeginMessage( "/busy" )
+          << HOSTNAME << motor_index << (int)busy << depth
+          << osc::EndMessage;
 
-            printf("OSC rx %s\n", m.AddressPattern());
+        return p.Size();
+    });
+}
 
-            if (std::strcmp(m.AddressPattern(), "/motor/init") == 0){
+// tell the sender (on the response port) when a motor's queue fills up, see check_drained() for when it has drained
+static void check_busy(int motor_index, uint32_t address)
+{
+    if (opts.busy_threshold == 0)
+        return;
 
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                int motor_index = (arg++)->AsInt32();
-                if( arg != m.ArgumentsEnd() )
-                    throw osc::ExcessArgumentException();
+    Axis & axis = axes[motor_index];
+    int depth = axis.motor.queue_depth();
+    bool busy = depth >= opts.busy_threshold;
 
-                if (motor_index < 0 || motor_count <= motor_index){
-                    fprintf(stderr, "Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
-                    return;
-                }
+    if (busy)
+        axis.busy_to.store(address);
+    if (axis.busy.exchange(busy) != busy)
+        send_busy(motor_index, address, busy, depth);
+}
 
-		        printf("RE-INIT MOTOR %d\n", motor_index);
-                if (init_motor(motor_index))
-		            printf("failed\n");
-            }
+// on every completion, so a sender holding back gets to hear the motor is no longer busy
+static void check_drained(int motor_index)
+{
+    if (opts.busy_threshold == 0)
+        return;
 
-            if (std::strcmp( m.AddressPattern(), "/motor/stop") == 0){
+    Axis & axis = axes[motor_index];
+    int depth = axis.motor.queue_depth();
+    if (depth >= opts.busy_threshold || !axis.busy.load())
+        return;
 
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                int motor_index = (arg++)->AsInt32();
-                if( arg != m.ArgumentsEnd() )
-                    throw osc::ExcessArgumentException();
+    if (axis.busy.exchange(false))
+        send_busy(motor_index, axis.busy_to.load(), false, depth);
+}
 
-                if (motor_index < 0 || motor_count <= motor_index){
-                    fprintf(stderr, "Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
-                    return;
-                }
+// commands to motors not (yet, or no longer) configured are dropped, the sender is told on the response port
+static bool check_ready(int motor_index, const IpEndpointName& remoteEndpoint)
+{
+    MobSpkr::Startup::State state = startup.state(motor_index);
+    if (state == MobSpkr::Startup::Ready)
+        return true;
 
-                motors[motor_index].command_stopMotor(TIMEOUT_MS);
-                current_movement[motor_index] = 0;
-            }
+    MobSpkr::Log::debug("motor %d %s, command dropped\n", motor_index, MobSpkr::Startup::state_name(state));
 
+    MobSpkr::Replies::Endpoint to;
+    to.address = remoteEndpoint.address;
+    to.port = opts.response_port;
 
-            if (std::strcmp( m.AddressPattern(), "/motor/reset-position") == 0){
+    replies.send(to, [motor_index, state](char * buffer, std::size_t size){
+        osc::OutboundPacketStream p( buffer, size );
 
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                int motor_index = (arg++)->AsInt32();
-                if( arg != m.ArgumentsEnd() )
-                    throw osc::ExcessArgumentException();
+        p << osc::BeginMessage( "/not-ready" )
+          << HOSTNAME << motor_index << MobSpkr::Startup::state_name(state)
+          << osc::EndMessage;
 
-                if (motor_index < 0 || motor_count <= motor_index){
-                    fprintf(stderr, "Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
-                    return;
-                }
+        return p.Size();
+    });
 
-                motors[motor_index].command_stopMotor(TIMEOUT_MS);
-                current_movement[motor_index] = 0;
-                motors[motor_index].command_setAxisParam_ActualPosition(0, TIMEOUT_MS);
-            }
+    return false;
+}
 
-            if (std::strcmp( m.AddressPattern(), "/motor/move-by-angle") == 0) {
+static void on_motor_init(const IpEndpointName& remoteEndpoint, int motor_index)
+{
+    if (motor_index < 0 || motor_count <= motor_index){
+        MobSpkr::Log::warning("Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
+        return;
+    }
 
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                int motor_index = (arg++)->AsInt32();
-                int angle = (arg++)->AsInt32();
-                if (arg != m.ArgumentsEnd())
-                    throw osc::ExcessArgumentException();
+    MobSpkr::Log::info("RE-INIT MOTOR %d\n", motor_index);
+    axes[motor_index].current_movement = 0;
+    startup.reinit(motor_index);
+}
 
-                if (motor_index < 0 || motor_count <= motor_index) {
-                    fprintf(stderr, "Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
-                    return;
-                }
+static void on_motor_ready(const IpEndpointName& remoteEndpoint, const char *host, int port)
+{
+    MobSpkr::Replies::Endpoint reply_to;
+    if (!replies.resolve(host, port, reply_to))
+        return;
 
-                if (angle < -360 || 360 < angle) {
-                    fprintf(stderr, "Invalid angle: %d [-360, 360]\n", angle);
-                    return;
-                }
+    replies.send(reply_to, [](char * buffer, std::size_t size){
+        osc::OutboundPacketStream p( buffer, size );
 
-                int32_t pos_target = (angle * NSTEPS_ONE_ROTATION) / 360;
+        p << osc::BeginMessage( "/ready" )
+          << HOSTNAME;
+        for(int i = 0; i < motor_count; i++){
+            p << MobSpkr::Startup::state_name(startup.state(i));
+        }
+        p << osc::EndMessage;
 
-                motors[motor_index].command_moveToPosition(pos_target, MobSpkr::Motor::MovementType_Relative, 0, TIMEOUT_MS);
-            }
+        return p.Size();
+    });
+}
 
-            if (std::strcmp( m.AddressPattern(), "/motor/move-to-angle") == 0){
+static void on_motor_stop(const IpEndpointName& remoteEndpoint, int motor_index)
+{
+    if (motor_index < 0 || motor_count <= motor_index){
+        MobSpkr::Log::warning("Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
+        return;
+    }
+    if (!check_ready(motor_index, remoteEndpoint))
+        return;
 
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                int motor_index = (arg++)->AsInt32();
-                int angle = (arg++)->AsInt32();
-                if( arg != m.ArgumentsEnd() )
-                    throw osc::ExcessArgumentException();
+    axes[motor_index].motor.supersede_setpoints();
+    profiles.reset(motor_index);
+    issue(motor_index, MobSpkr::PD_1160::Catalogue::MotorStop, "stop");
+    axes[motor_index].current_movement = 0;
+}
 
-                if (motor_index < 0 || motor_count <= motor_index){
-                    fprintf(stderr, "Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
-                    return;
-                }
+static void on_motor_reset_position(const IpEndpointName& remoteEndpoint, int motor_index)
+{
+    if (motor_index < 0 || motor_count <= motor_index){
+        MobSpkr::Log::warning("Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
+        return;
+    }
+    if (!check_ready(motor_index, remoteEndpoint))
+        return;
+
+    axes[motor_index].motor.supersede_setpoints();
+    profiles.reset(motor_index);
+    issue(motor_index, MobSpkr::PD_1160::Catalogue::MotorStop, "stop");
+    axes[motor_index].current_movement = 0;
+
+    MobSpkr::Motor::Command command(MobSpkr::PD_1160::Catalogue::SetAxisParam_ActualPosition);
+    command.set_value(0);
+
+    // position samples queued before still count from the old origin, rebase only once it is set
+    MobSpkr::Motor::Callback report = report_failure(motor_index, "reset position");
+    axes[motor_index].motor.submit(command, TIMEOUT_MS, [motor_index, report](MobSpkr::Motor::Response::Status status, const MobSpkr::Motor::Response & response){
+        odometry.rebase(motor_index);
+        report(status, response);
+    });
+}
 
-                if (angle < -360 || 360 < angle){
-                    fprintf(stderr, "Invalid angle: %d [-360, 360]\n", angle);
-                    return;
-                }
+static void on_motor_move_by_angle(const IpEndpointName& remoteEndpoint, int motor_index, int angle)
+{
+    if (motor_index < 0 || motor_count <= motor_index) {
+        MobSpkr::Log::warning("Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
+        return;
+    }
+    if (!check_ready(motor_index, remoteEndpoint))
+        return;
 
-                int32_t inverted = 0;
-                if (angle < 0){
-                    inverted = 1;
-                    angle = 360 + angle;
-                }
+    if (angle < -360 || 360 < angle) {
+        MobSpkr::Log::warning("Invalid angle: %d [-360, 360]\n", angle);
+        return;
+    }
 
-                int32_t desired_angled = (angle * NSTEPS_ONE_ROTATION) / 360;
-                fprintf(stderr, "angle %d (%d)\n", angle, desired_angled);
+    int32_t pos_target = (angle * NSTEPS_ONE_ROTATION) / 360;
 
+    MobSpkr::Motor::Command command(MobSpkr::PD_1160::Catalogue::MoveToPosition);
+    command.set_type(MobSpkr::Motor::MovementType_Relative);
+    command.set_motor(0);
+    command.set_value(pos_target);
+    // positioning ends any ramp
+    profiles.reset(motor_index);
+    issue(motor_index, command, "move by angle");
+}
 
-                int32_t pos;
-                MobSpkr::Motor::Response::Status status;
-                status = motors[motor_index].command_getAxisParam_ActualPosition(pos, TIMEOUT_MS);
+static void on_motor_move_to_angle(const IpEndpointName& remoteEndpoint, int motor_index, int angle)
+{
+    if (motor_index < 0 || motor_count <= motor_index){
+        MobSpkr::Log::warning("Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
+        return;
+    }
+    if (!check_ready(motor_index, remoteEndpoint))
+        return;
 
-                fprintf(stderr, "getting current pos ");
-                if (status != MobSpkr::Motor::Response::Status::Success){
-                    fprintf(stderr, "failed\n");
-                    return;
-                }
-                fprintf(stderr,"-> %d\n", pos);
+    if (angle < -360 || 360 < angle){
+        MobSpkr::Log::warning("Invalid angle: %d [-360, 360]\n", angle);
+        return;
+    }
 
-                int32_t current_angle = pos % NSTEPS_ONE_ROTATION;
-                int32_t pos_base = pos - current_angle;
+    int32_t inverted = 0;
+    if (angle < 0){
+        inverted = 1;
+        angle = 360 + angle;
+    }
 
-                int32_t pos_target = 0;
+    int32_t desired_angled = (angle * NSTEPS_ONE_ROTATION) / 360;
+    MobSpkr::Log::debug("angle %d (%d)\n", angle, desired_angled);
 
-                if (current_angle == desired_angled){
-                    fprintf(stderr, "not moving, already at angle\n");
-                    return;
-                }
+    // the target depends on the current position, so continue once the motor answered
+    profiles.reset(motor_index);
+    axes[motor_index].motor.submit(MobSpkr::PD_1160::Catalogue::GetAxisParam_ActualPosition, TIMEOUT_MS,
+        [motor_index, desired_angled, inverted](MobSpkr::Motor::Response::Status status, const MobSpkr::Motor::Response & response){
 
-                // if rotating "right" position increments, thus we go for the next bigger possible position, otherwise the next smaller one
-                // treat not-rotating as right-rotation
-                if (current_movement[motor_index] >= 0){
-                    if (current_angle > desired_angled){
-                        pos_target = pos_base + NSTEPS_ONE_ROTATION + desired_angled;
-                    } else {
-                        pos_target = pos_base + desired_angled;
-                    }
-                    if (inverted){
-                        pos_target -= NSTEPS_ONE_ROTATION;
-                    }
-                } else {
-                    if (current_angle < desired_angled){
-                        pos_target = pos_base - NSTEPS_ONE_ROTATION + desired_angled;
-                    } else {
-                        pos_target = pos_base + desired_angled;
-                    }
-                    if (inverted){
-                        pos_target += NSTEPS_ONE_ROTATION;
-                    }
-                }
+        if (status != MobSpkr::Motor::Response::Status::Success){
+            MobSpkr::Log::error("getting current pos failed\n");
+            return;
+        }
+        int32_t pos = response.value();
+        MobSpkr::Log::debug("getting current pos -> %d\n", pos);
 
-                fprintf(stderr, "moving to absolute pos %d\n", pos_target);
+        int32_t current_angle = pos % NSTEPS_ONE_ROTATION;
+        int32_t pos_base = pos - current_angle;
 
-                motors[motor_index].command_moveToPosition(pos_target, MobSpkr::Motor::MovementType_Absolute, 0, TIMEOUT_MS);
+        int32_t pos_target = 0;
 
-                current_movement[motor_index] = 0;
+        if (current_angle == desired_angled){
+            MobSpkr::Log::debug("not moving, already at angle\n");
+            return;
+        }
+
+        // if rotating "right" position increments, thus we go for the next bigger possible position, otherwise the next smaller one
+        // treat not-rotating as right-rotation
+        if (axes[motor_index].current_movement >= 0){
+            if (current_angle > desired_angled){
+                pos_target = pos_base + NSTEPS_ONE_ROTATION + desired_angled;
+            } else {
+                pos_target = pos_base + desired_angled;
+            }
+            if (inverted){
+                pos_target -= NSTEPS_ONE_ROTATION;
+            }
+        } else {
+            if (current_angle < desired_angled){
+                pos_target = pos_base - NSTEPS_ONE_ROTATION + desired_angled;
+            } else {
+                pos_target = pos_base + desired_angled;
             }
+            if (inverted){
+                pos_target += NSTEPS_ONE_ROTATION;
+            }
+        }
 
-            if (std::strcmp( m.AddressPattern(), "/motor/move-to-position") == 0) {
+        MobSpkr::Log::debug("moving to absolute pos %d\n", pos_target);
 
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                int motor_index = (arg++)->AsInt32();
-                int pos = (arg++)->AsInt32();
-                if (arg != m.ArgumentsEnd())
-                    throw osc::ExcessArgumentException();
+        MobSpkr::Motor::Command command(MobSpkr::PD_1160::Catalogue::MoveToPosition);
+        command.set_type(MobSpkr::Motor::MovementType_Absolute);
+        command.set_motor(0);
+        command.set_value(pos_target);
+        issue(motor_index, command, "move to angle");
 
-                if (motor_index < 0 || motor_count <= motor_index) {
-                    fprintf(stderr, "Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
-                    return;
-                }
+        axes[motor_index].current_movement = 0;
+    });
+}
 
-                if (pos < -2147483648 || 2147483647 < pos) {
-                    fprintf(stderr, "Invalid position: %d [-2147483648, 2147483647]\n", pos);
-                    return;
-                }
+static void on_motor_move_to_position(const IpEndpointName& remoteEndpoint, int motor_index, int pos)
+{
+    if (motor_index < 0 || motor_count <= motor_index) {
+        MobSpkr::Log::warning("Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
+        return;
+    }
+    if (!check_ready(motor_index, remoteEndpoint))
+        return;
 
-                fprintf(stderr, "move to position: %d\n", pos);
-                motors[motor_index].command_moveToPosition(pos, MobSpkr::Motor::MovementType_Absolute, 0, TIMEOUT_MS);
-            }
+    if (pos < -2147483648 || 2147483647 < pos) {
+        MobSpkr::Log::warning("Invalid position: %d [-2147483648, 2147483647]\n", pos);
+        return;
+    }
 
-            if (std::strcmp( m.AddressPattern(), "/motor/rotate") == 0){
+    MobSpkr::Log::debug("move to position: %d\n", pos);
 
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                int motor_index = (arg++)->AsInt32();
-                int velocity = (arg++)->AsInt32();
-                if( arg != m.ArgumentsEnd() )
-                    throw osc::ExcessArgumentException();
+    MobSpkr::Motor::Command command(MobSpkr::PD_1160::Catalogue::MoveToPosition);
+    command.set_type(MobSpkr::Motor::MovementType_Absolute);
+    command.set_motor(0);
+    command.set_value(pos);
+    profiles.reset(motor_index);
+    issue_setpoint(motor_index, command, "move to position");
+    check_busy(motor_index, remoteEndpoint.address);
+}
 
-                if (motor_index < 0 || motor_count <= motor_index){
-                    fprintf(stderr, "Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
-                    return;
-                }
-                if (velocity < -2049 || 2049 < velocity){
-                    fprintf(stderr, "Invalid velocity range: %d [-2049, 2049]\n", velocity);
-                    return;
-                }
-                if (opts.motors[motor_index].direction_right){
-                    motors[motor_index].command_rotateRight(velocity, TIMEOUT_MS);
-                    current_movement[motor_index] = velocity;
-                } else {
-                    motors[motor_index].command_rotateLeft(velocity, TIMEOUT_MS);
-                    current_movement[motor_index] = -velocity;
-                }
+static void on_motor_rotate(const IpEndpointName& remoteEndpoint, int motor_index, int velocity)
+{
+    if (motor_index < 0 || motor_count <= motor_index){
+        MobSpkr::Log::warning("Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
+        return;
+    }
+    if (!check_ready(motor_index, remoteEndpoint))
+        return;
+    if (velocity < -2049 || 2049 < velocity){
+        MobSpkr::Log::warning("Invalid velocity range: %d [-2049, 2049]\n", velocity);
+        return;
+    }
+    if (opts.profiles){
+        axes[motor_index].ramp_sender.store(remoteEndpoint.address);
+        profiles.set_target(motor_index, velocity);
+        return;
+    }
+    issue_setpoint(motor_index, rotate_command(motor_index, velocity), axes[motor_index].direction_right ? "rotate right" : "rotate left");
+    check_busy(motor_index, remoteEndpoint.address);
+}
 
-            }
+// before setting the targets, so the tick taking them up can't miss it
+static void request_skew(uint32_t address)
+{
+    std::lock_guard<std::mutex> lock(ramp_mutex);
+    ramp_requests.push_back(address);
+}
 
-            if (std::strcmp(m.AddressPattern(), "/motor/msr") == 0){
+// any number of velocities
+static void on_vehicle_rotate(const osc::ReceivedMessage& m, const IpEndpointName& remoteEndpoint)
+{
+    std::shared_ptr<MobSpkr::SyncGroup> group = MobSpkr::SyncGroup::create();
 
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                int motor_index = (arg++)->AsInt32();
-                enum MobSpkr::Motor::MicroStepResolution msr = (enum MobSpkr::Motor::MicroStepResolution)(arg++)->AsInt32();
-                if( arg != m.ArgumentsEnd() )
-                    throw osc::ExcessArgumentException();
+    int motor_index = 0;
+    for(osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin(); arg != m.ArgumentsEnd(); arg++, motor_index++){
+        if (!arg->IsInt32()){
+            MobSpkr::Log::warning("Invalid velocity type: %c\n", arg->TypeTag());
+            return;
+        }
+        int velocity = arg->AsInt32Unchecked();
 
-                if (motor_index < 0 || motor_count <= motor_index){
-                    fprintf(stderr, "Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
-                    return;
-                }
-                if (msr < 1 || 8 < msr){
-                    fprintf(stderr, "Invalid microstrep resolution range: %d [1, 8]\n", msr);
-                    return;
-                }
+        if (motor_count <= motor_index){
+            MobSpkr::Log::warning("Too many velocities: %d (max %d)\n", (int)m.ArgumentCount(), motor_count);
+            return;
+        }
+        if (velocity < -2049 || 2049 < velocity){
+            MobSpkr::Log::warning("Invalid velocity range: %d [-2049, 2049]\n", velocity);
+            return;
+        }
+    }
 
-                fprintf(stderr, "setting motor %d msr = %d\n", motor_index, msr);
-                if (set_motor_msr(motor_index, msr))
-                    fprintf(stderr, "failed\n");
-            }
+    for(motor_index = 0; motor_index < (int)m.ArgumentCount(); motor_index++){
+        if (!check_ready(motor_index, remoteEndpoint))
+            return;
+    }
 
+    // ramps of all motors are stepped together
+    if (opts.profiles){
+        request_skew(remoteEndpoint.address);
+        motor_index = 0;
+        for(osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin(); arg != m.ArgumentsEnd(); arg++, motor_index++){
+            profiles.set_target(motor_index, arg->AsInt32Unchecked());
+        }
+        return;
+    }
 
-            if (std::strcmp(m.AddressPattern(), "/motor/standby-current") == 0){
+    motor_index = 0;
+    for(osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin(); arg != m.ArgumentsEnd(); arg++, motor_index++){
+        group->add(axes[motor_index].motor, rotate_command(motor_index, arg->AsInt32Unchecked()));
+    }
 
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                int motor_index = (arg++)->AsInt32();
-                int value = (arg++)->AsInt32();
-                if( arg != m.ArgumentsEnd() )
-                    throw osc::ExcessArgumentException();
+    issue_sync(group, "vehicle rotate", {(uint32_t)remoteEndpoint.address});
+}
 
-                if (motor_index < 0 || motor_count <= motor_index){
-                    fprintf(stderr, "Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
-                    return;
-                }
-                if (value < 0 || 255 < value){
-                    fprintf(stderr, "Invalid standby current: %d [0, 255]\n", value);
-                    return;
-                }
+// m/s of a wheel to module velocity units
+static float wheel_velocity(float speed)
+{
+    float rotations = speed / (2 * M_PI * opts.wheel_radius);
+    return rotations * NSTEPS_ONE_ROTATION * (1 << PULSE_DIVISOR) * 2048.0f * 32 / CLOCK_HZ;
+}
 
-                fprintf(stderr, "setting standby current (motor %d) := %d\n", motor_index, value);
-                if (motors[motor_index].command_setAxisParam_StandbyCurrent(value, TIMEOUT_MS))
-                    fprintf(stderr, "failed\n");
-            }
+// differential drive: forward speed in m/s, turning rate in rad/s (positive = counterclockwise)
+static void on_vehicle_twist(const IpEndpointName& remoteEndpoint, float linear, float angular)
+{
+    if (motor_count <= opts.drive_left || motor_count <= opts.drive_right){
+        MobSpkr::Log::warning("Drive motors %d:%d not available (%d motors)\n", opts.drive_left, opts.drive_right, motor_count);
+        return;
+    }
 
+    if (!std::isfinite(linear) || !std::isfinite(angular)){
+        MobSpkr::Log::warning("Invalid twist: %g %g\n", linear, angular);
+        return;
+    }
 
+    float left = wheel_velocity(linear - angular * opts.wheelbase / 2);
+    float right = wheel_velocity(linear + angular * opts.wheelbase / 2);
+    // too large to be scaled down
+    if (!std::isfinite(left) || !std::isfinite(right)){
+        MobSpkr::Log::warning("Invalid twist range: %g %g\n", linear, angular);
+        return;
+    }
 
+    if (!check_ready(opts.drive_left, remoteEndpoint) || !check_ready(opts.drive_right, remoteEndpoint))
+        return;
 
-            if (std::strcmp(m.AddressPattern(), "/motor/temp") == 0) {
+    // scaled down together to keep the curve's radius
+    float fastest = std::max(std::fabs(left), std::fabs(right));
+    if (fastest > MAX_VELOCITY){
+        left *= MAX_VELOCITY / fastest;
+        right *= MAX_VELOCITY / fastest;
+    }
 
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                int motor_index = (arg++)->AsInt32();
+    int velocities[2] = {(int)std::lround(left), (int)std::lround(right)};
+    int indices[2] = {opts.drive_left, opts.drive_right};
 
-                const char *host = (arg++)->AsString();
-                int port = (arg++)->AsInt32();
+    if (opts.profiles){
+        request_skew(remoteEndpoint.address);
+        for(int i = 0; i < 2; i++){
+            profiles.set_target(indices[i], velocities[i]);
+        }
+        return;
+    }
 
-                if (arg != m.ArgumentsEnd())
-                    throw osc::ExcessArgumentException();
+    std::shared_ptr<MobSpkr::SyncGroup> group = MobSpkr::SyncGroup::create();
+    for(int i = 0; i < 2; i++){
+        group->add(axes[indices[i]].motor, rotate_command(indices[i], velocities[i]));
+    }
 
-                if (motor_index < 0 || motor_count <= motor_index) {
-                    fprintf(stderr, "Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
-                    return;
-                }
+    issue_sync(group, "vehicle twist", {(uint32_t)remoteEndpoint.address});
+}
 
-                // try to create transmit socket
-                fprintf(stderr, "UDP response addr = %s:%u\n", host, port);
-                UdpTransmitSocket transmitSocket( IpEndpointName( host, port ) );
+static void on_vehicle_pose(const IpEndpointName& remoteEndpoint, const char *host, int port)
+{
+    MobSpkr::Replies::Endpoint reply_to;
+    if (!replies.resolve(host, port, reply_to))
+        return;
 
-                fprintf(stderr, "Getting motor %d temp ...", motor_index);
-                uint32_t temp = 0;
-                if (motors[motor_index].command_getGIOTemperature(temp, TIMEOUT_MS) != MobSpkr::Motor::Response::Status::Success)
-                    fprintf(stderr, "FAILED\n");
-                else
-                    fprintf(stderr, "%d deg C\n",temp);
+    MobSpkr::Odometry::Pose pose = odometry.get_pose();
+    int age_ms = pose.valid ? std::chrono::duration_cast<std::chrono::milliseconds>(MobSpkr::Odometry::clock::now() - pose.time).count() : -1;
 
-                char buffer[256];
-                osc::OutboundPacketStream p( buffer, sizeof(buffer) );
+    replies.send(reply_to, [pose, age_ms](char * buffer, std::size_t size){
+        osc::OutboundPacketStream p( buffer, size );
 
-                p << osc::BeginMessage( "/temp" )
-                    << HOSTNAME << motor_index << (int)temp
-                    << osc::EndMessage;
+        p << osc::BeginMessage( "/vehicle/pose" )
+          << HOSTNAME << (float)pose.x << (float)pose.y << (float)pose.heading << age_ms
+          << osc::EndMessage;
 
-                transmitSocket.Send( p.Data(), p.Size() );
-            }
+        return p.Size();
+    });
+}
 
-            if (std::strcmp(m.AddressPattern(), "/motor/volt") == 0) {
+static void on_vehicle_set_pose(const IpEndpointName& remoteEndpoint, float x, float y, float heading)
+{
+    // would stay NaN for good, integrated from there on
+    if (!std::isfinite(x) || !std::isfinite(y) || !std::isfinite(heading)){
+        MobSpkr::Log::warning("Invalid pose: %g %g %g\n", x, y, heading);
+        return;
+    }
+    odometry.set_pose(x, y, heading);
+}
 
-                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-                int motor_index = (arg++)->AsInt32();
+static void on_vehicle_stop(const IpEndpointName& remoteEndpoint)
+{
+    std::shared_ptr<MobSpkr::SyncGroup> group = MobSpkr::SyncGroup::create();
+
+    // stops whatever is up
+    for(int motor_index = 0; motor_index < motor_count; motor_index++){
+        if (!startup.is_ready(motor_index))
+            continue;
+        axes[motor_index].motor.supersede_setpoints();
+        profiles.reset(motor_index);
+        group->add(axes[motor_index].motor, MobSpkr::PD_1160::Catalogue::MotorStop, false);
+        axes[motor_index].current_movement = 0;
+    }
 
-                const char *host = (arg++)->AsString();
-                int port = (arg++)->AsInt32();
+    issue_sync(group, "vehicle stop", {(uint32_t)remoteEndpoint.address});
+}
 
-                if (arg != m.ArgumentsEnd())
-                    throw osc::ExcessArgumentException();
+static void on_motor_msr(const IpEndpointName& remoteEndpoint, int motor_index, int msr)
+{
+    if (motor_index < 0 || motor_count <= motor_index){
+        MobSpkr::Log::warning("Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
+        return;
+    }
+    if (!check_ready(motor_index, remoteEndpoint))
+        return;
+    if (msr < 1 || 8 < msr){
+        MobSpkr::Log::warning("Invalid microstrep resolution range: %d [1, 8]\n", msr);
+        return;
+    }
 
-                if (motor_index < 0 || motor_count <= motor_index) {
-                    fprintf(stderr, "Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
-                    return;
-                }
+    MobSpkr::Log::info("setting motor %d msr = %d\n", motor_index, msr);
+    if (set_motor_msr(motor_index, msr))
+        MobSpkr::Log::error("failed\n");
+}
+
+static void on_motor_standby_current(const IpEndpointName& remoteEndpoint, int motor_index, int value)
+{
+    if (motor_index < 0 || motor_count <= motor_index){
+        MobSpkr::Log::warning("Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
+        return;
+    }
+    if (!check_ready(motor_index, remoteEndpoint))
+        return;
+    if (value < 0 || 255 < value){
+        MobSpkr::Log::warning("Invalid standby current: %d [0, 255]\n", value);
+        return;
+    }
+
+    MobSpkr::Log::info("setting standby current (motor %d) := %d\n", motor_index, value);
+
+    MobSpkr::Motor::Command command(MobSpkr::PD_1160::Catalogue::SetAxisParam_StandbyCurrent);
+    command.set_value(value);
+    if (issue(motor_index, command, "standby current"))
+        MobSpkr::Log::error("failed\n");
+}
+
+static void on_motor_temp(const IpEndpointName& remoteEndpoint, int motor_index, const char *host, int port)
+{
+    if (motor_index < 0 || motor_count <= motor_index) {
+        MobSpkr::Log::warning("Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
+        return;
+    }
+
+    MobSpkr::Replies::Endpoint reply_to;
+    if (!replies.resolve(host, port, reply_to))
+        return;
+
+    MobSpkr::Telemetry::Sample sample;
+    if (telemetry.get(motor_index, MobSpkr::Telemetry::Temperature, sample)){
+        send_value(reply_to, "/temp", motor_index, sample.value, sample_age_ms(sample));
+        return;
+    }
+
+    // not polled (yet), reply from the motor's I/O thread once the value is in
+    axes[motor_index].motor.submit(MobSpkr::PD_1160::Catalogue::GetGIOTemperature, TIMEOUT_MS,
+        [motor_index, reply_to](MobSpkr::Motor::Response::Status status, const MobSpkr::Motor::Response & response){
+
+        uint32_t temp = 0;
+        if (status != MobSpkr::Motor::Response::Status::Success)
+            MobSpkr::Log::error("Getting motor %d temp ... FAILED\n", motor_index);
+        else {
+            temp = response.value();
+            MobSpkr::Log::debug("Getting motor %d temp ... %d deg C\n", motor_index, temp);
+        }
+
+        send_value(reply_to, "/temp", motor_index, temp, 0);
+    });
+}
+
+static void on_motor_volt(const IpEndpointName& remoteEndpoint, int motor_index, const char *host, int port)
+{
+    if (motor_index < 0 || motor_count <= motor_index) {
+        MobSpkr::Log::warning("Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
+        return;
+    }
+
+    MobSpkr::Replies::Endpoint reply_to;
+    if (!replies.resolve(host, port, reply_to))
+        return;
+
+    MobSpkr::Telemetry::Sample sample;
+    if (telemetry.get(motor_index, MobSpkr::Telemetry::Voltage, sample)){
+        send_value(reply_to, "/volt", motor_index, sample.value, sample_age_ms(sample));
+        return;
+    }
+
+    // not polled (yet), reply from the motor's I/O thread once the value is in
+    axes[motor_index].motor.submit(MobSpkr::PD_1160::Catalogue::GetGIOVoltage, TIMEOUT_MS,
+        [motor_index, reply_to](MobSpkr::Motor::Response::Status status, const MobSpkr::Motor::Response & response){
+
+        uint32_t voltage = 0;
+        if (status != MobSpkr::Motor::Response::Status::Success)
+            MobSpkr::Log::error("Getting motor %d volt ... FAILED\n", motor_index);
+        else {
+            voltage = response.value();
+            MobSpkr::Log::debug("Getting motor %d volt ... %d.%d\n", motor_index, voltage/10, voltage%10);
+        }
+
+        send_value(reply_to, "/volt", motor_index, voltage, 0);
+    });
+}
+
+static void on_motor_state(const IpEndpointName& remoteEndpoint, int motor_index, const char *host, int port)
+{
+    if (motor_index < 0 || motor_count <= motor_index) {
+        MobSpkr::Log::warning("Invalid motor index: %d (0 - %d)\n", motor_index, motor_count - 1);
+        return;
+    }
+
+    MobSpkr::Replies::Endpoint reply_to;
+    if (!replies.resolve(host, port, reply_to))
+        return;
+
+    replies.send(reply_to, [motor_index](char * buffer, std::size_t size){
+        osc::OutboundPacketStream p( buffer, size );
 
-                // try to create transmit socket
-                fprintf(stderr, "UDP response addr = %s:%u\n", host, port);
-                UdpTransmitSocket transmitSocket( IpEndpointName( host, port ) );
+        p << osc::BeginMessage( "/state" )
+          << HOSTNAME << motor_index;
 
-                fprintf(stderr, "Getting motor %d volt ...", motor_index);
-                uint32_t voltage = 0;
-                if (motors[motor_index].command_getGIOVoltage(voltage, TIMEOUT_MS) != MobSpkr::Motor::Response::Status::Success)
-                    fprintf(stderr, "FAILED\n");
-                else
-                    fprintf(stderr, "%d.%d\n",voltage/10, voltage%10);
+        // each value with its age, both -1 if not sampled yet
+        for(int f = 0; f < MobSpkr::Telemetry::FIELD_COUNT; f++){
+            MobSpkr::Telemetry::Sample sample;
+            if (telemetry.get(motor_index, (MobSpkr::Telemetry::Field)f, sample))
+                p << (int)sample.value << sample_age_ms(sample);
+            else
+                p << -1 << -1;
+        }
+        p << osc::EndMessage;
+
+        return p.Size();
+    });
+}
+
+// lease in seconds, 0 = until unsubscribed
+static void on_motor_subscribe(const IpEndpointName& remoteEndpoint, const char *host, int port, const char *field_names, float rate_hz, int lease_sec)
+{
+    if (lease_sec < 0 || (int)(MobSpkr::Subscriptions::MAX_LEASE_MS / 1000) < lease_sec) {
+        MobSpkr::Log::warning("Invalid lease: %d [0, %d]\n", lease_sec, (int)(MobSpkr::Subscriptions::MAX_LEASE_MS / 1000));
+        return;
+    }
 
-                char buffer[256];
-                osc::OutboundPacketStream p( buffer, sizeof(buffer) );
+    unsigned int fields;
+    if (!MobSpkr::Subscriptions::parse_fields(field_names, fields)) {
+        MobSpkr::Log::warning("Invalid fields: %s\n", field_names);
+        return;
+    }
 
-                p << osc::BeginMessage( "/volt" )
-                  << HOSTNAME << motor_index << (int)voltage
-                  << osc::EndMessage;
+    if (!subscriptions.subscribe(host, port, fields, rate_hz, 1000 * lease_sec))
+        MobSpkr::Log::warning("Failed to subscribe %s:%d\n", host, port);
+}
+
+static void on_motor_unsubscribe(const IpEndpointName& remoteEndpoint, const char *host, int port)
+{
+    subscriptions.unsubscribe(host, port);
+}
+
+static void on_log_level(const IpEndpointName& remoteEndpoint, const char *name)
+{
+    MobSpkr::Log::Level level;
+    if (!MobSpkr::Log::parse_level(name, level)) {
+        MobSpkr::Log::warning("Invalid log level: %s\n", name);
+        return;
+    }
+    MobSpkr::Log::instance().set_level(level);
+}
 
-                transmitSocket.Send( p.Data(), p.Size() );
+// always where SIGUSR1 dumps to, a peer must not choose which file gets written
+static void on_capture_dump(const IpEndpointName& remoteEndpoint)
+{
+    if (capture_dump_path[0] == '\0') {
+        MobSpkr::Log::warning("nothing to dump, capture is off\n");
+        return;
+    }
+    if (!capture.dump(capture_dump_path)) {
+        MobSpkr::Log::error("failed to dump capture to %s\n", capture_dump_path);
+        return;
+    }
+    MobSpkr::Log::info("dumped capture (%llu exchanges) to %s\n", (unsigned long long)capture.count(), capture_dump_path);
+}
+
+static void on_sigusr1(int signal)
+{
+    capture.dump(capture_dump_path);
+}
+
+static void on_ping(const IpEndpointName& remoteEndpoint, const char *host, int port, int id)
+{
+    MobSpkr::Replies::Endpoint reply_to;
+    if (!replies.resolve(host, port, reply_to))
+        return;
+
+    replies.send(reply_to, [id](char * buffer, std::size_t size){
+        osc::OutboundPacketStream p( buffer, size );
+
+        p << osc::BeginMessage( "/pong" )
+          << HOSTNAME << id
+          << osc::EndMessage;
+
+        return p.Size();
+    });
+}
+
+// p50 and p99 of each latency, then the slowest one seen
+static void add_latencies(osc::OutboundPacketStream & p, const MobSpkr::Metrics::Command & command)
+{
+    for(int l = 0; l < MobSpkr::Metrics::LATENCY_COUNT; l++){
+        const MobSpkr::Histogram & h = command.latency[l];
+        p << (int)h.percentile(0.5) << (int)h.percentile(0.99);
+    }
+    p << (int)command.latency[MobSpkr::Metrics::Total].max();
+}
+
+static void on_stats(const IpEndpointName& remoteEndpoint, const char *host, int port)
+{
+    MobSpkr::Replies::Endpoint reply_to;
+    if (!replies.resolve(host, port, reply_to))
+        return;
+
+    // one bundle per motor, a full set of commands fits a reply slot
+    for(int i = 0; i < motor_count; i++){
+        replies.send(reply_to, [i](char * buffer, std::size_t size){
+            osc::OutboundPacketStream p( buffer, size );
+            const MobSpkr::Metrics & metrics = axes[i].motor.metrics();
+
+            p << osc::BeginBundleImmediate;
+            for(unsigned int slot = 0; slot < MobSpkr::Metrics::COMMAND_SLOTS; slot++){
+                const MobSpkr::Metrics::Command & command = metrics.command(slot);
+                if (command.count.load() == 0)
+                    continue;
+
+                p << osc::BeginMessage( "/stats/command" )
+                  << HOSTNAME << i << MobSpkr::Metrics::command_name(slot)
+                  << (int)command.count.load() << (int)command.errors.load();
+                add_latencies(p, command);
+                p << osc::EndMessage;
+            }
+            p << osc::EndBundle;
+
+            return p.Size();
+        });
+    }
+
+    // one per port, as for the motors any number of them has to fit
+    for(MobSpkr::Bus * bus : buses){
+        replies.send(reply_to, [bus](char * buffer, std::size_t size){
+            osc::OutboundPacketStream p( buffer, size );
+
+            p << osc::BeginBundleImmediate
+              << osc::BeginMessage( "/stats/bus" )
+              << HOSTNAME << bus->get_portname()
+              << (osc::int64)bus->bytes_tx() << (osc::int64)bus->bytes_rx()
+              << (int)bus->checksum_errors() << (int)bus->short_reads()
+              << (int)bus->timeout_count() << (int)bus->retry_count() << (int)bus->error_count()
+              << (int)bus->get_srtt_us() << (int)bus->get_rto_us()
+              << osc::EndMessage
+              << osc::EndBundle;
+
+            return p.Size();
+        });
+    }
+}
+
+// the motor given by index or by name
+template<typename... Args>
+static void route_motor(MobSpkr::Router & router, const char * address, void (*handler)(const IpEndpointName&, int, Args...))
+{
+    router.route<int, Args...>(address, handler);
+    router.route<const char *, Args...>(address, [address, handler](const IpEndpointName& remoteEndpoint, const char * name, Args... args){
+        int motor_index = axes.find(name);
+        if (motor_index < 0){
+            MobSpkr::Log::warning("%s: no motor named %s\n", address, name);
+            return;
+        }
+        handler(remoteEndpoint, motor_index, args...);
+    });
+}
+
+static void add_routes(MobSpkr::Router & router)
+{
+    route_motor(router, "/motor/init", on_motor_init);
+    router.route<const char *, int>("/motor/ready", on_motor_ready);
+    route_motor(router, "/motor/stop", on_motor_stop);
+    route_motor(router, "/motor/reset-position", on_motor_reset_position);
+    route_motor(router, "/motor/move-by-angle", on_motor_move_by_angle);
+    route_motor(router, "/motor/move-to-angle", on_motor_move_to_angle);
+    route_motor(router, "/motor/move-to-position", on_motor_move_to_position);
+    route_motor(router, "/motor/rotate", on_motor_rotate);
+    route_motor(router, "/motor/msr", on_motor_msr);
+    route_motor(router, "/motor/standby-current", on_motor_standby_current);
+    route_motor(router, "/motor/temp", on_motor_temp);
+    route_motor(router, "/motor/volt", on_motor_volt);
+    route_motor(router, "/motor/state", on_motor_state);
+    router.route<const char *, int, const char *, float>("/motor/subscribe",
+        [](const IpEndpointName& remoteEndpoint, const char *host, int port, const char *field_names, float rate_hz){
+            on_motor_subscribe(remoteEndpoint, host, port, field_names, rate_hz, MobSpkr::Subscriptions::DEFAULT_LEASE_MS / 1000);
+        });
+    router.route<const char *, int, const char *, float, int>("/motor/subscribe", on_motor_subscribe);
+    router.route<const char *, int>("/motor/unsubscribe", on_motor_unsubscribe);
+    router.route_raw("/vehicle/rotate", on_vehicle_rotate);
+    router.route<float, float>("/vehicle/twist", on_vehicle_twist);
+    router.route<const char *, int>("/vehicle/pose", on_vehicle_pose);
+    router.route<float, float, float>("/vehicle/set-pose", on_vehicle_set_pose);
+    router.route<>("/vehicle/set-pose", [](const IpEndpointName& remoteEndpoint){ on_vehicle_set_pose(remoteEndpoint, 0, 0, 0); });
+    router.route<>("/vehicle/stop", on_vehicle_stop);
+    router.route<const char *>("/log/level", on_log_level);
+    router.route<const char *, int>("/stats", on_stats);
+    router.route<const char *, int, int>("/ping", on_ping);
+    router.route<>("/capture/dump", on_capture_dump);
+}
+
+static void render_header(std::string & out, const char * name, const char * help, const char * type)
+{
+    out += "# HELP ";
+    out += name;
+    out += " ";
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += " ";
+    out += type;
+    out += "\n";
+}
+
+// Prometheus text format, each metric's samples together
+static void render_metrics(std::string & out)
+{
+    char name[64];
+    char line[256];
+
+    for(int l = 0; l < MobSpkr::Metrics::LATENCY_COUNT; l++){
+        snprintf(name, sizeof(name), "mobspkr_command_%s_seconds", MobSpkr::Metrics::latency_name((MobSpkr::Metrics::Latency)l));
+        render_header(out, name, "TMCL command latency (wait: queued until sent, response: sent until answered)", "histogram");
+
+        for(int i = 0; i < motor_count; i++){
+            for(unsigned int slot = 0; slot < MobSpkr::Metrics::COMMAND_SLOTS; slot++){
+                const MobSpkr::Metrics::Command & command = axes[i].motor.metrics().command(slot);
+                if (command.count.load() == 0)
+                    continue;
+
+                snprintf(line, sizeof(line), "device=\"%s\",motor=\"%d\",command=\"%s\"", HOSTNAME, i, MobSpkr::Metrics::command_name(slot));
+                command.latency[l].prometheus(out, name, line);
             }
-//            if( std::strcmp( m.AddressPattern(), "/test1" ) == 0 ){
-//                // example #1 -- argument stream interface
-//                osc::ReceivedMessageArgumentStream args = m.ArgumentStream();
-//                bool a1;
-//                osc::int32 a2;
-//                float a3;
-//                const char *a4;
-//                args >> a1 >> a2 >> a3 >> a4 >> osc::EndMessage;
-//
-//                std::cout << "received '/test1' message with arguments: "
-//                          << a1 << " " << a2 << " " << a3 << " " << a4 << "\n";
-//
-//            }else if( std::strcmp( m.AddressPattern(), "/test2" ) == 0 ){
-//                // example #2 -- argument iterator interface, supports
-//                // reflection for overloaded messages (eg you can call
-//                // (*arg)->IsBool() to check if a bool was passed etc).
-//                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
-//                bool a1 = (arg++)->AsBool();
-//                int a2 = (arg++)->AsInt32();
-//                float a3 = (arg++)->AsFloat();
-//                const char *a4 = (arg++)->AsString();
-//
-//                std::cout << "received '/test2' message with arguments: "
-//                          << a1 << " " << a2 << " " << a3 << " " << a4 << "\n";
-//            }
-        }catch( osc::Exception& e ){
-            // any parsing errors such as unexpected argument types, or
-            // missing arguments get thrown as exceptions.
-            fprintf(stderr, "error while parsing message: %s: %s\n", m.AddressPattern(), e.what());
         }
     }
+
+    render_header(out, "mobspkr_commands_total", "TMCL commands answered or failed", "counter");
+    for(int i = 0; i < motor_count; i++){
+        for(unsigned int slot = 0; slot < MobSpkr::Metrics::COMMAND_SLOTS; slot++){
+            const MobSpkr::Metrics::Command & command = axes[i].motor.metrics().command(slot);
+            if (command.count.load() == 0)
+                continue;
+            snprintf(line, sizeof(line), "mobspkr_commands_total{device=\"%s\",motor=\"%d\",command=\"%s\"} %u\n", HOSTNAME, i, MobSpkr::Metrics::command_name(slot), command.count.load());
+            out += line;
+        }
+    }
+
+    render_header(out, "mobspkr_command_errors_total", "TMCL commands failed, timed out or refused", "counter");
+    for(int i = 0; i < motor_count; i++){
+        for(unsigned int slot = 0; slot < MobSpkr::Metrics::COMMAND_SLOTS; slot++){
+            const MobSpkr::Metrics::Command & command = axes[i].motor.metrics().command(slot);
+            if (command.count.load() == 0)
+                continue;
+            snprintf(line, sizeof(line), "mobspkr_command_errors_total{device=\"%s\",motor=\"%d\",command=\"%s\"} %u\n", HOSTNAME, i, MobSpkr::Metrics::command_name(slot), command.errors.load());
+            out += line;
+        }
+    }
+
+    struct {
+        const char * name;
+        const char * help;
+        const char * type;
+        double (*value)(const MobSpkr::Bus * bus);
+    } const bus_metrics[] = {
+        {"mobspkr_bus_sent_bytes_total", "Bytes written to the port", "counter", [](const MobSpkr::Bus * bus){ return (double)bus->bytes_tx(); }},
+        {"mobspkr_bus_received_bytes_total", "Bytes read from the port", "counter", [](const MobSpkr::Bus * bus){ return (double)bus->bytes_rx(); }},
+        {"mobspkr_bus_checksum_errors_total", "Garbled replies", "counter", [](const MobSpkr::Bus * bus){ return (double)bus->checksum_errors(); }},
+        {"mobspkr_bus_short_reads_total", "Reads ending within a reply", "counter", [](const MobSpkr::Bus * bus){ return (double)bus->short_reads(); }},
+        {"mobspkr_bus_timeouts_total", "Replies timed out", "counter", [](const MobSpkr::Bus * bus){ return (double)bus->timeout_count(); }},
+        {"mobspkr_bus_retries_total", "Queries repeated after a timeout", "counter", [](const MobSpkr::Bus * bus){ return (double)bus->retry_count(); }},
+        {"mobspkr_bus_late_replies_total", "Late replies dropped after a timeout", "counter", [](const MobSpkr::Bus * bus){ return (double)bus->late_count(); }},
+        {"mobspkr_bus_errors_total", "Commands failed", "counter", [](const MobSpkr::Bus * bus){ return (double)bus->error_count(); }},
+        {"mobspkr_bus_rtt_seconds", "Smoothed round-trip time", "gauge", [](const MobSpkr::Bus * bus){ return bus->get_srtt_us() / 1e6; }},
+        {"mobspkr_bus_timeout_seconds", "Current adaptive timeout", "gauge", [](const MobSpkr::Bus * bus){ return bus->get_rto_us() / 1e6; }},
+    };
+
+    for(auto & metric : bus_metrics){
+        render_header(out, metric.name, metric.help, metric.type);
+        for(std::size_t b = 0; b < buses.size(); b++){
+            snprintf(line, sizeof(line), "%s{device=\"%s\",port=\"%s\"} %.9g\n", metric.name, HOSTNAME, buses[b]->get_portname(), metric.value(buses[b]));
+            out += line;
+        }
+    }
+}
+
+static MobSpkr::Exporter exporter(render_metrics);
+
+static void send_schedule_stats(MobSpkr::Scheduler & scheduler, const char *host, int port)
+{
+    MobSpkr::Replies::Endpoint reply_to;
+    if (!replies.resolve(host, port, reply_to))
+        return;
+
+    std::map<std::string, MobSpkr::Scheduler::Stats> stats;
+    scheduler.get_stats(stats);
+
+    replies.send(reply_to, [&stats](char * buffer, std::size_t size){
+        osc::OutboundPacketStream p( buffer, size );
+
+        p << osc::BeginBundleImmediate;
+        for(std::map<std::string, MobSpkr::Scheduler::Stats>::iterator it = stats.begin(); it != stats.end(); it++){
+            MobSpkr::Scheduler::Stats & s = it->second;
+            p << osc::BeginMessage( "/schedule/stats" )
+              << HOSTNAME << it->first.c_str() << (int)s.count << (int)s.dropped
+              << (int)(s.count ? s.total_late_us / s.count : 0) << (int)s.max_late_us
+              << osc::EndMessage;
+        }
+        p << osc::EndBundle;
+
+        return p.Size();
+    });
+}
+
+class packet_listener : public osc::OscPacketListener {
+protected:
+
+    MobSpkr::Router m_router;
+    MobSpkr::Scheduler m_scheduler;
+
+    // scheduled bundles are released from another thread with -T
+    std::mutex m_mutex;
+
+    void process_bundle( const osc::ReceivedBundle& b, const char *data, std::size_t size,
+                         const IpEndpointName& remoteEndpoint )
+    {
+        if (!m_scheduler.schedule(b, data, size, remoteEndpoint))
+            ProcessBundle(b, remoteEndpoint);
+    }
+
+    // nested bundles may have timetags of their own
+    virtual void ProcessBundle( const osc::ReceivedBundle& b,
+                                const IpEndpointName& remoteEndpoint )
+    {
+        for(osc::ReceivedBundle::const_iterator i = b.ElementsBegin(); i != b.ElementsEnd(); i++){
+            if (i->IsBundle())
+                process_bundle(osc::ReceivedBundle(*i), i->Contents(), i->Size(), remoteEndpoint);
+            else
+                ProcessMessage(osc::ReceivedMessage(*i), remoteEndpoint);
+        }
+    }
+
+    virtual void ProcessMessage( const osc::ReceivedMessage& m,
+                                 const IpEndpointName& remoteEndpoint )
+    {
+        MobSpkr::Log::debug("OSC rx %s\n", m.AddressPattern());
+
+        if (m_router.dispatch(m, remoteEndpoint) == MobSpkr::Router::InvalidArguments)
+            MobSpkr::Log::warning("invalid arguments: %s ,%s\n", m.AddressPattern(), m.TypeTags());
+    }
+
+public:
+
+    packet_listener() : m_scheduler([this](const osc::ReceivedBundle& b, const IpEndpointName& remoteEndpoint){ release(b, remoteEndpoint); }) {
+        add_routes(m_router);
+
+        m_router.route<const char *, int>("/schedule/stats", [this](const IpEndpointName& remoteEndpoint, const char *host, int port){
+            send_schedule_stats(m_scheduler, host, port);
+        });
+    }
+
+    MobSpkr::Scheduler & scheduler(){ return m_scheduler; }
+
+    // malformed packets throw while being parsed
+    virtual void ProcessPacket( const char *data, int size,
+                                const IpEndpointName& remoteEndpoint )
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // keeping what was recorded so far, eg when the disk is full
+        if (recorder.is_open() && !recorder.append(data, size, remoteEndpoint.address, remoteEndpoint.port)){
+            MobSpkr::Log::error("recording stopped after %lu datagrams: %s\n", recorder.count(), strerror(errno));
+            recorder.close();
+        }
+
+        try {
+            osc::ReceivedPacket p(data, size);
+            if (p.IsBundle())
+                process_bundle(osc::ReceivedBundle(p), data, size, remoteEndpoint);
+            else
+                ProcessMessage(osc::ReceivedMessage(p), remoteEndpoint);
+        } catch( osc::Exception& e ){
+            MobSpkr::Log::warning("malformed packet: %s\n", e.what());
+        }
+    }
+
+    void release( const osc::ReceivedBundle& b, const IpEndpointName& remoteEndpoint )
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ProcessBundle(b, remoteEndpoint);
+    }
 };
 
-int set_motor_msr(int motor, int msr)
+MobSpkr::Motor::Callback report_failure(int motor, const char * what)
 {
-    printf("microstep resolution MSR = %d\n", msr);
-    if (MobSpkr::Motor::Response::Status::Success != motors[motor].command_setAxisParam_MicroStepResolution((MobSpkr::Motor::MicroStepResolution)msr, TIMEOUT_MS)){
-        fprintf(stderr, "failed\n");
-        return EXIT_FAILURE;
+    return [motor, what](MobSpkr::Motor::Response::Status status, const MobSpkr::Motor::Response & response){
+        if (status != MobSpkr::Motor::Response::Status::Success && status != MobSpkr::Motor::Response::Status::Superseded)
+            MobSpkr::Log::error("motor %d: %s failed (%d)\n", motor, what, status);
+        check_drained(motor);
+    };
+}
+
+// only enqueued (ports are started by startup before anything is sent), failures are reported on completion
+int issue(int motor, MobSpkr::Motor::Command command, const char * what)
+{
+    return axes[motor].motor.submit(command, TIMEOUT_MS, report_failure(motor, what)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int issue_setpoint(int motor, MobSpkr::Motor::Command command, const char * what)
+{
+    return axes[motor].motor.submit_setpoint(command, TIMEOUT_MS, report_failure(motor, what)) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+MobSpkr::Motor::Command rotate_command(int motor, int velocity)
+{
+    if (axes[motor].direction_right){
+        MobSpkr::Motor::Command command(MobSpkr::PD_1160::Catalogue::RotateRight);
+        command.set_value(velocity);
+        axes[motor].current_movement = velocity;
+        return command;
+    } else {
+        MobSpkr::Motor::Command command(MobSpkr::PD_1160::Catalogue::RotateLeft);
+        command.set_value(velocity);
+        axes[motor].current_movement = -velocity;
+        return command;
     }
+}
 
-    return EXIT_SUCCESS;
+void issue_sync(std::shared_ptr<MobSpkr::SyncGroup> group, const char * what, std::vector<uint32_t> reply_addresses)
+{
+    // reports the start skew between the motors to the sender(s)
+    MobSpkr::SyncGroup::submit(group, TIMEOUT_MS, [what, reply_addresses](MobSpkr::Motor::Response::Status status, long skew_us){
+
+        bool ok = status == MobSpkr::Motor::Response::Status::Success;
+        // superseded by newer setpoints (eg the next step of a ramp) while still queued
+        if (!ok && status != MobSpkr::Motor::Response::Status::Superseded)
+            MobSpkr::Log::error("%s: %d\n", what, status);
+        MobSpkr::Log::debug("%s: skew %ld us\n", what, skew_us);
+
+        for(uint32_t reply_address : reply_addresses){
+            send_skew(reply_address, skew_us, status);
+        }
+    });
 }
 
-int init_motor(int motor)
+// on the response port, with the status telling superseded setpoints from failed ones
+void send_skew(uint32_t reply_address, long skew_us, MobSpkr::Motor::Response::Status status)
 {
-    current_movement[motor] = 0;
+    bool ok = status == MobSpkr::Motor::Response::Status::Success;
 
-#if INTERPOLATION == 1 && STEPSIZE_RESOLUTION == 4
-        printf("interpolation = %d\n", INTERPOLATION);
-        if (MobSpkr::Motor::Response::Status::Success != motors[motor].command_setAxisParam_Interpolation(1, TIMEOUT_MS)){
-            fprintf(stderr, "failed\n");
-            return EXIT_FAILURE;
+    MobSpkr::Replies::Endpoint to;
+    to.address = reply_address;
+    to.port = opts.response_port;
+
+    replies.send(to, [skew_us, ok, status](char * buffer, std::size_t size){
+        osc::OutboundPacketStream p( buffer, size );
+
+        p << osc::BeginMessage( "/vehicle/skew" )
+            << HOSTNAME << (int)skew_us << (int)ok << (int)status
+            << osc::EndMessage;
+
+        return p.Size();
+    });
+}
+
+// a tick of the ramps (-J): the steps of several motors go out together, as /vehicle/* commands do
+void ramp(const std::vector<MobSpkr::Profiles::Change> & changes)
+{
+    std::vector<uint32_t> requests;
+    {
+        std::lock_guard<std::mutex> lock(ramp_mutex);
+        requests.swap(ramp_requests);
+    }
+
+    if (changes.size() == 1 && requests.empty()){
+        issue_setpoint((int)changes[0].index, rotate_command((int)changes[0].index, changes[0].velocity), "ramp");
+    } else if (!changes.empty()){
+        std::shared_ptr<MobSpkr::SyncGroup> group = MobSpkr::SyncGroup::create();
+        for(const MobSpkr::Profiles::Change & change : changes){
+            group->add(axes[change.index].motor, rotate_command((int)change.index, change.velocity));
+        }
+        issue_sync(group, "ramp", std::move(requests));
+    } else {
+        // at the targets already, nothing to send
+        for(uint32_t reply_address : requests){
+            send_skew(reply_address, 0, MobSpkr::Motor::Response::Status::Success);
         }
-#endif
-    printf("max current = %d\n", MAX_CURRENT);
-    if (MobSpkr::Motor::Response::Status::Success != motors[motor].command_setAxisParam_MaxCurrent(MAX_CURRENT, TIMEOUT_MS)){
-        fprintf(stderr, "failed\n");
-        return EXIT_FAILURE;
     }
-    printf("power down delay = %d (10ms = %d)\n", POWER_DOWN_DELAY_10MS, POWER_DOWN_DELAY_10MS);
-    if (MobSpkr::Motor::Response::Status::Success != motors[motor].command_setAxisParam_PowerDownDelay(POWER_DOWN_DELAY_10MS, TIMEOUT_MS)){
-        fprintf(stderr, "failed\n");
-        return EXIT_FAILURE;
+
+    for(const MobSpkr::Profiles::Change & change : changes){
+        uint32_t sender = axes[change.index].ramp_sender.load();
+        if (sender != 0)
+            check_busy((int)change.index, sender);
     }
-    printf("Pulse divisor = %d\n", PULSE_DIVISOR);
-    if (MobSpkr::Motor::Response::Status::Success != motors[motor].command_setAxisParam_PulseDivisor(PULSE_DIVISOR, TIMEOUT_MS)){
-        fprintf(stderr, "failed\n");
+}
+
+void send_value(const MobSpkr::Replies::Endpoint & to, const char * address, int motor_index, int value, int age_ms)
+{
+    replies.send(to, [address, motor_index, value, age_ms](char * buffer, std::size_t size){
+        osc::OutboundPacketStream p( buffer, size );
+
+        p << osc::BeginMessage( address )
+          << HOSTNAME << motor_index << value << age_ms
+          << osc::EndMessage;
+
+        return p.Size();
+    });
+}
+
+int sample_age_ms(const MobSpkr::Telemetry::Sample & sample)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(MobSpkr::Telemetry::clock::now() - sample.time).count();
+}
+
+int set_motor_msr(int motor, int msr)
+{
+    MobSpkr::Log::info("microstep resolution MSR = %d\n", msr);
+    MobSpkr::Motor::Command command(MobSpkr::PD_1160::Catalogue::SetAxisParam_MicroStepResolution);
+    command.set_value(msr);
+    if (issue(motor, command, "microstep resolution")){
+        MobSpkr::Log::error("failed\n");
         return EXIT_FAILURE;
     }
-    printf("ramp divisor = %d\n", RAMP_DIVISOR);
-    if (MobSpkr::Motor::Response::Status::Success != motors[motor].command_setAxisParam_RampDivisor(RAMP_DIVISOR, TIMEOUT_MS)){
-        fprintf(stderr, "failed\n");
-        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
+
+// written only where the module differs (see Startup)
+std::vector<MobSpkr::Startup::Step> init_sequence()
+{
+    return {
+#if INTERPOLATION == 1 && STEPSIZE_RESOLUTION == 4
+        {"interpolation", MobSpkr::PD_1160::Axis::Interpolation, INTERPOLATION},
+#endif
+        {"max current", MobSpkr::PD_1160::Axis::MaxCurrent, MAX_CURRENT},
+        {"power down delay", MobSpkr::PD_1160::Axis::PowerDownDelay, POWER_DOWN_DELAY_10MS},
+        {"pulse divisor", MobSpkr::PD_1160::Axis::PulseDivisor, PULSE_DIVISOR},
+        {"ramp divisor", MobSpkr::PD_1160::Axis::RampDivisor, RAMP_DIVISOR},
+        {"max acceleration", MobSpkr::PD_1160::Axis::MaxAcceleration, MAX_ACCELERATION},
+        {"microstep resolution", MobSpkr::PD_1160::Axis::MicroStepResolution, STEPSIZE_RESOLUTION},
+    };
+}
+
+#ifdef __linux__
+int open_osc_socket(int port)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0){
+        perror("socket");
+        return -1;
     }
-    printf("max acceleration = %d\n", MAX_ACCELERATION);
-    if (MobSpkr::Motor::Response::Status::Success != motors[motor].command_setAxisParam_MaxAcceleration(MAX_ACCELERATION, TIMEOUT_MS)){
-        fprintf(stderr, "failed\n");
-        return EXIT_FAILURE;
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0){
+        perror("bind");
+        close(fd);
+        return -1;
     }
-    return EXIT_SUCCESS;
+
+    return fd;
 }
 
-int main(int argc, char * argv[])
+void run_poller(MobSpkr::Reactor * reactor, MobSpkr::Poller * poller)
 {
-    argv0 = argv[0];
+    reactor->at(poller->poll(MobSpkr::Poller::clock::now()), [reactor, poller]{ run_poller(reactor, poller); });
+}
+
+// ticks only while ramping, the next target starts it again
+void run_profiles(MobSpkr::Reactor * reactor)
+{
+    MobSpkr::Profiles::clock::time_point next = profiles.poll(MobSpkr::Profiles::clock::now());
+    if (!profiles.is_idle())
+        reactor->at(next, [reactor]{ run_profiles(reactor); });
+}
+
+void receive_osc(int fd, osc::OscPacketListener & listener)
+{
+    static char buffer[65536];
+
+    while(true){
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
 
-    for(int i = 0; i < MAX_MOTORS; i++){
-        opts.motors[i].address = DEFAULT_ADDRESS;
-        opts.motors[i].direction_right = true;
+        ssize_t n = recvfrom(fd, buffer, sizeof(buffer), 0, (struct sockaddr *)&from, &from_len);
+        if (n < 0){
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                perror("recvfrom");
+            return;
+        }
+
+        try {
+            listener.ProcessPacket(buffer, n, IpEndpointName( ntohl(from.sin_addr.s_addr), ntohs(from.sin_port) ));
+        } catch ( std::exception & e ){
+            MobSpkr::Log::warning("malformed packet: %s\n", e.what());
+        }
     }
+}
+#endif
+
+int main(int argc, char * argv[])
+{
+    argv0 = argv[0];
 
     int c;
     int digit_optind = 0;
@@ -517,10 +1439,26 @@ int main(int argc, char * argv[])
                 {"response-port", required_argument, 0, 'r'},
                 {"addr",     required_argument, 0,  'a' },
                 {"dir", required_argument, 0, 'd'},
+                {"window", required_argument, 0, 'w'},
+                {"busy", required_argument, 0, 'b'},
+                {"turnaround", required_argument, 0, 't'},
+                {"threads", no_argument, 0, 'T'},
+                {"poll", required_argument, 0, 'P'},
+                {"multicast", required_argument, 0, 'M'},
+                {"max-late", required_argument, 0, 'L'},
+                {"jerk", required_argument, 0, 'J'},
+                {"drive", required_argument, 0, 'D'},
+                {"geometry", required_argument, 0, 'G'},
+                {"odometry", required_argument, 0, 'O'},
+                {"verbosity", required_argument, 0, 'V'},
+                {"metrics", required_argument, 0, 'S'},
+                {"record", required_argument, 0, 'R'},
+                {"capture", required_argument, 0, 'C'},
+                {"eeprom", no_argument, 0, 'E'},
                 {0,         0,                 0,  0 }
         };
 
-        c = getopt_long(argc, argv, "h?p:r:a:d:",
+        c = getopt_long(argc, argv, "h?p:r:a:d:w:b:t:TP:M:L:J:D:G:O:V:S:R:C:E",
                         long_options, &option_index);
         if (c == -1)
             break;
@@ -543,51 +1481,153 @@ int main(int argc, char * argv[])
                 }
                 break;
 
-            case 'a': {// --addr
-                if (std::strlen(optarg) < 3 || std::strchr(optarg, ':') == NULL) {
-                    fprintf(stderr, "invalid addr option\n");
+            case 'a': // --addr
+                opts.addresses.push_back(optarg);
+                break;
+
+            case 'd': // --dir
+                opts.directions.push_back(optarg);
+                break;
+
+            case 'w': // --window
+                opts.window = std::atoi(optarg);
+                if (opts.window < 1 || (int)MobSpkr::Bus::MAX_WINDOW < opts.window) {
+                    fprintf(stderr, "invalid window: %d (1 - %d)\n", opts.window, MobSpkr::Bus::MAX_WINDOW);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'b': // --busy
+                opts.busy_threshold = std::atoi(optarg);
+                if (opts.busy_threshold < 1 || (int)MobSpkr::Bus::QUEUE_SIZE < opts.busy_threshold) {
+                    fprintf(stderr, "invalid busy threshold: %d (1 - %d)\n", opts.busy_threshold, (int)MobSpkr::Bus::QUEUE_SIZE);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 't': // --turnaround
+                opts.turnaround_us = std::atoi(optarg);
+                if (opts.turnaround_us < 0 || 1000000 < opts.turnaround_us) {
+                    fprintf(stderr, "invalid turnaround: %d (0 - 1000000)\n", opts.turnaround_us);
                     return EXIT_FAILURE;
                 }
-                int motor_index = std::atoi(optarg);
+                break;
 
-                if (motor_index >= MAX_MOTORS) {
-                    fprintf(stderr, "motor index too high (max %d)\n", MAX_MOTORS);
+            case 'T': // --threads
+                opts.threads = true;
+                break;
+
+            case 'P': // --poll
+                opts.poll_active_ms = std::atoi(optarg);
+                opts.poll_idle_ms = std::strchr(optarg, ':') ? std::atoi(std::strchr(optarg, ':') + 1) : opts.poll_active_ms;
+                if (opts.poll_active_ms < 0 || opts.poll_idle_ms < 0) {
+                    fprintf(stderr, "invalid poll periods: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'M': {// --multicast
+                char * port = std::strchr(optarg, ':');
+                if (port == NULL) {
+                    fprintf(stderr, "invalid multicast option: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                *port++ = '\0';
+                opts.multicast_group = optarg;
+                opts.multicast_port = std::atoi(port);
+                if (std::strchr(port, ':'))
+                    opts.multicast_rate_hz = std::atof(std::strchr(port, ':') + 1);
+                if (opts.multicast_port < 1 || 0xffff < opts.multicast_port) {
+                    fprintf(stderr, "invalid multicast port: %d\n", opts.multicast_port);
+                    return EXIT_FAILURE;
+                }
+                if (opts.multicast_rate_hz <= 0 || MobSpkr::Subscriptions::MAX_RATE_HZ < opts.multicast_rate_hz) {
+                    fprintf(stderr, "invalid multicast rate: %g (max %u)\n", opts.multicast_rate_hz, MobSpkr::Subscriptions::MAX_RATE_HZ);
                     return EXIT_FAILURE;
                 }
+                break;
+            }
 
-                int address = std::atoi(std::strchr(optarg, ':') + 1);
+            case 'L': // --max-late
+                opts.max_late_ms = std::atoi(optarg);
+                if (opts.max_late_ms < 0) {
+                    fprintf(stderr, "invalid max lateness: %d\n", opts.max_late_ms);
+                    return EXIT_FAILURE;
+                }
+                break;
 
-                if (address < 1 || 255 < address) {
-                    fprintf(stderr, "invalid motor address, must be 1-255\n");
+            case 'J': {// --jerk
+                opts.profiles = true;
+                opts.jerk = std::atoi(optarg);
+                char * accel = std::strchr(optarg, ':');
+                if (accel){
+                    opts.max_acceleration = std::atoi(accel + 1);
+                    if (std::strchr(accel + 1, ':'))
+                        opts.tick_hz = std::atoi(std::strchr(accel + 1, ':') + 1);
+                }
+                if (opts.jerk < 1 || opts.max_acceleration < 1 || opts.tick_hz < 1 || (int)MobSpkr::Profiles::MAX_TICK_HZ < opts.tick_hz) {
+                    fprintf(stderr, "invalid profile: %s (tick max %d Hz)\n", optarg, MobSpkr::Profiles::MAX_TICK_HZ);
                     return EXIT_FAILURE;
                 }
-                opts.motors[motor_index].address = address;
                 break;
             }
 
-            case 'd': {// --dir
-                if (std::strlen(optarg) < 3 || std::strchr(optarg, ':') == NULL) {
-                    fprintf(stderr, "invalid addr option\n");
+            case 'D': // --drive
+                opts.drive = optarg;
+                break;
+
+            case 'G': // --geometry
+                if (std::strchr(optarg, ':') == NULL) {
+                    fprintf(stderr, "invalid geometry option: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                opts.wheelbase = std::atof(optarg);
+                opts.wheel_radius = std::atof(std::strchr(optarg, ':') + 1);
+                if (opts.wheelbase <= 0 || opts.wheel_radius <= 0) {
+                    fprintf(stderr, "invalid geometry: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'O': // --odometry
+                opts.odometry_rate_hz = std::atoi(optarg);
+                if (opts.odometry_rate_hz < 1 || 1000 < opts.odometry_rate_hz) {
+                    fprintf(stderr, "invalid odometry rate: %d (1 - 1000)\n", opts.odometry_rate_hz);
                     return EXIT_FAILURE;
                 }
-                int motor_index = std::atoi(optarg);
+                break;
 
-                if (motor_index >= MAX_MOTORS) {
-                    fprintf(stderr, "motor index too high (max %d)\n", MAX_MOTORS);
+            case 'V': // --verbosity
+                if (!MobSpkr::Log::parse_level(optarg, opts.log_level)) {
+                    fprintf(stderr, "invalid log level: %s\n", optarg);
                     return EXIT_FAILURE;
                 }
+                break;
 
-                bool direction_right;
-                if ( *(std::strchr(optarg, ':') + 1) == 'r')
-                    direction_right = true;
-                else if ( *(std::strchr(optarg, ':') + 1) == 'l')
-                    direction_right = false;
-                else {
-                    fprintf(stderr, "invalid direction (must be r or l): %s\n", std::strchr(optarg, ':') + 1);
+            case 'S': // --metrics
+                opts.metrics_port = std::atoi(optarg);
+                if (opts.metrics_port < 1 || 65535 < opts.metrics_port) {
+                    fprintf(stderr, "invalid metrics port: %s\n", optarg);
                     return EXIT_FAILURE;
                 }
+                break;
+
+            case 'R': // --record
+                opts.record_path = optarg;
+                break;
 
-                opts.motors[motor_index].direction_right = direction_right;
+            case 'E': // --eeprom
+                opts.eeprom = true;
+                break;
+
+            case 'C': { // --capture
+                char * end;
+                opts.capture_entries = std::strtol(optarg, &end, 10);
+                if (end == optarg || opts.capture_entries < 0 || (*end != '\0' && *end != ':')) {
+                    fprintf(stderr, "invalid capture: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                opts.capture_path = *end == ':' ? end + 1 : NULL;
                 break;
             }
 
@@ -602,53 +1642,277 @@ int main(int argc, char * argv[])
         }
     }
 
+    MobSpkr::Log::instance().set_level(opts.log_level);
+
     if (optind == argc) {
         fprintf(stderr, "Missing arguments. Try %s -h\n", argv0);
         return EXIT_FAILURE;
     }
-    if (argc - optind > MAX_MOTORS){
-        fprintf(stderr, "Too many motors (max %d)\n", MAX_MOTORS);
+
+    // [<name>=]<path>
+    std::vector<std::string> names;
+    for(int i = optind; i < argc; i++){
+        const char * equals = std::strchr(argv[i], '=');
+        names.push_back(equals ? std::string(argv[i], equals - argv[i]) : std::string());
+    }
+    if (!axes.create(names)){
+        fprintf(stderr, "motor names must be unique\n");
         return EXIT_FAILURE;
     }
+    for(motor_count = 0; optind < argc; motor_count++, optind++){
+        const char * equals = std::strchr(argv[optind], '=');
+        axes[motor_count].motor.set_portname(equals ? (char *)equals + 1 : argv[optind]);
+        axes[motor_count].motor.set_address(DEFAULT_ADDRESS);
+    }
 
-    while(optind < argc){
-        motors[motor_count].set_portname(argv[optind++]);
-        motors[motor_count].set_address(opts.motors[motor_count].address);
-        motor_count++;
+    for(const char * arg : opts.addresses){
+        const char * value;
+        int motor_index = motor_option(arg, &value);
+        if (motor_index < 0) {
+            fprintf(stderr, "invalid addr option (no such motor): %s\n", arg);
+            return EXIT_FAILURE;
+        }
+
+        int address = std::atoi(value);
+
+        if (address < 1 || 255 < address) {
+            fprintf(stderr, "invalid motor address, must be 1-255\n");
+            return EXIT_FAILURE;
+        }
+        axes[motor_index].motor.set_address(address);
     }
 
-    // initialize before motor opening
-    packet_listener listener;
-    UdpListeningReceiveSocket osc_rx_socket(IpEndpointName( IpEndpointName::ANY_ADDRESS, opts.port ),&listener );
+    for(const char * arg : opts.directions){
+        const char * value;
+        int motor_index = motor_option(arg, &value);
+        if (motor_index < 0) {
+            fprintf(stderr, "invalid dir option (no such motor): %s\n", arg);
+            return EXIT_FAILURE;
+        }
 
-    printf("Started OSC receiver at port %d\n", opts.port);
+        if (*value == 'r')
+            axes[motor_index].direction_right = true;
+        else if (*value == 'l')
+            axes[motor_index].direction_right = false;
+        else {
+            fprintf(stderr, "invalid direction (must be r or l): %s\n", value);
+            return EXIT_FAILURE;
+        }
+    }
 
+    if (opts.drive){
+        const char * value;
+        opts.drive_left = motor_option(opts.drive, &value);
+        opts.drive_right = opts.drive_left < 0 ? -1 : axes.resolve(value);
+        if (opts.drive_left < 0 || opts.drive_right < 0 || opts.drive_left == opts.drive_right) {
+            fprintf(stderr, "invalid drive motors: %s (0 - %d or names, distinct)\n", opts.drive, motor_count - 1);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // motors on the same path share one (half-duplex) bus
     for(int i = 0; i < motor_count; i++){
-	printf("INITIALIZING MOTOR %d: %s\n", i, motors[i].get_portname());
-        if (!motors[i].open()){
-            fprintf(stderr, "failed\n");
-            goto stopping;
+        MobSpkr::Bus * bus = NULL;
+
+        for(std::size_t b = 0; b < buses.size(); b++){
+            if (std::strcmp(buses[b]->get_portname(), axes[i].motor.get_portname()) == 0)
+                bus = buses[b];
         }
-        printf("Connected using address %d\n", motors[i].get_address());
 
-        if (init_motor(i))
+        if (bus == NULL){
+            bus = new MobSpkr::Bus(axes[i].motor.get_portname());
+            buses.push_back(bus);
+            bus->set_window(opts.window);
+        } else {
+            for(int j = 0; j < i; j++){
+                if (axes[j].motor.get_bus() == bus && axes[j].motor.get_address() == axes[i].motor.get_address()){
+                    fprintf(stderr, "motors %d and %d share %s with the same address %d\n", j, i, bus->get_portname(), axes[i].motor.get_address());
+                    return EXIT_FAILURE;
+                }
+            }
+            bus->set_half_duplex(true, opts.turnaround_us);
+        }
+
+        axes[i].motor.attach(bus);
+    }
+
+    if (opts.capture_entries){
+        if (!capture.open(opts.capture_entries, opts.capture_path)){
+            fprintf(stderr, "failed to set up capture%s%s\n", opts.capture_path ? " in " : "", opts.capture_path ? opts.capture_path : "");
             return EXIT_FAILURE;
+        }
+        for(std::size_t b = 0; b < buses.size(); b++){
+            buses[b]->set_capture(&capture);
+        }
+        snprintf(capture_dump_path, sizeof(capture_dump_path), "/tmp/mobspkr-capture-%d.tmcl", (int)getpid());
+        signal(SIGUSR1, on_sigusr1);
+    }
 
-        if (set_motor_msr(i, STEPSIZE_RESOLUTION))
+    for(int i = 0; i < motor_count; i++){
+        telemetry.add(axes[i].motor);
+    }
+    telemetry.set_period(MobSpkr::Telemetry::Position, opts.poll_active_ms, opts.poll_idle_ms);
+    telemetry.set_period(MobSpkr::Telemetry::Speed, opts.poll_active_ms, opts.poll_idle_ms);
+    telemetry.set_period(MobSpkr::Telemetry::Temperature, opts.poll_idle_ms, opts.poll_idle_ms);
+    telemetry.set_period(MobSpkr::Telemetry::Voltage, opts.poll_idle_ms, opts.poll_idle_ms);
+    // positions are absolute, idle motors need no finer sampling
+    if (opts.odometry_rate_hz)
+        telemetry.set_period(MobSpkr::Telemetry::Position, 1000 / opts.odometry_rate_hz, opts.poll_idle_ms);
+
+    if (opts.drive_left < motor_count && opts.drive_right < motor_count){
+        // m per microstep, counting backwards if turning left (mirrored)
+        double step = 2 * M_PI * opts.wheel_radius / NSTEPS_ONE_ROTATION;
+        odometry.configure(opts.drive_left, axes[opts.drive_left].direction_right ? step : -step,
+                           opts.drive_right, axes[opts.drive_right].direction_right ? step : -step,
+                           opts.wheelbase);
+        telemetry.set_listener([](std::size_t index, MobSpkr::Telemetry::Field field, const MobSpkr::Telemetry::Sample & sample){
+            if (field == MobSpkr::Telemetry::Position)
+                odometry.sampled(index, sample.value, sample.time);
+        });
+        subscriptions.set_odometry(&odometry);
+    }
+
+    profiles.resize(motor_count);
+    profiles.configure(opts.jerk, opts.max_acceleration, opts.tick_hz);
+
+    if (opts.record_path){
+        if (!recorder.open(opts.record_path)){
+            fprintf(stderr, "failed to open %s: %s\n", opts.record_path, strerror(errno));
             return EXIT_FAILURE;
+        }
+        printf("Recording to %s\n", opts.record_path);
+    }
 
+    if (!replies.is_ok()){
+        fprintf(stderr, "failed to open reply socket\n");
+        return EXIT_FAILURE;
     }
 
+    if (opts.multicast_group && !subscriptions.subscribe(opts.multicast_group, opts.multicast_port, MobSpkr::Subscriptions::ALL, opts.multicast_rate_hz, 0)){
+        fprintf(stderr, "invalid multicast group: %s\n", opts.multicast_group);
+        return EXIT_FAILURE;
+    }
+
+    // initialize before motor opening
+    packet_listener listener;
+    UdpListeningReceiveSocket * osc_rx_socket = NULL;
+#ifdef __linux__
+    MobSpkr::Reactor * reactor = NULL;
+    int osc_fd = -1;
+
+    if (!opts.threads){
+        reactor = new MobSpkr::Reactor();
+        osc_fd = open_osc_socket(opts.port);
+        if (osc_fd < 0 || !reactor->is_ok() || !reactor->watch(osc_fd, [osc_fd, &listener](uint32_t events){ receive_osc(osc_fd, listener); })){
+            fprintf(stderr, "failed to set up event loop\n");
+            return EXIT_FAILURE;
+        }
+        // replies queued while handling events go out together
+        replies.set_notify([reactor]{ reactor->at(MobSpkr::Reactor::clock::now(), []{ replies.flush(); }); });
+        listener.scheduler().set_notify([reactor, &listener](MobSpkr::Scheduler::clock::time_point due){
+            reactor->at(due, [&listener]{ listener.scheduler().poll(MobSpkr::Scheduler::clock::now()); });
+        });
+        profiles.set_notify([reactor](MobSpkr::Profiles::clock::time_point tick){
+            reactor->at(tick, [reactor]{ run_profiles(reactor); });
+        });
+    } else
+#endif
+    {
+        osc_rx_socket = new UdpListeningReceiveSocket(IpEndpointName( IpEndpointName::ANY_ADDRESS, opts.port ),&listener );
+        replies.start();
+        listener.scheduler().start();
+        if (opts.profiles)
+            profiles.start();
+    }
+    listener.scheduler().set_max_late(opts.max_late_ms);
+
+    printf("Started OSC receiver at port %d\n", opts.port);
+
+    // ports are opened, started and configured (as far as needed) in the background, concurrently; until then
+    // (or on failure, until a retry succeeds) their motors refuse commands
+    for(int i = 0; i < motor_count; i++){
+        startup.add(axes[i].motor, init_sequence());
+    }
+    startup.set_store(opts.eeprom);
+    startup.set_listener([](std::size_t motor, MobSpkr::Startup::State state){
+        MobSpkr::Log::info("motor %d (%s): %s\n", (int)motor, axes[motor].motor.get_portname(), MobSpkr::Startup::state_name(state));
+    });
+#ifdef __linux__
+    if (reactor){
+        startup.set_starter([reactor](MobSpkr::Bus * bus){ return reactor->add(bus); });
+        run_poller(reactor, &startup);
+    } else
+#endif
+    {
+        startup.set_starter([](MobSpkr::Bus * bus){ return bus->start(); });
+        startup.start();
+    }
+
+#ifdef __linux__
+    if (reactor){
+        run_poller(reactor, &telemetry);
+        run_poller(reactor, &subscriptions);
+    } else
+#endif
+    {
+        telemetry.start();
+        subscriptions.start();
+    }
+
+    if (opts.metrics_port){
+        if (!exporter.start(opts.metrics_port)){
+            fprintf(stderr, "failed to serve metrics at port %d\n", opts.metrics_port);
+            goto stopping;
+        }
+        printf("Serving metrics at http://127.0.0.1:%d/metrics\n", opts.metrics_port);
+    }
 
     printf("press Ctrl+C (SIGINT) to stop\n");
-    osc_rx_socket.RunUntilSigInt();
+    fflush(stdout);
+
+    // from now on the terminal is written to in the background
+    MobSpkr::Log::instance().start();
+
+#ifdef __linux__
+    if (reactor)
+        reactor->run();
+    else
+#endif
+    osc_rx_socket->RunUntilSigInt();
 
 stopping:
 
+    exporter.stop();
+    startup.stop();
+    listener.scheduler().stop();
+    profiles.stop();
+    subscriptions.stop();
+    telemetry.stop();
+    replies.stop();
+
     for(int i = 0; i < motor_count; i++){
-        motors[i].close();
+        axes[i].motor.close();
+    }
+
+    for(MobSpkr::Bus * bus : buses){
+        delete bus;
+    }
+
+#ifdef __linux__
+    if (osc_fd >= 0)
+        close(osc_fd);
+    delete reactor;
+#endif
+    delete osc_rx_socket;
+
+    if (recorder.is_open()){
+        printf("Recorded %lu datagrams\n", recorder.count());
+        recorder.close();
     }
 
+    // and whatever is still queued
+    MobSpkr::Log::instance().stop();
+    MobSpkr::Log::instance().poll(MobSpkr::Log::clock::now());
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,143 @@
+#include "scheduler.hpp"
+#include "log.hpp"
+
+#include <cstdio>
+
+namespace MobSpkr {
+
+    // 1900 (NTP) to 1970 (unix)
+    static const osc::uint64 NTP_UNIX_OFFSET = 2208988800ULL;
+
+    Scheduler::clock::time_point Scheduler::due_of(osc::uint64 timetag) {
+        osc::uint64 seconds = (timetag >> 32) - NTP_UNIX_OFFSET;
+        osc::uint64 fraction = timetag & 0xffffffff;
+
+        std::chrono::system_clock::time_point time = std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                std::chrono::seconds(seconds) + std::chrono::nanoseconds((fraction * 1000000000ULL) >> 32)
+            ));
+
+        return clock::now() + std::chrono::duration_cast<clock::duration>(time - std::chrono::system_clock::now());
+    }
+
+    bool Scheduler::account(const osc::ReceivedBundle & bundle, long late_us) {
+        bool drop = m_max_late_ms > 0 && late_us > (long)m_max_late_ms * 1000;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // nested bundles are accounted for once they are due themselves
+        for(osc::ReceivedBundle::const_iterator i = bundle.ElementsBegin(); i != bundle.ElementsEnd(); i++){
+            if (i->IsBundle())
+                continue;
+
+            std::string address = osc::ReceivedMessage(*i).AddressPattern();
+
+            std::map<std::string, Stats>::iterator it = m_stats.find(address);
+            if (it == m_stats.end()){
+                if (m_stats.size() >= MAX_ADDRESSES)
+                    continue;
+                it = m_stats.insert(std::make_pair(address, Stats())).first;
+            }
+
+            Stats & stats = it->second;
+            if (drop){
+                stats.dropped++;
+                continue;
+            }
+            stats.count++;
+            if (late_us > 0){
+                stats.total_late_us += late_us;
+                if (late_us > stats.max_late_us)
+                    stats.max_late_us = late_us;
+            }
+        }
+
+        if (drop)
+            Log::warning("dropping bundle %ld us late\n", late_us);
+
+        return !drop;
+    }
+
+    bool Scheduler::schedule(const osc::ReceivedBundle & bundle, const char * data, std::size_t size, const IpEndpointName & from) {
+        if (bundle.TimeTag() == IMMEDIATE)
+            return false;
+
+        clock::time_point now = clock::now();
+        clock::time_point due = due_of(bundle.TimeTag());
+
+        if (due <= now)
+            return !account(bundle, std::chrono::duration_cast<std::chrono::microseconds>(now - due).count());
+
+        if (due > now + std::chrono::milliseconds(MAX_AHEAD_MS)){
+            Log::warning("dropping bundle due in %lld ms, clocks out of sync?\n",
+                    (long long)std::chrono::duration_cast<std::chrono::milliseconds>(due - now).count());
+            return true;
+        }
+
+        bool first;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (m_pending.size() >= MAX_PENDING){
+                Log::warning("too many scheduled bundles, dropping\n");
+                return true;
+            }
+
+            Entry entry;
+            entry.packet.assign(data, data + size);
+            entry.from = from;
+            first = due < (m_pending.empty() ? clock::time_point::max() : m_pending.begin()->first);
+            m_pending.insert(std::make_pair(due, std::move(entry)));
+        }
+
+        if (m_notify)
+            m_notify(due);
+        else if (first)
+            wake();
+
+        return true;
+    }
+
+    Scheduler::clock::time_point Scheduler::poll(clock::time_point now) {
+        while(true){
+            Entry entry;
+            clock::time_point due;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+
+                if (m_pending.empty())
+                    return now + std::chrono::milliseconds(MAX_AHEAD_MS);
+                if (m_pending.begin()->first > now)
+                    return m_pending.begin()->first;
+
+                due = m_pending.begin()->first;
+                entry = std::move(m_pending.begin()->second);
+                m_pending.erase(m_pending.begin());
+            }
+
+            // released without holding the lock, elements may be scheduled again (nested bundles)
+            try {
+                osc::ReceivedBundle bundle(osc::ReceivedPacket(entry.packet.data(), entry.packet.size()));
+
+                long late_us = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - due).count();
+                if (account(bundle, late_us))
+                    m_release(bundle, entry.from);
+
+            } catch( osc::Exception & e ){
+                Log::warning("malformed scheduled bundle: %s\n", e.what());
+            }
+        }
+    }
+
+    std::size_t Scheduler::pending() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_pending.size();
+    }
+
+    void Scheduler::get_stats(std::map<std::string, Stats> & stats) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        stats = m_stats;
+    }
+
+}
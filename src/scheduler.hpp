@@ -0,0 +1,100 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_SCHEDULER_HPP
+#define MOBSPKR_VEHICLE_CTRL_SCHEDULER_HPP
+
+#include "poller.hpp"
+
+#include "osc/OscReceivedElements.h"
+#include "ip/IpEndpointName.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace MobSpkr {
+
+/**
+ * Holds OSC bundles with a future timetag back until they are due.
+ *
+ * Timetags are taken as NTP time, ie the sender's and our clock are expected to be in sync.
+ * How late each address' messages are executed is kept track of, with an optional limit beyond which
+ * bundles are dropped instead.
+ */
+class Scheduler : public Poller {
+
+    public:
+
+        // processes the bundle's elements right away
+        typedef std::function<void(const osc::ReceivedBundle & bundle, const IpEndpointName & from)> Release;
+
+        // a bundle was scheduled due at the given time
+        typedef std::function<void(clock::time_point due)> Notify;
+
+        struct Stats {
+            unsigned long count = 0;
+            unsigned long dropped = 0;
+            long long total_late_us = 0;
+            long max_late_us = 0;
+        };
+
+        const static std::size_t MAX_PENDING = 256;
+        const static std::size_t MAX_ADDRESSES = 64;
+
+        // further ahead most likely means the clocks are off
+        const static unsigned int MAX_AHEAD_MS = 60000;
+
+        const static osc::uint64 IMMEDIATE = 1;
+
+    protected:
+
+        struct Entry {
+            std::vector<char> packet;
+            IpEndpointName from;
+        };
+
+        Release m_release;
+        Notify m_notify;
+        unsigned int m_max_late_ms;
+
+        std::multimap<clock::time_point, Entry> m_pending;
+        std::map<std::string, Stats> m_stats;
+        std::mutex m_mutex;
+
+        // false if to be dropped
+        bool account(const osc::ReceivedBundle & bundle, long late_us);
+
+    public:
+
+        Scheduler(Release release) : m_release(std::move(release)), m_max_late_ms(0) {}
+        ~Scheduler(){ stop(); }
+
+        /**
+         * Bundles later than this are dropped, 0 executes them however late.
+         */
+        void set_max_late(unsigned int ms){ m_max_late_ms = ms; }
+
+        /**
+         * Instead of waking the thread (see start()), eg to have an event loop poll() at the due time.
+         */
+        void set_notify(Notify notify){ m_notify = std::move(notify); }
+
+        static clock::time_point due_of(osc::uint64 timetag);
+
+        /**
+         * True if the bundle has been taken care of (scheduled or dropped), false if it is to be processed now.
+         */
+        bool schedule(const osc::ReceivedBundle & bundle, const char * data, std::size_t size, const IpEndpointName & from);
+
+        /**
+         * Releases due bundles, returns when the next one is due.
+         */
+        clock::time_point poll(clock::time_point now) override;
+
+        std::size_t pending();
+
+        void get_stats(std::map<std::string, Stats> & stats);
+};
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_SCHEDULER_HPP
@@ -0,0 +1,273 @@
+#include "startup.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+
+namespace MobSpkr {
+
+    static unsigned int backed_off(unsigned int retry_ms) {
+        return std::min(2 * retry_ms, (unsigned int)Startup::MAX_RETRY_MS);
+    }
+
+    const char * Startup::state_name(State state) {
+        switch(state){
+            case Offline:       return "offline";
+            case Initializing:  return "initializing";
+            case Ready:         return "ready";
+            default:            return "?";
+        }
+    }
+
+    std::size_t Startup::add(Motor & motor, std::vector<Step> steps) {
+        Entry entry;
+        entry.motor = &motor;
+        entry.steps = std::move(steps);
+        entry.state = Offline;
+        entry.due = clock::now();
+        entry.retry_ms = MIN_RETRY_MS;
+        entry.remaining = 0;
+        entry.failed = false;
+        entry.reopen = false;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.push_back(entry);
+        return m_entries.size() - 1;
+    }
+
+    Startup::State Startup::state(std::size_t index) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return index < m_entries.size() ? m_entries[index].state : Offline;
+    }
+
+    void Startup::reinit(std::size_t index) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_entries.size() <= index)
+                return;
+
+            Entry & entry = m_entries[index];
+            // replies of a configuration still under way are then ignored
+            if (entry.state == Initializing)
+                return;
+            entry.due = clock::now();
+            entry.retry_ms = MIN_RETRY_MS;
+        }
+        change(index, Offline);
+        wake();
+    }
+
+    void Startup::change(std::size_t index, State state) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_entries[index].state = state;
+        }
+        if (m_listener)
+            m_listener(index, state);
+    }
+
+    bool Startup::in_use(const Bus * bus, std::size_t index) const {
+        for(std::size_t i = 0; i < m_entries.size(); i++){
+            if (i != index && m_entries[i].state != Offline && m_entries[i].motor->get_bus() == bus)
+                return true;
+        }
+        return false;
+    }
+
+    Startup::clock::time_point Startup::poll(clock::time_point now) {
+        clock::time_point next = now + std::chrono::milliseconds((unsigned int)CHECK_MS);
+
+        std::vector<std::size_t> due;
+        std::vector<std::size_t> lost;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for(std::size_t i = 0; i < m_entries.size(); i++){
+                Entry & entry = m_entries[i];
+                // eg hung up, retried like a failed configuration
+                if (entry.state == Ready && !entry.motor->is_running()){
+                    Log::warning("motor %u: %s lost, retrying in %u ms\n", (unsigned int)i, entry.motor->get_portname(), entry.retry_ms);
+                    entry.due = now + std::chrono::milliseconds(entry.retry_ms);
+                    entry.reopen = true;
+                    lost.push_back(i);
+                    continue;
+                }
+                if (entry.state != Offline)
+                    continue;
+                if (entry.due <= now)
+                    due.push_back(i);
+                else if (entry.due < next)
+                    next = entry.due;
+            }
+        }
+
+        // not holding the lock, completions may come in right away
+        for(std::size_t index : lost){
+            change(index, Offline);
+        }
+        for(std::size_t index : due){
+            begin(index, now);
+        }
+
+        return next;
+    }
+
+    void Startup::begin(std::size_t index, clock::time_point now) {
+        Entry & entry = m_entries[index];
+        Motor & motor = *entry.motor;
+        Bus * bus = motor.get_bus();
+
+        // stopped (eg hung up) or failing: closed, so the device is opened anew rather than the stale fd restarted,
+        // unless a motor sharing the port works (and this one is eg not powered)
+        if (bus && bus->is_open()){
+            bool reopen;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                reopen = !bus->is_running() || (entry.reopen && !in_use(bus, index));
+                entry.reopen = false;
+            }
+            if (reopen){
+                Log::info("motor %u: reopening %s\n", (unsigned int)index, motor.get_portname());
+                bus->close();
+            }
+        }
+
+        // ports shared by several motors are opened and started with the first
+        bool up = bus && (bus->is_open() || motor.open()) && (bus->is_running() || m_starter(bus));
+        if (!up){
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Log::warning("motor %u: %s not available, retrying in %u ms\n", (unsigned int)index, motor.get_portname(), entry.retry_ms);
+            entry.due = now + std::chrono::milliseconds(entry.retry_ms);
+            entry.retry_ms = backed_off(entry.retry_ms);
+            entry.reopen = true;
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            entry.stale.clear();
+            entry.remaining = entry.steps.size();
+            entry.failed = false;
+            entry.started = now;
+        }
+        change(index, Initializing);
+
+        if (entry.steps.empty()){
+            finish(index, false);
+            return;
+        }
+
+        // all at once, the bus keeps as many in flight as its window allows
+        for(const Step & step : entry.steps){
+            Motor::Command command(TMCL::DEFAULT_ADDRESS, TMCL::GAP, step.parameter, 0, 0);
+            bool queued = motor.submit(command, m_timeout_ms, [this, index, &step](Motor::Response::Status status, const Motor::Response & response){
+                read(index, step, status, (int32_t)response.value());
+            });
+            if (!queued)
+                read(index, step, Motor::Response::Status::Error, 0);
+        }
+    }
+
+    bool Startup::replied(std::size_t index, const Step & step, const char * what, Motor::Response::Status status) {
+        Entry & entry = m_entries[index];
+
+        // the first failure only, an unpowered module fails them all
+        if (status != Motor::Response::Status::Success && status != Motor::Response::Status::CommandLoadedIntoEEPROM && !entry.failed){
+            Log::error("motor %u: %s %s failed: %d\n", (unsigned int)index, what, step.name, status);
+            entry.failed = true;
+        }
+        return --entry.remaining == 0;
+    }
+
+    void Startup::read(std::size_t index, const Step & step, Motor::Response::Status status, int32_t value) {
+        bool failed;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Entry & entry = m_entries[index];
+
+            if (status == Motor::Response::Status::Success && value != step.value){
+                Log::info("motor %u: %s %d -> %d\n", (unsigned int)index, step.name, value, step.value);
+                entry.stale.push_back(&step);
+            }
+            if (!replied(index, step, "reading", status))
+                return;
+
+            failed = entry.failed;
+        }
+
+        if (failed)
+            finish(index, true);
+        else
+            write(index);
+    }
+
+    void Startup::write(std::size_t index) {
+        Entry & entry = m_entries[index];
+        bool store = m_store.load();
+
+        std::vector<const Step *> stale;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            stale = entry.stale;
+            entry.remaining = stale.size() * (store ? 2 : 1);
+        }
+
+        if (stale.empty()){
+            finish(index, false);
+            return;
+        }
+
+        for(const Step * step : stale){
+            Motor::Command command(TMCL::DEFAULT_ADDRESS, TMCL::SAP, step->parameter, 0, (uint32_t)step->value);
+            bool queued = entry.motor->submit(command, m_timeout_ms, [this, index, step](Motor::Response::Status status, const Motor::Response & response){
+                written(index, *step, status);
+            });
+            if (!queued)
+                written(index, *step, Motor::Response::Status::Error);
+
+            // right behind, the queue keeps the order
+            if (!store)
+                continue;
+            command.set_command_number(TMCL::STAP);
+            queued = entry.motor->submit(command, m_timeout_ms, [this, index, step](Motor::Response::Status status, const Motor::Response & response){
+                written(index, *step, status);
+            });
+            if (!queued)
+                written(index, *step, Motor::Response::Status::Error);
+        }
+    }
+
+    void Startup::written(std::size_t index, const Step & step, Motor::Response::Status status) {
+        bool failed;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!replied(index, step, "writing", status))
+                return;
+
+            failed = m_entries[index].failed;
+        }
+        finish(index, failed);
+    }
+
+    void Startup::finish(std::size_t index, bool failed) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Entry & entry = m_entries[index];
+
+            clock::time_point now = clock::now();
+            if (failed){
+                Log::warning("motor %u: configuration failed, retrying in %u ms\n", (unsigned int)index, entry.retry_ms);
+                entry.due = now + std::chrono::milliseconds(entry.retry_ms);
+                entry.retry_ms = backed_off(entry.retry_ms);
+                // not here, this may be the bus' own I/O thread
+                entry.reopen = true;
+            } else {
+                Log::info("motor %u: ready after %ld ms, %u of %u parameters written%s\n", (unsigned int)index,
+                          (long)std::chrono::duration_cast<std::chrono::milliseconds>(now - entry.started).count(),
+                          (unsigned int)entry.stale.size(), (unsigned int)entry.steps.size(),
+                          !entry.stale.empty() && m_store.load() ? " and stored" : "");
+                entry.retry_ms = MIN_RETRY_MS;
+            }
+        }
+        change(index, failed ? Offline : Ready);
+    }
+
+}
@@ -0,0 +1,129 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_STARTUP_HPP
+#define MOBSPKR_VEHICLE_CTRL_STARTUP_HPP
+
+#include "motor.hpp"
+#include "bus.hpp"
+#include "poller.hpp"
+
+#include <vector>
+#include <functional>
+#include <mutex>
+
+namespace MobSpkr {
+
+/**
+ * Brings motors up in the background: opens and starts their port, then reads back all axis parameters
+ * of the configuration at once (so it is pipelined through the bus, and ports are configured concurrently)
+ * and writes only those that differ, optionally storing them to the module's EEPROM as well (set_store()),
+ * so a module that kept its configuration (or was restarted with the stored one) is ready after one batch of reads.
+ * A motor whose port cannot be opened or that fails any step is retried with exponential back-off,
+ * meanwhile commands to it are to be refused (see is_ready()). A retry opens the port again unless other motors
+ * on it are fine, so a port that went away (eg an unplugged adapter) is picked up once it is back.
+ */
+class Startup : public Poller {
+
+    public:
+
+        enum State {
+            Offline,
+            Initializing,
+            Ready
+        };
+
+        // an axis parameter (SAP, GAP, STAP) and the value it should have
+        struct Step {
+            const char * name;
+            uint8_t parameter;
+            int32_t value;
+        };
+
+        const static unsigned int MIN_RETRY_MS = 500;
+        const static unsigned int MAX_RETRY_MS = 8000;
+
+        // how often to look for retries due when there are none (eg after re-init())
+        const static unsigned int CHECK_MS = 200;
+
+        // starts a bus that was just opened, on an I/O thread or in an event loop
+        typedef std::function<bool(Bus * bus)> Starter;
+
+        // every change of state, called from whichever thread polls or completes
+        typedef std::function<void(std::size_t index, State state)> Listener;
+
+    protected:
+
+        struct Entry {
+            Motor * motor;
+            std::vector<Step> steps;
+            State state;
+            clock::time_point due;
+            unsigned int retry_ms;
+            // of the current attempt: the parameters found to differ, then those written
+            std::vector<const Step *> stale;
+            unsigned int remaining;
+            bool failed;
+            clock::time_point started;
+            // the last attempt failed, the port is to be opened again
+            bool reopen;
+        };
+
+        Starter m_starter;
+        unsigned int m_timeout_ms;
+        Listener m_listener;
+        std::atomic<bool> m_store{false};
+
+        std::vector<Entry> m_entries;
+        mutable std::mutex m_mutex;
+
+        void begin(std::size_t index, clock::time_point now);
+        void read(std::size_t index, const Step & step, Motor::Response::Status status, int32_t value);
+        void write(std::size_t index);
+        void written(std::size_t index, const Step & step, Motor::Response::Status status);
+        // counts a reply, true for the last one of the batch (with the lock held)
+        bool replied(std::size_t index, const Step & step, const char * what, Motor::Response::Status status);
+        void finish(std::size_t index, bool failed);
+        void change(std::size_t index, State state);
+        // whether another motor on the bus is configured or being configured (with the lock held)
+        bool in_use(const Bus * bus, std::size_t index) const;
+
+    public:
+
+        Startup(unsigned int timeout_ms) : m_timeout_ms(timeout_ms) {}
+        ~Startup(){ stop(); }
+
+        static const char * state_name(State state);
+
+        /**
+         * Motors are to be added before polling starts, in order of their index.
+         */
+        std::size_t add(Motor & motor, std::vector<Step> steps);
+
+        std::size_t size() const { return m_entries.size(); }
+
+        /**
+         * Both to be set before polling starts.
+         */
+        void set_starter(Starter starter){ m_starter = std::move(starter); }
+        void set_listener(Listener listener){ m_listener = std::move(listener); }
+
+        /**
+         * Whether to store parameters written to the module's EEPROM (STAP) as well, which survives a power cycle.
+         */
+        void set_store(bool store){ m_store.store(store); }
+
+        State state(std::size_t index) const;
+        bool is_ready(std::size_t index) const { return state(index) == Ready; }
+
+        /**
+         * Configures the motor again (eg after a power cycle), it is not ready until done.
+         */
+        void reinit(std::size_t index);
+
+        /**
+         * Opens, starts and configures whatever is due, returns when to call again.
+         */
+        clock::time_point poll(clock::time_point now) override;
+};
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_STARTUP_HPP
@@ -0,0 +1,190 @@
+#include "subscriptions.hpp"
+#include "log.hpp"
+
+#include "osc/OscOutboundPacketStream.h"
+
+#include <cstring>
+#include <cmath>
+#include <cstdio>
+
+namespace MobSpkr {
+
+    bool Subscriptions::parse_fields(const char * names, unsigned int & fields) {
+        fields = 0;
+
+        std::string list(names);
+        std::size_t start = 0;
+
+        while(start <= list.size()){
+            std::size_t end = list.find(',', start);
+            if (end == std::string::npos)
+                end = list.size();
+
+            std::string name = list.substr(start, end - start);
+
+            if (name == "all")
+                fields |= ALL;
+            else if (name == "temp")
+                fields |= 1 << Telemetry::Temperature;
+            else if (name == "volt")
+                fields |= 1 << Telemetry::Voltage;
+            else if (name == "pose")
+                fields |= POSE;
+            else {
+                int f = 0;
+                while(f < Telemetry::FIELD_COUNT && name != Telemetry::field_name((Telemetry::Field)f))
+                    f++;
+                if (f == Telemetry::FIELD_COUNT)
+                    return false;
+                fields |= 1 << f;
+            }
+
+            start = end + 1;
+        }
+
+        return fields != 0;
+    }
+
+    bool Subscriptions::subscribe(const char * host, int port, unsigned int fields, float rate_hz, unsigned int lease_ms) {
+        if (!std::isfinite(rate_hz) || rate_hz <= 0 || MAX_RATE_HZ < rate_hz || MAX_LEASE_MS < lease_ms || (fields & ALL) == 0)
+            return false;
+
+        Subscriber subscriber;
+        subscriber.host = host;
+        subscriber.port = port;
+        subscriber.fields = fields & ALL;
+        subscriber.period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<float>(1.0f / rate_hz));
+        subscriber.due = clock::now();
+        subscriber.permanent = lease_ms == 0;
+        subscriber.expires = subscriber.due + std::chrono::milliseconds(lease_ms);
+
+        // resolve once
+        if (!m_replies.resolve(host, port, subscriber.endpoint))
+            return false;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // renewal, possibly with other fields or rate
+        for(Subscriber & s : m_subscribers){
+            if (s.host == subscriber.host && s.port == port){
+                subscriber.due = s.due;
+                s = subscriber;
+                return true;
+            }
+        }
+
+        if (m_subscribers.size() >= MAX_SUBSCRIBERS)
+            return false;
+
+        m_subscribers.push_back(subscriber);
+        return true;
+    }
+
+    bool Subscriptions::unsubscribe(const char * host, int port) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for(std::vector<Subscriber>::iterator it = m_subscribers.begin(); it != m_subscribers.end(); it++){
+            if (it->host == host && it->port == port){
+                m_subscribers.erase(it);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    std::size_t Subscriptions::size() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_subscribers.size();
+    }
+
+    void Subscriptions::publish(const Subscriber & subscriber, clock::time_point now) {
+        // at most, with all fields: size, address, type tags, device name and three ints per message
+        std::size_t name_size = std::strlen(m_device_name) + 4;
+        std::size_t motor_size = Telemetry::FIELD_COUNT * (4 + 24 + 8 + name_size + 12);
+        std::size_t pose_size = 4 + 16 + 8 + name_size + 16;
+
+        // as many motors per bundle as fit for sure, the pose goes with the last
+        std::size_t first = 0;
+        do {
+            std::size_t next = first;
+            bool sent = m_replies.send(subscriber.endpoint, [&](char * buffer, std::size_t size){
+                osc::OutboundPacketStream p( buffer, size );
+
+                p << osc::BeginBundleImmediate;
+
+                for(; next < m_telemetry.size() && p.Size() + motor_size + pose_size <= size; next++){
+                    publish_motor(p, subscriber, next, now);
+                }
+
+                Odometry::Pose pose;
+                if (next == m_telemetry.size() && (subscriber.fields & POSE) && m_odometry && (pose = m_odometry->get_pose()).valid){
+                    int age_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - pose.time).count();
+
+                    p << osc::BeginMessage( "/telemetry/pose" )
+                      << m_device_name << (float)pose.x << (float)pose.y << (float)pose.heading << age_ms
+                      << osc::EndMessage;
+                }
+
+                p << osc::EndBundle;
+
+                return p.Size();
+            });
+
+            // the queue is full (or the device name too long for even a single motor)
+            if (!sent || next == first)
+                break;
+            first = next;
+        } while(first < m_telemetry.size());
+    }
+
+    void Subscriptions::publish_motor(osc::OutboundPacketStream & p, const Subscriber & subscriber, std::size_t index, clock::time_point now) {
+        for(int f = 0; f < Telemetry::FIELD_COUNT; f++){
+            Telemetry::Sample sample;
+            if (!(subscriber.fields & (1 << f)) || !m_telemetry.get(index, (Telemetry::Field)f, sample))
+                continue;
+
+            char address[64];
+            snprintf(address, sizeof(address), "/telemetry/%s", Telemetry::field_name((Telemetry::Field)f));
+
+            int age_ms = std::chrono::duration_cast<std::chrono::milliseconds>(now - sample.time).count();
+
+            p << osc::BeginMessage( address )
+              << m_device_name << (int)index << (int)sample.value << age_ms
+              << osc::EndMessage;
+        }
+    }
+
+    Subscriptions::clock::time_point Subscriptions::poll(clock::time_point now) {
+        // nothing to do, but subscriptions may come in any time
+        clock::time_point next = now + std::chrono::milliseconds(1000 / MAX_RATE_HZ);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        std::vector<Subscriber>::iterator it = m_subscribers.begin();
+        while(it != m_subscribers.end()){
+            if (!it->permanent && it->expires <= now){
+                Log::info("subscription of %s:%d expired\n", it->host.c_str(), it->port);
+                it = m_subscribers.erase(it);
+                continue;
+            }
+
+            if (it->due <= now){
+                publish(*it, now);
+
+                // keep the rate, but don't try to catch up
+                it->due += it->period;
+                if (it->due <= now)
+                    it->due = now + it->period;
+            }
+
+            if (it->due < next)
+                next = it->due;
+
+            it++;
+        }
+
+        return next;
+    }
+
+}
@@ -0,0 +1,101 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_SUBSCRIPTIONS_HPP
+#define MOBSPKR_VEHICLE_CTRL_SUBSCRIPTIONS_HPP
+
+#include "telemetry.hpp"
+#include "odometry.hpp"
+#include "replies.hpp"
+
+#include <string>
+#include <vector>
+
+namespace osc {
+    class OutboundPacketStream;
+}
+
+namespace MobSpkr {
+
+/**
+ * Streams telemetry samples to subscribers, per subscriber and period one OSC bundle (or as many as it takes
+ * for all motors to fit a datagram, see Replies::SLOT_SIZE) with a message
+ *
+ *      /telemetry/<field> <device-name> <motor-index> <value> <age-msec>
+ *
+ * for every motor and subscribed field, and with odometry
+ *
+ *      /telemetry/pose <device-name> <x> <y> <heading> <age-msec>
+ *
+ * Subscriptions expire unless renewed within their lease,
+ * a subscriber may as well be a multicast group shared by several clients.
+ */
+class Subscriptions : public Poller {
+
+    public:
+
+        const static unsigned int DEFAULT_LEASE_MS = 30000;
+        const static unsigned int MAX_LEASE_MS = 24 * 3600 * 1000;
+        const static unsigned int MAX_RATE_HZ = 100;
+        // each one is published to from the event loop
+        const static std::size_t MAX_SUBSCRIBERS = 16;
+
+        // the vehicle's pose, after the telemetry fields
+        const static unsigned int POSE = 1 << Telemetry::FIELD_COUNT;
+
+        // all fields
+        const static unsigned int ALL = (POSE << 1) - 1;
+
+    protected:
+
+        struct Subscriber {
+            std::string host;
+            int port;
+            Replies::Endpoint endpoint;
+            unsigned int fields;
+            clock::duration period;
+            clock::time_point due;
+            // lease, unless permanent
+            bool permanent;
+            clock::time_point expires;
+        };
+
+        Telemetry & m_telemetry;
+        Odometry * m_odometry;
+        Replies & m_replies;
+        const char * m_device_name;
+
+        std::vector<Subscriber> m_subscribers;
+        std::mutex m_mutex;
+
+        void publish(const Subscriber & subscriber, clock::time_point now);
+        void publish_motor(osc::OutboundPacketStream & p, const Subscriber & subscriber, std::size_t index, clock::time_point now);
+
+    public:
+
+        Subscriptions(Telemetry & telemetry, Replies & replies, const char * device_name)
+            : m_telemetry(telemetry), m_odometry(NULL), m_replies(replies), m_device_name(device_name) {}
+        ~Subscriptions(){ stop(); }
+
+        /**
+         * Source of the pose field, none by default.
+         */
+        void set_odometry(Odometry * odometry){ m_odometry = odometry; }
+
+        /**
+         * Comma separated field names (see Telemetry::field_name(), or short temp and volt), "pose" or "all".
+         */
+        static bool parse_fields(const char * names, unsigned int & fields);
+
+        /**
+         * Subscribes or renews, lease_ms 0 is permanent. False if any argument is out of range, the host can't
+         * be resolved or there are MAX_SUBSCRIBERS already.
+         */
+        bool subscribe(const char * host, int port, unsigned int fields, float rate_hz, unsigned int lease_ms = DEFAULT_LEASE_MS);
+        bool unsubscribe(const char * host, int port);
+
+        std::size_t size();
+
+        clock::time_point poll(clock::time_point now) override;
+};
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_SUBSCRIPTIONS_HPP
@@ -0,0 +1,128 @@
+#include "sync.hpp"
+#include "bus.hpp"
+
+#include <algorithm>
+
+namespace MobSpkr {
+
+    static std::atomic<uint32_t> last_group_id{0};
+
+    SyncGroup::SyncGroup() {
+        m_id = ++last_group_id;
+        // never use 0, the bus threads start with it
+        if (m_id == 0)
+            m_id = ++last_group_id;
+
+        m_expected = 0;
+        m_arrived = 0;
+        m_armed = false;
+
+        m_remaining = 0;
+        m_status = Motor::Response::Status::Success;
+        m_sent_count = 0;
+    }
+
+    std::shared_ptr<SyncGroup> SyncGroup::create() {
+        return std::shared_ptr<SyncGroup>(new SyncGroup());
+    }
+
+    void SyncGroup::add(Motor & motor, Motor::Command command, bool setpoint) {
+        Entry entry;
+        entry.motor = &motor;
+        entry.command = command;
+        entry.setpoint = setpoint;
+
+        m_entries.push_back(entry);
+    }
+
+    bool SyncGroup::submit(const std::shared_ptr<SyncGroup> & group, unsigned int timeout_ms, Completion completion) {
+
+        group->m_completion = std::move(completion);
+        group->m_remaining = group->m_entries.size();
+
+        if (group->m_entries.empty()){
+            if (group->m_completion)
+                group->m_completion(Motor::Response::Status::Success, 0);
+            return true;
+        }
+
+        bool queued_all = true;
+        std::vector<Bus*> buses;
+
+        for(Entry & entry : group->m_entries){
+            Motor * motor = entry.motor;
+
+            // setpoints of all motors are taken before anything is sent, so none goes out stale
+            uint32_t generation = entry.setpoint ? motor->next_setpoint_generation() : 0;
+
+            // the callback holds the group until the last reply
+            std::shared_ptr<SyncGroup> self = group;
+            bool queued = motor->enqueue(entry.command, timeout_ms, [self](Motor::Response::Status status, const Motor::Response & response){
+                self->done(status);
+            }, generation, group);
+
+            if (queued){
+                if (std::find(buses.begin(), buses.end(), motor->get_bus()) == buses.end())
+                    buses.push_back(motor->get_bus());
+            } else {
+                queued_all = false;
+                group->done(Motor::Response::Status::Error);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(group->m_mutex);
+            group->m_expected = buses.size();
+            group->m_armed = true;
+        }
+        group->m_released.notify_all();
+
+        return queued_all;
+    }
+
+    void SyncGroup::arrive(unsigned int timeout_ms) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_arrived++;
+
+        if (m_armed && m_arrived >= m_expected){
+            lock.unlock();
+            m_released.notify_all();
+            return;
+        }
+
+        // a bus that has been stopped never arrives, don't hold up the others forever
+        m_released.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]{ return m_armed && m_arrived >= m_expected; });
+    }
+
+    void SyncGroup::sent(clock::time_point time) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_sent_count == 0 || time < m_first_sent)
+            m_first_sent = time;
+        if (m_sent_count == 0 || m_last_sent < time)
+            m_last_sent = time;
+        m_sent_count++;
+    }
+
+    void SyncGroup::done(Motor::Response::Status status) {
+        long skew_us;
+        Motor::Response::Status result;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (status != Motor::Response::Status::Success && m_status == Motor::Response::Status::Success)
+                m_status = status;
+
+            if (--m_remaining > 0)
+                return;
+
+            skew_us = m_sent_count < 2 ? 0 : std::chrono::duration_cast<std::chrono::microseconds>(m_last_sent - m_first_sent).count();
+            result = m_status;
+        }
+
+        if (m_completion)
+            m_completion(result, skew_us);
+    }
+
+}
@@ -0,0 +1,93 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_SYNC_HPP
+#define MOBSPKR_VEHICLE_CTRL_SYNC_HPP
+
+#include "motor.hpp"
+
+#include <vector>
+#include <chrono>
+
+namespace MobSpkr {
+
+/**
+ * Commands for several motors that are to take effect at the same time (eg both wheels starting to turn).
+ *
+ * All commands are queued on their buses up front; each bus thread then holds its command back until
+ * the threads of all other buses involved have picked up theirs (barrier) and sends it right away.
+ * Thus the start skew is down to thread wakeup instead of a round-trip per motor.
+ * Motors on the same (shared) bus are necessarily sent one after the other.
+ */
+class SyncGroup {
+
+    public:
+
+        typedef std::chrono::steady_clock clock;
+
+        /**
+         * Called once every command is answered (or failed), from the bus thread completing the last one.
+         * status is Success or the first failure, skew_us the spread of the send times.
+         */
+        typedef std::function<void(Motor::Response::Status status, long skew_us)> Completion;
+
+    protected:
+
+        struct Entry {
+            Motor * motor;
+            Motor::Command command;
+            bool setpoint;
+        };
+
+        uint32_t m_id;
+        std::vector<Entry> m_entries;
+        Completion m_completion;
+
+        std::mutex m_mutex;
+        std::condition_variable m_released;
+        unsigned int m_expected;
+        unsigned int m_arrived;
+        bool m_armed;
+
+        unsigned int m_remaining;
+        Motor::Response::Status m_status;
+        unsigned int m_sent_count;
+        clock::time_point m_first_sent;
+        clock::time_point m_last_sent;
+
+        SyncGroup();
+
+        void done(Motor::Response::Status status);
+
+    public:
+
+        SyncGroup(const SyncGroup &) = delete;
+        SyncGroup & operator=(const SyncGroup &) = delete;
+
+        static std::shared_ptr<SyncGroup> create();
+
+        /**
+         * Setpoints supersede (and are superseded by) the motor's other setpoints, see Motor::submit_setpoint().
+         */
+        void add(Motor & motor, Motor::Command command, bool setpoint = true);
+
+        std::size_t size() const { return m_entries.size(); }
+
+        /**
+         * Queues all commands (which requires the buses to be running), false if any could not be queued.
+         * Completion is called in any case; a group can only be submitted once.
+         */
+        static bool submit(const std::shared_ptr<SyncGroup> & group, unsigned int timeout_ms, Completion completion);
+
+        // used by the bus threads
+
+        uint32_t id() const { return m_id; }
+
+        /**
+         * Blocks until all buses have arrived, but no longer than timeout_ms.
+         */
+        void arrive(unsigned int timeout_ms);
+
+        void sent(clock::time_point time);
+};
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_SYNC_HPP
@@ -0,0 +1,153 @@
+#include "telemetry.hpp"
+
+#include <cstdio>
+
+namespace MobSpkr {
+
+    static const Motor::Command queries[Telemetry::FIELD_COUNT] = {
+        Motor::Command(PD_1160::Catalogue::GetAxisParam_ActualPosition),
+        Motor::Command(PD_1160::Catalogue::GetAxisParam_ActualSpeed),
+        Motor::Command(PD_1160::Catalogue::GetGIOTemperature),
+        Motor::Command(PD_1160::Catalogue::GetGIOVoltage),
+    };
+
+    Telemetry::Telemetry() {
+        for(int f = 0; f < FIELD_COUNT; f++){
+            m_active_ms[f] = DEFAULT_ACTIVE_MS;
+            m_idle_ms[f] = DEFAULT_IDLE_MS;
+        }
+        // neither changes quickly
+        m_active_ms[Temperature] = DEFAULT_IDLE_MS;
+        m_active_ms[Voltage] = DEFAULT_IDLE_MS;
+    }
+
+    const char * Telemetry::field_name(Field field) {
+        switch(field){
+            case Position:      return "position";
+            case Speed:         return "speed";
+            case Temperature:   return "temperature";
+            case Voltage:       return "voltage";
+            default:            return "?";
+        }
+    }
+
+    std::size_t Telemetry::add(Motor & motor) {
+        Entry entry;
+        entry.motor = &motor;
+        for(int f = 0; f < FIELD_COUNT; f++){
+            entry.pending[f] = false;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.push_back(entry);
+        return m_entries.size() - 1;
+    }
+
+    void Telemetry::set_period(Field field, unsigned int active_ms, unsigned int idle_ms) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_active_ms[field] = active_ms;
+        m_idle_ms[field] = idle_ms;
+    }
+
+    unsigned int Telemetry::period_ms(const Entry & entry, Field field) const {
+        // until known otherwise, assume it is moving
+        const Sample & speed = entry.samples[Speed];
+        bool idle = speed.valid && speed.value == 0;
+
+        return idle ? m_idle_ms[field] : m_active_ms[field];
+    }
+
+    Telemetry::clock::time_point Telemetry::poll(clock::time_point now) {
+        clock::time_point next = now + std::chrono::milliseconds(DEFAULT_IDLE_MS);
+
+        struct Due {
+            std::size_t index;
+            Field field;
+        };
+        std::vector<Due> due;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            for(std::size_t i = 0; i < m_entries.size(); i++){
+                Entry & entry = m_entries[i];
+
+                for(int f = 0; f < FIELD_COUNT; f++){
+                    unsigned int period = period_ms(entry, (Field)f);
+                    if (period == 0)
+                        continue;
+
+                    if (entry.pending[f]){
+                        // the reply will set the next due time
+                        if (now + std::chrono::milliseconds(period) < next)
+                            next = now + std::chrono::milliseconds(period);
+                        continue;
+                    }
+
+                    if (entry.due[f] <= now){
+                        entry.pending[f] = true;
+                        entry.due[f] = now + std::chrono::milliseconds(period);
+                        Due d = {i, (Field)f};
+                        due.push_back(d);
+                    }
+
+                    if (entry.due[f] < next)
+                        next = entry.due[f];
+                }
+            }
+        }
+
+        // submit without holding the lock, the callbacks take it
+        for(Due & d : due){
+            std::size_t index = d.index;
+            Field field = d.field;
+
+            bool queued = m_entries[index].motor->submit_background(queries[field], Motor::ADAPTIVE_TIMEOUT,
+                [this, index, field](Motor::Response::Status status, const Motor::Response & response){
+                    sampled(index, field, status, (int32_t)response.value());
+                });
+
+            if (!queued){
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_entries[index].pending[field] = false;
+            }
+        }
+
+        return next;
+    }
+
+    void Telemetry::sampled(std::size_t index, Field field, Motor::Response::Status status, int32_t value) {
+        Sample sample;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            Entry & entry = m_entries[index];
+            entry.pending[field] = false;
+
+            if (status != Motor::Response::Status::Success)
+                return;
+
+            clock::time_point now = clock::now();
+            entry.samples[field].value = value;
+            entry.samples[field].time = now;
+            entry.samples[field].valid = true;
+            entry.due[field] = now + std::chrono::milliseconds(period_ms(entry, field));
+            sample = entry.samples[field];
+        }
+
+        if (m_listener)
+            m_listener(index, field, sample);
+    }
+
+    bool Telemetry::get(std::size_t index, Field field, Sample & sample) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (index >= m_entries.size() || !m_entries[index].samples[field].valid)
+            return false;
+
+        sample = m_entries[index].samples[field];
+        return true;
+    }
+
+}
@@ -0,0 +1,95 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_TELEMETRY_HPP
+#define MOBSPKR_VEHICLE_CTRL_TELEMETRY_HPP
+
+#include "motor.hpp"
+#include "poller.hpp"
+
+#include <vector>
+#include <functional>
+#include <chrono>
+
+namespace MobSpkr {
+
+/**
+ * Polls position, speed, temperature and voltage of motors in the background (see Motor::submit_background())
+ * and keeps the latest samples, so queries can be answered without a round-trip on the control path.
+ */
+class Telemetry : public Poller {
+
+    public:
+
+        enum Field {
+            Position,
+            Speed,
+            Temperature,
+            Voltage,
+            FIELD_COUNT
+        };
+
+        struct Sample {
+            int32_t value = 0;
+            clock::time_point time;
+            bool valid = false;
+        };
+
+        const static unsigned int DEFAULT_ACTIVE_MS = 100;
+        const static unsigned int DEFAULT_IDLE_MS = 1000;
+
+        // every new sample, eg to integrate positions
+        typedef std::function<void(std::size_t index, Field field, const Sample & sample)> Listener;
+
+    protected:
+
+        struct Entry {
+            Motor * motor;
+            Sample samples[FIELD_COUNT];
+            clock::time_point due[FIELD_COUNT];
+            bool pending[FIELD_COUNT];
+        };
+
+        // sampling periods while the motor turns and while it doesn't, 0 is off
+        unsigned int m_active_ms[FIELD_COUNT];
+        unsigned int m_idle_ms[FIELD_COUNT];
+
+        std::vector<Entry> m_entries;
+        Listener m_listener;
+        mutable std::mutex m_mutex;
+
+        unsigned int period_ms(const Entry & entry, Field field) const;
+        void sampled(std::size_t index, Field field, Motor::Response::Status status, int32_t value);
+
+    public:
+
+        Telemetry();
+        ~Telemetry(){ stop(); }
+
+        static const char * field_name(Field field);
+
+        /**
+         * Motors are to be added before polling starts, the returned index is used for get().
+         */
+        std::size_t add(Motor & motor);
+
+        std::size_t size() const { return m_entries.size(); }
+
+        void set_period(Field field, unsigned int active_ms, unsigned int idle_ms);
+
+        /**
+         * To be set before polling starts, called from whichever thread the reply arrives on.
+         */
+        void set_listener(Listener listener){ m_listener = std::move(listener); }
+
+        /**
+         * Queries whatever is due, returns when to call again.
+         */
+        clock::time_point poll(clock::time_point now) override;
+
+        /**
+         * Latest sample, false if there is none (yet).
+         */
+        bool get(std::size_t index, Field field, Sample & sample) const;
+};
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_TELEMETRY_HPP
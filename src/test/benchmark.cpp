@@ -0,0 +1,442 @@
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <algorithm>
+
+#include "osc/OscReceivedElements.h"
+#include <osc/OscOutboundPacketStream.h>
+
+/**
+ * Drives mobspkr-vehicle-ctrl against simulated motors (tmcl-sim) and reports how many /vehicle/rotate
+ * requests it completes per second and how long each took until the sender was told (/vehicle/skew),
+ * followed by the controller's own per command statistics (/stats). With -J the controller replies once
+ * the first step of the ramp is out, ie after up to one tick.
+ */
+
+#define DEFAULT_MOTORS          2
+#define DEFAULT_DURATION        10
+#define DEFAULT_WINDOW          1
+#define DEFAULT_PORT            9492
+#define DEFAULT_RESPONSE_PORT   9493
+#define DEFAULT_BYTE_US         0
+#define DEFAULT_REPLY_US        1000
+
+#define STARTUP_TIMEOUT_MS      10000
+#define REQUEST_TIMEOUT_MS      1000
+
+typedef std::chrono::steady_clock clock_type;
+
+static char * argv0;
+
+static struct {
+    int motors;
+    int duration;
+    int window;
+    int port;
+    int response_port;
+    int byte_us;
+    int reply_us;
+    bool external;
+    std::string simulator;
+    std::string controller;
+} opts {
+    .motors = DEFAULT_MOTORS,
+    .duration = DEFAULT_DURATION,
+    .window = DEFAULT_WINDOW,
+    .port = DEFAULT_PORT,
+    .response_port = DEFAULT_RESPONSE_PORT,
+    .byte_us = DEFAULT_BYTE_US,
+    .reply_us = DEFAULT_REPLY_US,
+    .external = false
+};
+
+static void print_usage(FILE * f){
+    fprintf(f,
+            "Usage: %s [<options> ...] [-- <controller-options> ...]\n"
+            "Start tmcl-sim and mobspkr-vehicle-ctrl, send /vehicle/rotate requests for a while and report the throughput and latencies\n"
+            "Options:\n"
+            "\t -n, --motors <n>\t Simulated motors, each on a port of its own (default %d)\n"
+            "\t -d, --duration <sec>\t How long to send requests (default %d)\n"
+            "\t -w, --window <n>\t Requests outstanding at a time (default %d)\n"
+            "\t -p, --port <port>\t OSC port of the controller (default %d)\n"
+            "\t -r, --response-port <port>\t Its response port, ie where to receive on (default %d)\n"
+            "\t -b, --byte <usec>\t Simulated transmission time per byte (default %d)\n"
+            "\t -R, --reply <usec>\t Simulated processing time per command (default %d)\n"
+            "\t -s, --simulator <path>\t tmcl-sim executable (default next to this one)\n"
+            "\t -c, --controller <path>\t mobspkr-vehicle-ctrl executable (default next to this one)\n"
+            "\t -x, --external\t Use the controller already running at <port>, start nothing\n"
+            "Examples:\n"
+            "%s -n 4 -w 8 -- -J 20000\n",
+            argv0, DEFAULT_MOTORS, DEFAULT_DURATION, DEFAULT_WINDOW, DEFAULT_PORT, DEFAULT_RESPONSE_PORT, DEFAULT_BYTE_US, DEFAULT_REPLY_US, argv0);
+}
+
+static std::string next_to_argv0(const char * name){
+    std::string path(argv0);
+    std::size_t slash = path.rfind('/');
+    return slash == std::string::npos ? std::string("./") + name : path.substr(0, slash + 1) + name;
+}
+
+// with its output into the given file
+static pid_t spawn(const std::vector<std::string> & args, const std::string & output){
+    pid_t pid = fork();
+    if (pid != 0)
+        return pid;
+
+    int fd = open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0){
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+    }
+
+    std::vector<char *> argv;
+    for(const std::string & arg : args)
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    argv.push_back(NULL);
+
+    execv(argv[0], argv.data());
+    fprintf(stderr, "failed to start %s: %s\n", argv[0], strerror(errno));
+    _exit(EXIT_FAILURE);
+}
+
+static void terminate(pid_t pid){
+    if (pid <= 0)
+        return;
+    kill(pid, SIGINT);
+    waitpid(pid, NULL, 0);
+}
+
+static int open_socket(int port){
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return -1;
+
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr))){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void send_packet(int fd, const osc::OutboundPacketStream & p){
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(opts.port);
+    sendto(fd, p.Data(), p.Size(), 0, (struct sockaddr *)&addr, sizeof(addr));
+}
+
+static void send_stats_request(int fd){
+    char buffer[256];
+    osc::OutboundPacketStream p( buffer, sizeof(buffer) );
+    p << osc::BeginMessage( "/stats" ) << "127.0.0.1" << opts.response_port << osc::EndMessage;
+    send_packet(fd, p);
+}
+
+static void send_ready_request(int fd){
+    char buffer[256];
+    osc::OutboundPacketStream p( buffer, sizeof(buffer) );
+    p << osc::BeginMessage( "/motor/ready" ) << "127.0.0.1" << opts.response_port << osc::EndMessage;
+    send_packet(fd, p);
+}
+
+static void send_rotate(int fd, int velocity){
+    char buffer[256];
+    osc::OutboundPacketStream p( buffer, sizeof(buffer) );
+    p << osc::BeginMessage( "/vehicle/rotate" );
+    for(int i = 0; i < opts.motors; i++)
+        p << velocity;
+    p << osc::EndMessage;
+    send_packet(fd, p);
+}
+
+static void send_stop(int fd){
+    char buffer[64];
+    osc::OutboundPacketStream p( buffer, sizeof(buffer) );
+    p << osc::BeginMessage( "/vehicle/stop" ) << osc::EndMessage;
+    send_packet(fd, p);
+}
+
+typedef void (*Handler)(const osc::ReceivedMessage & m);
+
+static void dispatch(const osc::ReceivedPacket & packet, Handler handler){
+    if (packet.IsBundle()){
+        osc::ReceivedBundle bundle(packet);
+        for(osc::ReceivedBundle::const_iterator it = bundle.ElementsBegin(); it != bundle.ElementsEnd(); it++)
+            dispatch(osc::ReceivedPacket(it->Contents(), it->Size()), handler);
+    } else {
+        handler(osc::ReceivedMessage(packet));
+    }
+}
+
+// receives whatever arrives within timeout_ms, false if nothing did
+static bool receive(int fd, int timeout_ms, Handler handler){
+    struct pollfd pfd = {fd, POLLIN, 0};
+    if (poll(&pfd, 1, timeout_ms) <= 0)
+        return false;
+
+    char buffer[4096];
+    ssize_t n;
+    while((n = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0){
+        try {
+            dispatch(osc::ReceivedPacket(buffer, n), handler);
+        } catch( osc::Exception& e ){
+            fprintf(stderr, "malformed reply: %s\n", e.what());
+        }
+    }
+    return true;
+}
+
+static bool controller_ready;
+static std::deque<clock_type::time_point> outstanding;
+static std::vector<uint32_t> latencies_us;
+static std::vector<uint32_t> skews_us;
+static unsigned long failed = 0;
+static unsigned long lost = 0;
+
+// once all motors are configured
+static void on_ready(const osc::ReceivedMessage & m){
+    if (std::strcmp(m.AddressPattern(), "/ready") != 0)
+        return;
+
+    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+    if (arg == m.ArgumentsEnd())
+        return;
+    int ready = 0;
+    for(arg++; arg != m.ArgumentsEnd(); arg++){
+        if (arg->IsString() && std::strcmp(arg->AsStringUnchecked(), "ready") == 0)
+            ready++;
+    }
+    controller_ready = ready == opts.motors;
+}
+
+// replies come in order, as every request has to wait for the one before on the same ports
+static void on_skew(const osc::ReceivedMessage & m){
+    if (std::strcmp(m.AddressPattern(), "/vehicle/skew") != 0 || outstanding.empty())
+        return;
+
+    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+    arg++;
+    int skew_us = (arg++)->AsInt32();
+    bool ok = (arg++)->AsInt32();
+
+    latencies_us.push_back(std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - outstanding.front()).count());
+    outstanding.pop_front();
+
+    if (ok)
+        skews_us.push_back(skew_us);
+    else
+        failed++;
+}
+
+static void on_stats(const osc::ReceivedMessage & m){
+    osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+    arg++;
+
+    if (std::strcmp(m.AddressPattern(), "/stats/command") == 0){
+        int motor = (arg++)->AsInt32();
+        const char * command = (arg++)->AsString();
+        int values[9];
+        for(int & value : values)
+            value = (arg++)->AsInt32();
+        printf("%5d %-6s %8d %6d %8d %8d %8d %8d %8d %8d %8d\n", motor, command,
+               values[0], values[1], values[2], values[3], values[4], values[5], values[6], values[7], values[8]);
+    } else if (std::strcmp(m.AddressPattern(), "/stats/bus") == 0){
+        const char * port = (arg++)->AsString();
+        long long tx = (arg++)->AsInt64();
+        long long rx = (arg++)->AsInt64();
+        int values[7];
+        for(int & value : values)
+            value = (arg++)->AsInt32();
+        printf("%s: %lld bytes sent, %lld received, %d checksum errors, %d short reads, %d timeouts, %d retries, %d errors, rtt %d us\n",
+               port, tx, rx, values[0], values[1], values[2], values[3], values[4], values[5]);
+    }
+}
+
+static uint32_t percentile(std::vector<uint32_t> & values, double fraction){
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    std::size_t rank = (std::size_t)(fraction * (values.size() - 1) + 0.5);
+    return values[rank];
+}
+
+static int run(int fd){
+    int requests = 0;
+    clock_type::time_point start = clock_type::now();
+    clock_type::time_point end = start + std::chrono::seconds(opts.duration);
+
+    while(clock_type::now() < end){
+        while((int)outstanding.size() < opts.window){
+            // alternating, so every request changes something
+            send_rotate(fd, requests % 2 ? 100 : 200);
+            outstanding.push_back(clock_type::now());
+            requests++;
+        }
+
+        receive(fd, 10, on_skew);
+
+        while(!outstanding.empty() && clock_type::now() - outstanding.front() > std::chrono::milliseconds(REQUEST_TIMEOUT_MS)){
+            outstanding.pop_front();
+            lost++;
+        }
+    }
+
+    // the last ones
+    clock_type::time_point drain = clock_type::now() + std::chrono::milliseconds(REQUEST_TIMEOUT_MS);
+    while(!outstanding.empty() && clock_type::now() < drain)
+        receive(fd, 10, on_skew);
+    lost += outstanding.size();
+    outstanding.clear();
+
+    double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    send_stop(fd);
+
+    // superseded ones (window > 1) fail too, unless ramped (-J)
+    printf("%d requests in %.1f s, %lu completed (%.1f/s), %lu failed, %lu lost\n",
+           requests, elapsed, (unsigned long)latencies_us.size(), latencies_us.size() / elapsed, failed, lost);
+    printf("latency p50 %u us, p90 %u us, p99 %u us, max %u us\n",
+           percentile(latencies_us, 0.5), percentile(latencies_us, 0.9), percentile(latencies_us, 0.99), percentile(latencies_us, 1));
+    printf("skew p50 %u us, max %u us\n", percentile(skews_us, 0.5), percentile(skews_us, 1));
+
+    printf("\nmotor command    count errors wait-p50 wait-p99 resp-p50 resp-p99 totl-p50 totl-p99 totl-max (us)\n");
+    send_stats_request(fd);
+    while(receive(fd, 200, on_stats))
+        ;
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char * argv[]){
+
+    argv0 = argv[0];
+    opts.simulator = next_to_argv0("tmcl-sim");
+    opts.controller = next_to_argv0("mobspkr-vehicle-ctrl");
+
+    int c;
+
+    while (1) {
+        int option_index = 0;
+        static struct option long_options[] = {
+                {"motors", required_argument, 0, 'n'},
+                {"duration", required_argument, 0, 'd'},
+                {"window", required_argument, 0, 'w'},
+                {"port", required_argument, 0, 'p'},
+                {"response-port", required_argument, 0, 'r'},
+                {"byte", required_argument, 0, 'b'},
+                {"reply", required_argument, 0, 'R'},
+                {"simulator", required_argument, 0, 's'},
+                {"controller", required_argument, 0, 'c'},
+                {"external", no_argument, 0, 'x'},
+                {0,         0,                 0,  0 }
+        };
+
+        c = getopt_long(argc, argv, "h?n:d:w:p:r:b:R:s:c:x",
+                        long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'n': opts.motors = std::atoi(optarg); break;
+            case 'd': opts.duration = std::atoi(optarg); break;
+            case 'w': opts.window = std::atoi(optarg); break;
+            case 'p': opts.port = std::atoi(optarg); break;
+            case 'r': opts.response_port = std::atoi(optarg); break;
+            case 'b': opts.byte_us = std::atoi(optarg); break;
+            case 'R': opts.reply_us = std::atoi(optarg); break;
+            case 's': opts.simulator = optarg; break;
+            case 'c': opts.controller = optarg; break;
+            case 'x': opts.external = true; break;
+
+            case 'h':
+            case '?':
+                print_usage(stdout);
+                return EXIT_SUCCESS;
+
+            default:
+                printf("?? getopt returned character code 0%o ??\n", c);
+        }
+    }
+
+    if (opts.motors < 1 || opts.window < 1 || opts.duration < 1){
+        fprintf(stderr, "invalid options. Try %s -h\n", argv0);
+        return EXIT_FAILURE;
+    }
+
+    int fd = open_socket(opts.response_port);
+    if (fd < 0){
+        fprintf(stderr, "failed to listen at port %d: %s\n", opts.response_port, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    pid_t simulator = 0;
+    pid_t controller = 0;
+    std::string log;
+    int result = EXIT_FAILURE;
+
+    if (!opts.external){
+        std::string prefix = "/tmp/mobspkr-bench-" + std::to_string(getpid());
+        std::string link = prefix + "-";
+        log = prefix + ".log";
+
+        simulator = spawn({opts.simulator, "-n", std::to_string(opts.motors), "-l", link,
+                           "-b", std::to_string(opts.byte_us), "-r", std::to_string(opts.reply_us)}, prefix + "-sim.log");
+
+        std::vector<std::string> args = {opts.controller, "-p", std::to_string(opts.port), "-r", std::to_string(opts.response_port)};
+        for(int i = optind; i < argc; i++)
+            args.push_back(argv[i]);
+
+        // the controller would retry missing ports, but only after backing off
+        clock_type::time_point timeout = clock_type::now() + std::chrono::milliseconds(STARTUP_TIMEOUT_MS);
+        for(int i = 0; i < opts.motors; i++){
+            std::string path = link + std::to_string(i);
+            struct stat st;
+            while(lstat(path.c_str(), &st) && clock_type::now() < timeout)
+                usleep(10000);
+            args.push_back(path);
+        }
+
+        controller = spawn(args, log);
+    }
+
+    // answers right away, the motors are configured in the background
+    clock_type::time_point timeout = clock_type::now() + std::chrono::milliseconds(STARTUP_TIMEOUT_MS);
+    while(!controller_ready && clock_type::now() < timeout){
+        send_ready_request(fd);
+        receive(fd, 200, on_ready);
+    }
+    while(receive(fd, 100, on_ready))
+        ;
+
+    if (!controller_ready)
+        fprintf(stderr, "controller (motors) not ready at port %d%s%s\n", opts.port, log.empty() ? "" : ", see ", log.c_str());
+    else
+        result = run(fd);
+
+    terminate(controller);
+    terminate(simulator);
+    close(fd);
+
+    return result;
+}
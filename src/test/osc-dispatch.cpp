@@ -0,0 +1,295 @@
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <vector>
+#include <string>
+
+#include "osc/OscReceivedElements.h"
+#include <osc/OscOutboundPacketStream.h>
+
+#include "router.hpp"
+
+// pattern matching and dispatch checked first, then the dispatch cost per message:
+// strcmp chain (as rpi-osc-stepper used to) vs route table
+
+#define DEFAULT_ITERATIONS 1000000
+
+static const char * addresses[] = {
+        "/motor/init",
+        "/motor/stop",
+        "/motor/reset-position",
+        "/motor/move-by-angle",
+        "/motor/move-to-angle",
+        "/motor/move-to-position",
+        "/motor/rotate",
+        "/vehicle/rotate",
+        "/vehicle/stop",
+        "/motor/msr",
+        "/motor/standby-current",
+        "/motor/temp",
+        "/motor/volt",
+        "/motor/state",
+        "/motor/subscribe",
+        "/motor/unsubscribe",
+};
+static const int ADDRESS_COUNT = sizeof(addresses) / sizeof(addresses[0]);
+
+static volatile long sink = 0;
+
+static char * argv0;
+
+static void print_usage(FILE * f){
+    fprintf(f,
+            "Usage: %s [<iterations>]\n"
+            "Check MobSpkr::Router's pattern matching and dispatch (exits with failure on any mismatch),\n"
+            "then compare OSC dispatch cost of a strcmp chain and the router (default %d iterations)\n"
+            , argv0, DEFAULT_ITERATIONS);
+}
+
+// every address compared, arguments parsed by throwing accessors
+static void chain(const osc::ReceivedMessage & m)
+{
+    try {
+        for(int i = 0; i < ADDRESS_COUNT; i++){
+            if (std::strcmp(m.AddressPattern(), addresses[i]) == 0){
+                osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+                long sum = i;
+                while(arg != m.ArgumentsEnd()){
+                    if (arg->IsString())
+                        sum += (arg++)->AsString()[0];
+                    else
+                        sum += (arg++)->AsInt32();
+                }
+                sink += sum;
+            }
+        }
+    } catch( osc::Exception & e ){
+        sink--;
+    }
+}
+
+static std::vector<char> packet(const char * address, int args)
+{
+    char buffer[256];
+    osc::OutboundPacketStream p( buffer, sizeof(buffer) );
+
+    p << osc::BeginMessage( address );
+    for(int i = 0; i < args; i++)
+        p << i;
+    p << osc::EndMessage;
+
+    return std::vector<char>(p.Data(), p.Data() + p.Size());
+}
+
+// as a single datagram could send them, too costly to be matched
+static const std::string nested_braces = std::string(20000, '{') + std::string(20000, '}');
+static const std::string long_pattern = "/motor/" + std::string(300, '*') + "rotate";
+static std::string repeated(const char * s, int count)
+{
+    std::string r;
+    for(int i = 0; i < count; i++)
+        r += s;
+    return r;
+}
+static const std::string empty_alternatives = repeated("{,}", 80) + "/motor/x";
+
+#define MATCH_CHECK_MAX_US  10000
+
+static const struct {
+    const char * pattern;
+    const char * address;
+    bool matches;
+} match_checks[] = {
+        {"/motor/rotate",               "/motor/rotate",    true},
+        {"/motor/rotate",               "/motor/rotat",     false},
+        {"/motor/rotat",                "/motor/rotate",    false},
+
+        {"/motor/rotat?",               "/motor/rotate",    true},
+        {"/motor/?otate",               "/motor/rotate",    true},
+        {"/motor/rotate?",              "/motor/rotate",    false},
+        {"/motor?rotate",               "/motor/rotate",    false},
+
+        {"/motor/*",                    "/motor/rotate",    true},
+        {"/motor/*e",                   "/motor/rotate",    true},
+        {"/motor/*x",                   "/motor/rotate",    false},
+        {"/motor/r*t*e",                "/motor/rotate",    true},
+        {"/motor/**",                   "/motor/rotate",    true},
+        {"/mo*/ro*",                    "/motor/rotate",    true},
+        {"/*/rotate",                   "/motor/rotate",    true},
+        {"/*",                          "/motor/rotate",    false},
+        {"/motor*",                     "/motor/rotate",    false},
+        {"*",                           "/motor/rotate",    false},
+
+        {"/motor/[r]otate",             "/motor/rotate",    true},
+        {"/motor/[qrs]otate",           "/motor/rotate",    true},
+        {"/motor/[a-z]otate",           "/motor/rotate",    true},
+        {"/motor/[A-Z]otate",           "/motor/rotate",    false},
+        {"/motor/[a-ce-gq-s]otate",     "/motor/rotate",    true},
+        {"/motor/[!a-q]otate",          "/motor/rotate",    true},
+        {"/motor/[!r]otate",            "/motor/rotate",    false},
+        {"/motor/[!q-s]otate",          "/motor/rotate",    false},
+        {"/motor/rotat[a-]",            "/motor/rotate",    false},
+        {"/motor/rotat[a-]",            "/motor/rotat-",    true},
+        {"/motor[/]rotate",             "/motor/rotate",    false},
+        {"/motor/[rotate",              "/motor/rotate",    false},
+
+        {"/motor/{rotate,stop}",        "/motor/rotate",    true},
+        {"/motor/{rotate,stop}",        "/motor/stop",      true},
+        {"/motor/{rotate,stop}",        "/motor/init",      false},
+        {"/motor/{rot,st}ate",          "/motor/rotate",    true},
+        {"/{motor,vehicle}/stop",       "/vehicle/stop",    true},
+        {"/motor/{}rotate",             "/motor/rotate",    true},
+        {"/motor/{,x}rotate",           "/motor/rotate",    true},
+        {"/motor/{rot*,init}",          "/motor/rotate",    true},
+        {"/motor/{r?tate,[s]top}",      "/motor/stop",      true},
+        {"/motor/{ro{t,x}ate,stop}",    "/motor/rotate",    true},
+        {"/motor/{ro{t,x}ate,stop}",    "/motor/roxate",    true},
+        {"/motor/{ro{t,x}ate,stop}",    "/motor/stop",      true},
+        {"/motor/{ro{t,x}ate,stop}",    "/motor/royate",    false},
+        {"/motor/{st{op,art}}",         "/motor/start",     true},
+        {"/motor/{st{op,art}}",         "/motor/st",        false},
+        {"/motor/{rotate,stop",         "/motor/rotate",    false},
+        {"/motor/{r{o{t{ate}}}}",       "/motor/rotate",    true},
+        {"/motor/{r{o{t{a{te}}}}}",     "/motor/rotate",    false},
+        {nested_braces.c_str(),         "/motor/rotate",    false},
+        {long_pattern.c_str(),          "/motor/rotate",    false},
+        {empty_alternatives.c_str(),    "/motor/rotate",    false},
+};
+
+static std::vector<char> string_packet(const char * address, const char * name, int arg)
+{
+    char buffer[256];
+    osc::OutboundPacketStream p( buffer, sizeof(buffer) );
+
+    p << osc::BeginMessage( address ) << name << arg << osc::EndMessage;
+
+    return std::vector<char>(p.Data(), p.Data() + p.Size());
+}
+
+// number of failed checks
+static int check()
+{
+    int failed = 0;
+
+    for(auto & c : match_checks){
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (MobSpkr::Router::match(c.pattern, c.address) != c.matches){
+            fprintf(stderr, "FAILED: %.64s %s %s\n", c.pattern, c.matches ? "should match" : "should not match", c.address);
+            failed++;
+        }
+        long us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        if (us > MATCH_CHECK_MAX_US){
+            fprintf(stderr, "FAILED: %.64s took %ld us to match %s\n", c.pattern, us, c.address);
+            failed++;
+        }
+    }
+
+    // overloads (by argument type) of an address matched by a pattern: the first fitting one, once
+    MobSpkr::Router router;
+    int rotate_int = 0, rotate_int_again = 0, rotate_name = 0, stop = 0, init = 0;
+    router.route<int, int>("/motor/rotate", [&](const IpEndpointName &, int, int){ rotate_int++; });
+    router.route<int, int>("/motor/rotate", [&](const IpEndpointName &, int, int){ rotate_int_again++; });
+    router.route<const char *, int>("/motor/rotate", [&](const IpEndpointName &, const char *, int){ rotate_name++; });
+    router.route<int, int>("/motor/stop", [&](const IpEndpointName &, int, int){ stop++; });
+    router.route<int>("/motor/init", [&](const IpEndpointName &, int){ init++; });
+
+    IpEndpointName from;
+    struct {
+        std::vector<char> packet;
+        MobSpkr::Router::Result result;
+        int rotate_int, rotate_name, stop, init;
+    } dispatches[] = {
+        {packet("/motor/rotate", 2),                    MobSpkr::Router::Dispatched,        1, 0, 0, 0},
+        {string_packet("/motor/rotate", "left", 1),     MobSpkr::Router::Dispatched,        1, 1, 0, 0},
+        {packet("/motor/{rotate,stop,init}", 2),        MobSpkr::Router::Dispatched,        2, 1, 1, 0},
+        {string_packet("/motor/*", "left", 1),          MobSpkr::Router::Dispatched,        2, 2, 1, 0},
+        {packet("/motor/*", 1),                         MobSpkr::Router::Dispatched,        2, 2, 1, 1},
+        {packet("/motor/rotate", 3),                    MobSpkr::Router::InvalidArguments,  2, 2, 1, 1},
+        {packet("/motor/{rotate,stop}", 1),             MobSpkr::Router::InvalidArguments,  2, 2, 1, 1},
+        {packet("/motor/unknown", 2),                   MobSpkr::Router::NoRoute,           2, 2, 1, 1},
+        {packet("/vehicle/*", 2),                       MobSpkr::Router::NoRoute,           2, 2, 1, 1},
+    };
+
+    for(auto & d : dispatches){
+        osc::ReceivedMessage m(osc::ReceivedPacket(d.packet.data(), d.packet.size()));
+        MobSpkr::Router::Result result = router.dispatch(m, from);
+        if (result != d.result || rotate_int != d.rotate_int || rotate_int_again != 0 || rotate_name != d.rotate_name || stop != d.stop || init != d.init){
+            fprintf(stderr, "FAILED: dispatching %s (%d args): result %d, rotate %d/%d/%d, stop %d, init %d\n",
+                    m.AddressPattern(), (int)m.ArgumentCount(), result, rotate_int, rotate_int_again, rotate_name, stop, init);
+            failed++;
+        }
+    }
+
+    return failed;
+}
+
+template<typename F>
+static double measure(const std::vector<osc::ReceivedMessage> & messages, long iterations, F dispatch)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for(long i = 0; i < iterations; i++){
+        dispatch(messages[i % messages.size()]);
+    }
+
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+int main(int argc, char * argv[])
+{
+    argv0 = argv[0];
+
+    long iterations = DEFAULT_ITERATIONS;
+    if (argc > 1){
+        iterations = std::atol(argv[1]);
+        if (iterations < 1){
+            print_usage(stderr);
+            return EXIT_FAILURE;
+        }
+    }
+
+    int failed = check();
+    if (failed > 0){
+        fprintf(stderr, "%d checks failed\n", failed);
+        return EXIT_FAILURE;
+    }
+    printf("pattern matching and dispatch ok (%d patterns)\n", (int)(sizeof(match_checks) / sizeof(match_checks[0])));
+
+    MobSpkr::Router router;
+    for(int i = 0; i < ADDRESS_COUNT; i++){
+        router.route<int, int>(addresses[i], [i](const IpEndpointName &, int a, int b){ sink += i + a + b; });
+    }
+
+    // typical traffic: mostly setpoints
+    std::vector<std::vector<char>> packets;
+    packets.push_back(packet("/motor/rotate", 2));
+    packets.push_back(packet("/motor/rotate", 2));
+    packets.push_back(packet("/motor/move-to-position", 2));
+    packets.push_back(packet("/motor/unsubscribe", 2));
+    packets.push_back(packet("/motor/init", 2));
+    packets.push_back(packet("/unknown", 2));
+
+    std::vector<osc::ReceivedMessage> messages;
+    for(std::vector<char> & p : packets){
+        messages.push_back(osc::ReceivedMessage(osc::ReceivedPacket(p.data(), p.size())));
+    }
+
+    std::vector<char> pattern_packet = packet("/motor/{rotate,stop}", 2);
+    std::vector<osc::ReceivedMessage> patterns;
+    patterns.push_back(osc::ReceivedMessage(osc::ReceivedPacket(pattern_packet.data(), pattern_packet.size())));
+
+    IpEndpointName from;
+
+    double chain_ns = measure(messages, iterations, [](const osc::ReceivedMessage & m){ chain(m); });
+    double router_ns = measure(messages, iterations, [&](const osc::ReceivedMessage & m){ router.dispatch(m, from); });
+    double pattern_ns = measure(patterns, iterations, [&](const osc::ReceivedMessage & m){ router.dispatch(m, from); });
+
+    printf("%d addresses, %ld messages\n", ADDRESS_COUNT, iterations);
+    printf("strcmp chain     %8.1f ns/message\n", chain_ns);
+    printf("router           %8.1f ns/message\n", router_ns);
+    printf("router, pattern  %8.1f ns/message\n", pattern_ns);
+
+    return EXIT_SUCCESS;
+}
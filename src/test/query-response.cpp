@@ -1,33 +1,120 @@
-
 #include <unistd.h>
 #include <getopt.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 #include <cstdlib>
 #include <cstring>
 #include <cerrno>
 #include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <chrono>
+#include <algorithm>
 
 #include "osc/OscReceivedElements.h"
 #include "osc/OscPacketListener.h"
 #include <osc/OscOutboundPacketStream.h>
 #include "ip/UdpSocket.h"
 
+/**
+ * Load generator: replays control patterns against mobspkr-vehicle-ctrl or mobspkr-osc-pwm and measures how long
+ * replies take and how many never arrive, to size how many clients at which rates a controller sustains.
+ *
+ *  - joystick: clients streaming /vehicle/twist (or /pwm) at a fixed rate, answered with /vehicle/skew on the response port
+ *  - health: clients polling /motor/state (or /ping), each answered to the client's own port
+ *  - burst: <count> joystick messages at once every <sec>, for pwm followed by a /ping
+ *
+ * With --mock it instead answers /motor/temp as the controller would (for testing clients).
+ */
 
 #ifndef HOSTNAME
 #define HOSTNAME "unknown"
 #endif
 
 #define DEFAULT_PORT    9292
+#define DEFAULT_PWM_PORT        9393
+#define DEFAULT_RESPONSE_PORT   9393
+#define DEFAULT_DURATION        10
+#define DEFAULT_INDICES         "0,1"
 
 #define MOTOR_COUNT 2
 
+// after which a reply is counted as lost
+#define REPLY_TIMEOUT_MS        1000
+
+// status of /vehicle/skew for setpoints dropped in favour of newer ones (MobSpkr::Motor::Response::Status)
+#define STATUS_SUPERSEDED       1001
+
+
+typedef std::chrono::steady_clock clock_type;
 
 static char * argv0;
 
+enum Pattern {
+    Joystick,
+    Health,
+    Burst,
+    PATTERN_COUNT
+};
+
+static const char * pattern_names[PATTERN_COUNT] = {
+    "joystick",
+    "health",
+    "burst",
+};
+
+static struct {
+    bool pwm;
+    const char * host;
+    int port;
+    int response_port;
+    const char * reply_host;
+    std::vector<int> indices;
+    int clients[PATTERN_COUNT];
+    float rate_hz[PATTERN_COUNT];
+    int burst_count;
+    int duration;
+    bool mock;
+} opts {
+    .pwm = false,
+    .host = "127.0.0.1",
+    .port = 0,
+    .response_port = DEFAULT_RESPONSE_PORT,
+    .reply_host = "127.0.0.1",
+    .indices = {},
+    .clients = {0, 0, 0},
+    .rate_hz = {0, 0, 0},
+    .burst_count = 0,
+    .duration = DEFAULT_DURATION,
+    .mock = false
+};
+
 
 static void print_usage(FILE * f){
     fprintf(f,
-            "Usage: %s\n"
-            , argv0);
+            "Usage: %s [<options> ...]\n"
+            "Send control patterns to mobspkr-vehicle-ctrl (or mobspkr-osc-pwm) and report reply latencies and losses\n"
+            "Options:\n"
+            "\t -t, --target <vehicle|pwm>\t What is running at <host> (default vehicle)\n"
+            "\t -H, --host <addr>\t Where to send to (default 127.0.0.1)\n"
+            "\t -p, --port <port>\t Its OSC port (default %d, pwm %d)\n"
+            "\t -r, --response-port <port>\t Its response port, ie where /vehicle/skew arrives (default %d)\n"
+            "\t -a, --reply-host <addr>\t Where to have replies sent to (default 127.0.0.1)\n"
+            "\t -i, --indices <i>,<j>,..\t Motor indices (pwm: GPIOs) to address (default %s)\n"
+            "\t -j, --joystick <clients>:<rate-hz>\t Stream /vehicle/twist (pwm: /pwm to all indices)\n"
+            "\t -q, --health <clients>:<rate-hz>\t Poll /motor/state of the indices in turn (pwm: /ping)\n"
+            "\t -b, --burst <count>:<every-sec>\t Send <count> joystick messages at once (pwm: then a /ping)\n"
+            "\t -d, --duration <sec>\t How long to send (default %d)\n"
+            "\t -M, --mock\t Answer /motor/temp at port %d instead, as the controller would\n"
+            "Examples:\n"
+            "%s -j 4:50 -q 2:5 -b 20:1\n"
+            "%s -t pwm -H raspberrypi.local -i 23,24 -j 2:100 -q 1:10\n"
+            , argv0, DEFAULT_PORT, DEFAULT_PWM_PORT, DEFAULT_RESPONSE_PORT, DEFAULT_INDICES, DEFAULT_DURATION, DEFAULT_PORT, argv0, argv0);
 }
 
 
@@ -92,10 +179,312 @@ protected:
     }
 };
 
-int main(int argc, char * argv[]) {
-    argv0 = argv[0];
+struct Pending {
+    Pattern pattern;
+    clock_type::time_point sent;
+};
+
+struct Stats {
+    unsigned long sent;
+    unsigned long expected;
+    unsigned long replied;
+    // superseded by a newer setpoint before it was sent to the motors
+    unsigned long coalesced;
+    // timed out or rejected by the motors
+    unsigned long failed;
+    unsigned long lost;
+    std::vector<uint32_t> latencies_us;
+};
+
+struct Client {
+    Pattern pattern;
+    int fd;
+    int port;
+    clock_type::duration period;
+    clock_type::time_point next;
+    unsigned long count;
+    // replies to the client's own port come in order
+    std::deque<Pending> pending;
+};
+
+static Stats stats[PATTERN_COUNT];
+static std::vector<Client> clients;
+
+// /vehicle/skew all arrive at the response port, in order of the requests as they share the motors
+static int response_fd = -1;
+static std::deque<Pending> skew_pending;
+
+static std::map<int, Pending> pings;
+static int next_ping = 0;
+
+static struct sockaddr_in target;
+
+static bool parse_pair(const char * arg, int & count, float & value){
+    char * end;
+    count = std::strtol(arg, &end, 10);
+    if (*end != ':' || count < 1)
+        return false;
+    value = std::strtof(end + 1, &end);
+    return *end == '\0' && value > 0;
+}
+
+static bool parse_indices(const char * arg, std::vector<int> & indices){
+    indices.clear();
+    while(*arg){
+        char * end;
+        indices.push_back(std::strtol(arg, &end, 10));
+        if (end == arg || (*end != ',' && *end != '\0'))
+            return false;
+        arg = *end ? end + 1 : end;
+    }
+    return !indices.empty();
+}
+
+static int open_socket(int port){
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return -1;
+
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    socklen_t length = sizeof(addr);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || getsockname(fd, (struct sockaddr *)&addr, &length)){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int local_port(int fd){
+    struct sockaddr_in addr;
+    socklen_t length = sizeof(addr);
+    getsockname(fd, (struct sockaddr *)&addr, &length);
+    return ntohs(addr.sin_port);
+}
+
+static void send_packet(int fd, const osc::OutboundPacketStream & p){
+    sendto(fd, p.Data(), p.Size(), 0, (struct sockaddr *)&target, sizeof(target));
+}
+
+static void send_ping(Client & client, Pattern pattern){
+    int id = next_ping++;
+    char buffer[256];
+    osc::OutboundPacketStream p( buffer, sizeof(buffer) );
+    p << osc::BeginMessage( "/ping" ) << opts.reply_host << client.port << id << osc::EndMessage;
+    send_packet(client.fd, p);
+
+    Pending pending = {pattern, clock_type::now()};
+    pings[id] = pending;
+    stats[pattern].expected++;
+}
+
+// a smooth figure, so consecutive messages differ
+static void send_joystick(Client & client, Pattern pattern){
+    float t = std::chrono::duration<float>(clock_type::now().time_since_epoch()).count();
+    char buffer[256];
+    osc::OutboundPacketStream p( buffer, sizeof(buffer) );
+
+    if (opts.pwm){
+        p << osc::BeginBundleImmediate;
+        for(std::size_t i = 0; i < opts.indices.size(); i++){
+            p << osc::BeginMessage( "/pwm" ) << opts.indices[i] << (float)(0.5 + 0.5 * std::sin(t + i)) << osc::EndMessage;
+        }
+        p << osc::EndBundle;
+        send_packet(client.fd, p);
+    } else {
+        p << osc::BeginMessage( "/vehicle/twist" ) << (float)(0.5 * std::sin(t)) << (float)(0.5 * std::cos(t)) << osc::EndMessage;
+        send_packet(client.fd, p);
+
+        Pending pending = {pattern, clock_type::now()};
+        skew_pending.push_back(pending);
+        stats[pattern].expected++;
+    }
+    stats[pattern].sent++;
+}
+
+static void send_health(Client & client){
+    stats[Health].sent++;
+
+    if (opts.pwm){
+        send_ping(client, Health);
+        return;
+    }
+
+    int motor = opts.indices[client.count % opts.indices.size()];
+    char buffer[256];
+    osc::OutboundPacketStream p( buffer, sizeof(buffer) );
+    p << osc::BeginMessage( "/motor/state" ) << motor << opts.reply_host << client.port << osc::EndMessage;
+    send_packet(client.fd, p);
+
+    Pending pending = {Health, clock_type::now()};
+    client.pending.push_back(pending);
+    stats[Health].expected++;
+}
+
+static void send(Client & client){
+    switch(client.pattern){
+        case Joystick:
+            send_joystick(client, Joystick);
+            break;
+        case Health:
+            send_health(client);
+            break;
+        case Burst:
+            for(int i = 0; i < opts.burst_count; i++)
+                send_joystick(client, Burst);
+            // tells when all of it has been handled
+            if (opts.pwm)
+                send_ping(client, Burst);
+            break;
+        default:
+            break;
+    }
+    client.count++;
+}
+
+static void replied(const Pending & pending, bool ok, int status = 0){
+    Stats & s = stats[pending.pattern];
+    s.replied++;
+    if (!ok){
+        if (status == STATUS_SUPERSEDED)
+            s.coalesced++;
+        else
+            s.failed++;
+        return;
+    }
+    s.latencies_us.push_back(std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - pending.sent).count());
+}
+
+static void on_reply(Client * client, const osc::ReceivedMessage & m){
+    const char * address = m.AddressPattern();
+
+    if (std::strcmp(address, "/vehicle/skew") == 0){
+        if (skew_pending.empty())
+            return;
+        osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+        arg++;
+        arg++;
+        bool ok = (arg++)->AsInt32();
+        // older controllers don't tell
+        int status = arg != m.ArgumentsEnd() ? (arg++)->AsInt32() : 0;
+        replied(skew_pending.front(), ok, status);
+        skew_pending.pop_front();
+    } else if (std::strcmp(address, "/pong") == 0){
+        osc::ReceivedMessage::const_iterator arg = m.ArgumentsBegin();
+        arg++;
+        std::map<int, Pending>::iterator it = pings.find((arg++)->AsInt32());
+        if (it == pings.end())
+            return;
+        replied(it->second, true);
+        pings.erase(it);
+    } else if (std::strcmp(address, "/state") == 0){
+        if (client == NULL || client->pending.empty())
+            return;
+        replied(client->pending.front(), true);
+        client->pending.pop_front();
+    }
+}
+
+static void dispatch(Client * client, const osc::ReceivedPacket & packet){
+    if (packet.IsBundle()){
+        osc::ReceivedBundle bundle(packet);
+        for(osc::ReceivedBundle::const_iterator it = bundle.ElementsBegin(); it != bundle.ElementsEnd(); it++)
+            dispatch(client, osc::ReceivedPacket(it->Contents(), it->Size()));
+    } else {
+        on_reply(client, osc::ReceivedMessage(packet));
+    }
+}
+
+static void receive(int fd, Client * client){
+    char buffer[4096];
+    ssize_t n;
+    while((n = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0){
+        try {
+            dispatch(client, osc::ReceivedPacket(buffer, n));
+        } catch( osc::Exception& e ){
+            fprintf(stderr, "malformed reply: %s\n", e.what());
+        }
+    }
+}
+
+// waits for replies at most until the given time
+static void receive_until(clock_type::time_point until){
+    std::vector<struct pollfd> fds;
+    for(Client & client : clients){
+        struct pollfd pfd = {client.fd, POLLIN, 0};
+        fds.push_back(pfd);
+    }
+    if (response_fd >= 0){
+        struct pollfd pfd = {response_fd, POLLIN, 0};
+        fds.push_back(pfd);
+    }
 
+    int timeout_ms = std::chrono::duration_cast<std::chrono::milliseconds>(until - clock_type::now()).count();
+    if (poll(fds.data(), fds.size(), timeout_ms < 0 ? 0 : timeout_ms) <= 0)
+        return;
 
+    for(std::size_t i = 0; i < clients.size(); i++){
+        if (fds[i].revents & POLLIN)
+            receive(clients[i].fd, &clients[i]);
+    }
+    if (response_fd >= 0 && (fds.back().revents & POLLIN))
+        receive(response_fd, NULL);
+}
+
+static void expire(std::deque<Pending> & pending, clock_type::time_point before){
+    while(!pending.empty() && pending.front().sent < before){
+        stats[pending.front().pattern].lost++;
+        pending.pop_front();
+    }
+}
+
+static void expire_all(clock_type::time_point before){
+    expire(skew_pending, before);
+    for(Client & client : clients)
+        expire(client.pending, before);
+    for(std::map<int, Pending>::iterator it = pings.begin(); it != pings.end(); ){
+        if (it->second.sent < before){
+            stats[it->second.pattern].lost++;
+            it = pings.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+static bool is_waiting(){
+    if (!skew_pending.empty() || !pings.empty())
+        return true;
+    for(Client & client : clients){
+        if (!client.pending.empty())
+            return true;
+    }
+    return false;
+}
+
+static uint32_t percentile(std::vector<uint32_t> & values, double fraction){
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    return values[(std::size_t)(fraction * (values.size() - 1) + 0.5)];
+}
+
+static void report(double elapsed){
+    printf("%-9s %7s %8s %8s %8s %9s %8s %8s %8s %8s %8s %8s\n", "pattern", "clients", "sent/s", "sent", "replies", "coalesced", "failed", "lost", "p50-us", "p90-us", "p99-us", "max-us");
+    for(int i = 0; i < PATTERN_COUNT; i++){
+        Stats & s = stats[i];
+        if (opts.clients[i] == 0)
+            continue;
+        printf("%-9s %7d %8.1f %8lu %8lu %9lu %8lu %7.1f%% %8u %8u %8u %8u\n", pattern_names[i], opts.clients[i], s.sent / elapsed, s.sent, s.replied, s.coalesced, s.failed,
+               s.expected ? 100.0 * s.lost / s.expected : 0.0,
+               percentile(s.latencies_us, 0.5), percentile(s.latencies_us, 0.9), percentile(s.latencies_us, 0.99), percentile(s.latencies_us, 1));
+    }
+}
+
+static int run_mock(){
     // initialize before motor opening
     packet_listener listener;
     UdpListeningReceiveSocket osc_rx_socket(IpEndpointName( IpEndpointName::ANY_ADDRESS, DEFAULT_PORT ),&listener );
@@ -107,4 +496,182 @@ int main(int argc, char * argv[]) {
     osc_rx_socket.RunUntilSigInt();
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
+
+int main(int argc, char * argv[]) {
+    argv0 = argv[0];
+
+    parse_indices(DEFAULT_INDICES, opts.indices);
+
+    int c;
+
+    while (1) {
+        int option_index = 0;
+        static struct option long_options[] = {
+                {"target", required_argument, 0, 't'},
+                {"host", required_argument, 0, 'H'},
+                {"port", required_argument, 0, 'p'},
+                {"response-port", required_argument, 0, 'r'},
+                {"reply-host", required_argument, 0, 'a'},
+                {"indices", required_argument, 0, 'i'},
+                {"joystick", required_argument, 0, 'j'},
+                {"health", required_argument, 0, 'q'},
+                {"burst", required_argument, 0, 'b'},
+                {"duration", required_argument, 0, 'd'},
+                {"mock", no_argument, 0, 'M'},
+                {0,         0,                 0,  0 }
+        };
+
+        c = getopt_long(argc, argv, "h?t:H:p:r:a:i:j:q:b:d:M",
+                        long_options, &option_index);
+        if (c == -1)
+            break;
+
+        float every;
+
+        switch (c) {
+            case 't':
+                if (std::strcmp(optarg, "pwm") == 0)
+                    opts.pwm = true;
+                else if (std::strcmp(optarg, "vehicle") != 0){
+                    fprintf(stderr, "invalid target: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'H': opts.host = optarg; break;
+            case 'p': opts.port = std::atoi(optarg); break;
+            case 'r': opts.response_port = std::atoi(optarg); break;
+            case 'a': opts.reply_host = optarg; break;
+            case 'd': opts.duration = std::atoi(optarg); break;
+            case 'M': opts.mock = true; break;
+
+            case 'i':
+                if (!parse_indices(optarg, opts.indices)){
+                    fprintf(stderr, "invalid indices: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'j':
+                if (!parse_pair(optarg, opts.clients[Joystick], opts.rate_hz[Joystick])){
+                    fprintf(stderr, "invalid joystick clients and rate: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'q':
+                if (!parse_pair(optarg, opts.clients[Health], opts.rate_hz[Health])){
+                    fprintf(stderr, "invalid health clients and rate: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'b':
+                if (!parse_pair(optarg, opts.burst_count, every)){
+                    fprintf(stderr, "invalid burst: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                opts.clients[Burst] = 1;
+                opts.rate_hz[Burst] = 1 / every;
+                break;
+
+            case 'h':
+            case '?':
+                print_usage(stdout);
+                return EXIT_SUCCESS;
+
+            default:
+                printf("?? getopt returned character code 0%o ??\n", c);
+        }
+    }
+
+    if (opts.mock)
+        return run_mock();
+
+    if (opts.port == 0)
+        opts.port = opts.pwm ? DEFAULT_PWM_PORT : DEFAULT_PORT;
+
+    if (opts.clients[Joystick] == 0 && opts.clients[Health] == 0 && opts.clients[Burst] == 0){
+        opts.clients[Joystick] = 1;
+        opts.rate_hz[Joystick] = 50;
+        opts.clients[Health] = 1;
+        opts.rate_hz[Health] = 2;
+    }
+
+    std::memset(&target, 0, sizeof(target));
+    target.sin_family = AF_INET;
+    target.sin_port = htons(opts.port);
+    if (inet_pton(AF_INET, opts.host, &target.sin_addr) != 1){
+        fprintf(stderr, "invalid host (IPv4 address): %s\n", opts.host);
+        return EXIT_FAILURE;
+    }
+
+    if (!opts.pwm){
+        response_fd = open_socket(opts.response_port);
+        if (response_fd < 0){
+            fprintf(stderr, "failed to listen at port %d: %s\n", opts.response_port, strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+
+    clock_type::time_point start = clock_type::now();
+
+    for(int pattern = 0; pattern < PATTERN_COUNT; pattern++){
+        for(int i = 0; i < opts.clients[pattern]; i++){
+            Client client;
+            client.pattern = (Pattern)pattern;
+            client.fd = open_socket(0);
+            if (client.fd < 0){
+                fprintf(stderr, "failed to open socket: %s\n", strerror(errno));
+                return EXIT_FAILURE;
+            }
+            client.port = local_port(client.fd);
+            client.period = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(1 / opts.rate_hz[pattern]));
+            // spread out over the first period, as independent clients would be
+            client.next = start + client.period * i / opts.clients[pattern];
+            client.count = 0;
+            clients.push_back(client);
+        }
+    }
+
+    printf("sending to %s:%d for %d s\n", opts.host, opts.port, opts.duration);
+
+    clock_type::time_point end = start + std::chrono::seconds(opts.duration);
+
+    while(clock_type::now() < end){
+        clock_type::time_point now = clock_type::now();
+        clock_type::time_point next = end;
+
+        for(Client & client : clients){
+            if (client.next <= now){
+                send(client);
+                // a fixed rate, unless too late to catch up
+                client.next += client.period;
+                if (client.next < now)
+                    client.next = now + client.period;
+            }
+            if (client.next < next)
+                next = client.next;
+        }
+
+        receive_until(next);
+        expire_all(clock_type::now() - std::chrono::milliseconds(REPLY_TIMEOUT_MS));
+    }
+
+    double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    clock_type::time_point drain = clock_type::now() + std::chrono::milliseconds(REPLY_TIMEOUT_MS);
+    while(is_waiting() && clock_type::now() < drain)
+        receive_until(drain);
+    expire_all(drain);
+
+    report(elapsed);
+
+    for(Client & client : clients)
+        close(client.fd);
+    if (response_fd >= 0)
+        close(response_fd);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,110 @@
+#ifndef MOBSPKR_VEHICLE_CTRL_TMCL_HPP
+#define MOBSPKR_VEHICLE_CTRL_TMCL_HPP
+
+#include <cstdint>
+
+namespace MobSpkr {
+
+/**
+ * Compile-time encoding of TMCL instructions (Trinamic Motion Control Language).
+ *
+ * A command frame is: address, opcode, type, motor/bank, value (4 bytes, MSB first), checksum
+ * where the checksum is the sum of the first eight bytes.
+ */
+namespace TMCL {
+
+    const static int FRAME_SIZE = 9;
+
+    const static uint8_t DEFAULT_ADDRESS = 1;
+
+    enum Opcode : uint8_t {
+        ROR         = 1,    // rotate right
+        ROL         = 2,    // rotate left
+        MST         = 3,    // motor stop
+        MVP         = 4,    // move to position
+        SAP         = 5,    // set axis parameter
+        GAP         = 6,    // get axis parameter
+        STAP        = 7,    // store axis parameter (EEPROM)
+        RSAP        = 8,    // restore axis parameter (EEPROM)
+        SGP         = 9,    // set global parameter
+        GGP         = 10,   // get global parameter
+        STGP        = 11,   // store global parameter (EEPROM)
+        RSGP        = 12,   // restore global parameter (EEPROM)
+        RFS         = 13,   // reference search
+        SIO         = 14,   // set output
+        GIO         = 15,   // get input
+        SCO         = 30,   // set coordinate
+        GCO         = 31,   // get coordinate
+        CCO         = 32,   // capture coordinate
+        GetVersion  = 136,
+    };
+
+    /**
+     * Instructions that only read, and thus may be repeated safely.
+     */
+    constexpr bool is_query(uint8_t opcode){
+        return opcode == GAP || opcode == GGP || opcode == GIO || opcode == GCO || opcode == GetVersion;
+    }
+
+    struct Frame {
+        uint8_t bytes[FRAME_SIZE];
+
+        constexpr uint8_t operator[](int i) const { return bytes[i]; }
+    };
+
+    constexpr uint8_t value_byte(uint32_t value, int i){
+        return (value >> (24 - 8 * i)) & 0xff;
+    }
+
+    constexpr uint8_t checksum(uint8_t address, uint8_t opcode, uint8_t type, uint8_t bank, uint32_t value){
+        return (uint8_t)(address + opcode + type + bank
+                        + value_byte(value, 0) + value_byte(value, 1) + value_byte(value, 2) + value_byte(value, 3));
+    }
+
+    constexpr Frame encode(uint8_t address, uint8_t opcode, uint8_t type, uint8_t bank, uint32_t value){
+        return Frame{{
+            address, opcode, type, bank,
+            value_byte(value, 0), value_byte(value, 1), value_byte(value, 2), value_byte(value, 3),
+            checksum(address, opcode, type, bank, value)
+        }};
+    }
+
+    constexpr bool equal(const Frame & frame, const uint8_t (&bytes)[FRAME_SIZE]){
+        for(int i = 0; i < FRAME_SIZE; i++){
+            if (frame[i] != bytes[i])
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * An instruction with everything but the value (and possibly the address) fixed at compile time.
+     */
+    template<uint8_t Opcode, uint8_t Type = 0, uint8_t Bank = 0>
+    struct Instruction {
+        constexpr static uint8_t opcode = Opcode;
+        constexpr static uint8_t type = Type;
+        constexpr static uint8_t bank = Bank;
+
+        constexpr static Frame frame(uint32_t value = 0, uint8_t address = DEFAULT_ADDRESS){
+            return encode(address, Opcode, Type, Bank, value);
+        }
+    };
+
+    template<uint8_t Param, uint8_t Motor = 0> using SetAxisParam = Instruction<SAP, Param, Motor>;
+    template<uint8_t Param, uint8_t Motor = 0> using GetAxisParam = Instruction<GAP, Param, Motor>;
+    template<uint8_t Param, uint8_t Motor = 0> using StoreAxisParam = Instruction<STAP, Param, Motor>;
+    template<uint8_t Param, uint8_t Motor = 0> using RestoreAxisParam = Instruction<RSAP, Param, Motor>;
+
+    template<uint8_t Param, uint8_t Bank = 0> using SetGlobalParam = Instruction<SGP, Param, Bank>;
+    template<uint8_t Param, uint8_t Bank = 0> using GetGlobalParam = Instruction<GGP, Param, Bank>;
+    template<uint8_t Param, uint8_t Bank = 0> using StoreGlobalParam = Instruction<STGP, Param, Bank>;
+    template<uint8_t Param, uint8_t Bank = 0> using RestoreGlobalParam = Instruction<RSGP, Param, Bank>;
+
+    template<uint8_t Port, uint8_t Bank> using GetInput = Instruction<GIO, Port, Bank>;
+    template<uint8_t Port, uint8_t Bank> using SetOutput = Instruction<SIO, Port, Bank>;
+}
+
+}
+
+#endif //MOBSPKR_VEHICLE_CTRL_TMCL_HPP
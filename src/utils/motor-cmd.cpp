@@ -40,7 +40,7 @@ int main(int argc, char * argv[]){
 
     MobSpkr::Motor motor(NULL, 1);
 
-    unsigned int timeout_ms = 1000;
+    unsigned int timeout_ms = MobSpkr::Motor::ADAPTIVE_TIMEOUT;
 
     int c;
     int digit_optind = 0;
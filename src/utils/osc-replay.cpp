@@ -0,0 +1,191 @@
+#include "../recorder.hpp"
+
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <thread>
+
+#define DEFAULT_HOST    "127.0.0.1"
+#define DEFAULT_PORT    9292
+#define DEFAULT_SPEED   1.0
+
+typedef std::chrono::steady_clock clock_type;
+
+static char * argv0;
+
+static struct {
+    const char * host;
+    int port;
+    double speed;
+    int loops;
+    bool list;
+} opts {
+    .host = DEFAULT_HOST,
+    .port = DEFAULT_PORT,
+    .speed = DEFAULT_SPEED,
+    .loops = 1,
+    .list = false
+};
+
+static void print_usage(FILE * out){
+    fprintf(out,
+            "Usage: %s [<options> ...] <log>\n"
+            "Re-send the datagrams of a log recorded with -R (mobspkr-vehicle-ctrl, mobspkr-osc-pwm)\n"
+            "Options:\n"
+            "\t -H, --host <addr>\t Where to send to (default %s)\n"
+            "\t -p, --port <port>\t Port to send to (default %d)\n"
+            "\t -s, --speed <factor>\t 1 as recorded, 2 twice as fast, .. 0 as fast as possible (default %g)\n"
+            "\t -n, --loops <n>\t Replay <n> times (default 1)\n"
+            "\t -l, --list\t Print the datagrams instead of sending them\n"
+            "Examples:\n"
+            "%s -s 0 -n 10 show.osclog\n",
+            argv0, DEFAULT_HOST, DEFAULT_PORT, DEFAULT_SPEED, argv0);
+}
+
+static void list(MobSpkr::Recording & recording){
+    const MobSpkr::Recorder::Record * record;
+    const char * data;
+
+    time_t started = recording.header().started_unix_ns / 1000000000;
+    printf("recorded %s", ctime(&started));
+
+    while(recording.next(record, data)){
+        struct in_addr address;
+        address.s_addr = htonl(record->address);
+
+        // the address pattern, or #bundle
+        int length = strnlen(data, record->size);
+        printf("%12.6f %15s:%-5u %6u %.*s\n", record->time_ns / 1e9, inet_ntoa(address), record->port, record->size, length, data);
+    }
+}
+
+int main(int argc, char * argv[]){
+
+    argv0 = argv[0];
+
+    int c;
+
+    while (1) {
+        int option_index = 0;
+        static struct option long_options[] = {
+                {"host", required_argument, 0, 'H'},
+                {"port", required_argument, 0, 'p'},
+                {"speed", required_argument, 0, 's'},
+                {"loops", required_argument, 0, 'n'},
+                {"list", no_argument, 0, 'l'},
+                {0,         0,                 0,  0 }
+        };
+
+        c = getopt_long(argc, argv, "h?H:p:s:n:l",
+                        long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 'H': opts.host = optarg; break;
+            case 'p': opts.port = std::atoi(optarg); break;
+            case 'n': opts.loops = std::atoi(optarg); break;
+            case 'l': opts.list = true; break;
+
+            case 's':
+                opts.speed = std::atof(optarg);
+                if (opts.speed < 0){
+                    fprintf(stderr, "invalid speed: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'h':
+            case '?':
+                print_usage(stdout);
+                return EXIT_SUCCESS;
+
+            default:
+                printf("?? getopt returned character code 0%o ??\n", c);
+        }
+    }
+
+    if (optind != argc - 1){
+        fprintf(stderr, "Missing log. Try %s -h\n", argv0);
+        return EXIT_FAILURE;
+    }
+
+    MobSpkr::Recording recording;
+    if (!recording.open(argv[optind])){
+        fprintf(stderr, "failed to read %s (no log?)\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    if (opts.list){
+        list(recording);
+        return EXIT_SUCCESS;
+    }
+
+    struct sockaddr_in to;
+    std::memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(opts.port);
+    if (inet_pton(AF_INET, opts.host, &to.sin_addr) != 1){
+        fprintf(stderr, "invalid host (IPv4 address): %s\n", opts.host);
+        return EXIT_FAILURE;
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0){
+        perror("socket");
+        return EXIT_FAILURE;
+    }
+
+    unsigned long count = 0;
+    unsigned long failed = 0;
+    unsigned long long bytes = 0;
+    clock_type::duration max_late(0);
+    clock_type::time_point start = clock_type::now();
+
+    for(int loop = 0; loop < opts.loops; loop++){
+        const MobSpkr::Recorder::Record * record;
+        const char * data;
+        clock_type::time_point loop_start = clock_type::now();
+
+        recording.rewind();
+        while(recording.next(record, data)){
+            if (opts.speed > 0){
+                clock_type::time_point due = loop_start + std::chrono::duration_cast<clock_type::duration>(std::chrono::nanoseconds(record->time_ns) / opts.speed);
+                std::this_thread::sleep_until(due);
+
+                clock_type::duration late = clock_type::now() - due;
+                if (late > max_late)
+                    max_late = late;
+            }
+
+            if (sendto(fd, data, record->size, 0, (struct sockaddr *)&to, sizeof(to)) < 0){
+                // as fast as possible the socket buffer may fill up
+                if (errno == ENOBUFS || errno == EAGAIN){
+                    std::this_thread::yield();
+                    failed++;
+                    continue;
+                }
+                perror("sendto");
+                close(fd);
+                return EXIT_FAILURE;
+            }
+            count++;
+            bytes += record->size;
+        }
+    }
+
+    double elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+    printf("%lu datagrams (%llu bytes) in %.3f s, %.0f/s, %lu failed", count, bytes, elapsed, elapsed > 0 ? count / elapsed : 0.0, failed);
+    if (opts.speed > 0)
+        printf(", at most %ld us late", (long)std::chrono::duration_cast<std::chrono::microseconds>(max_late).count());
+    printf("\n");
+
+    close(fd);
+    return EXIT_SUCCESS;
+}
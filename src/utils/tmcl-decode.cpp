@@ -0,0 +1,288 @@
+#include "../capture.hpp"
+#include "../motor.hpp"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <vector>
+#include <algorithm>
+
+typedef MobSpkr::Capture::Entry Entry;
+typedef MobSpkr::Capture::Header Header;
+
+namespace TMCL = MobSpkr::TMCL;
+namespace Axis = MobSpkr::PD_1160::Axis;
+namespace Global = MobSpkr::PD_1160::Global;
+namespace Input = MobSpkr::PD_1160::Input;
+
+static char * argv0;
+
+static struct {
+    bool stats;
+    const char * port;
+} opts {
+    .stats = false,
+    .port = NULL
+};
+
+struct Name {
+    int number;
+    const char * name;
+};
+
+static const Name opcodes[] = {
+    {TMCL::ROR, "ROR"}, {TMCL::ROL, "ROL"}, {TMCL::MST, "MST"}, {TMCL::MVP, "MVP"},
+    {TMCL::SAP, "SAP"}, {TMCL::GAP, "GAP"}, {TMCL::STAP, "STAP"}, {TMCL::RSAP, "RSAP"},
+    {TMCL::SGP, "SGP"}, {TMCL::GGP, "GGP"}, {TMCL::STGP, "STGP"}, {TMCL::RSGP, "RSGP"},
+    {TMCL::RFS, "RFS"}, {TMCL::SIO, "SIO"}, {TMCL::GIO, "GIO"},
+    {TMCL::SCO, "SCO"}, {TMCL::GCO, "GCO"}, {TMCL::CCO, "CCO"},
+    {TMCL::GetVersion, "GetVersion"},
+};
+
+#define NAME(ns, param) {ns::param, #param}
+
+static const Name axis_params[] = {
+    NAME(Axis, TargetPosition), NAME(Axis, ActualPosition), NAME(Axis, TargetSpeed), NAME(Axis, ActualSpeed),
+    NAME(Axis, MaxPositioningSpeed), NAME(Axis, MaxAcceleration), NAME(Axis, MaxCurrent), NAME(Axis, StandbyCurrent),
+    NAME(Axis, TargetPositionReached), NAME(Axis, ReferenceSwitchStatus), NAME(Axis, RightLimitSwitchStatus),
+    NAME(Axis, LeftLimitSwitchStatus), NAME(Axis, RightLimitSwitchDisable), NAME(Axis, LeftLimitSwitchDisable),
+    NAME(Axis, MinimumSpeed), NAME(Axis, ActualAcceleration), NAME(Axis, RampMode), NAME(Axis, MicroStepResolution),
+    NAME(Axis, ReferenceSwitchTolerance), NAME(Axis, SoftStopFlag), NAME(Axis, EndSwitchPowerDown),
+    NAME(Axis, RampDivisor), NAME(Axis, PulseDivisor), NAME(Axis, Interpolation), NAME(Axis, DoubleStepEnable),
+    NAME(Axis, ChopperBlankTime), NAME(Axis, ChopperMode), NAME(Axis, ChopperHysteresisDecrement),
+    NAME(Axis, ChopperHysteresisEnd), NAME(Axis, ChopperHysteresisStart), NAME(Axis, ChopperOffTime),
+    NAME(Axis, SmartEnergyCurrentMinimum), NAME(Axis, SmartEnergyCurrentDownStep), NAME(Axis, SmartEnergyHysteresis),
+    NAME(Axis, SmartEnergyCurrentUpStep), NAME(Axis, SmartEnergyHysteresisStart), NAME(Axis, StallGuard2FilterEnable),
+    NAME(Axis, StallGuard2Threshold), NAME(Axis, SlopeControlHighSide), NAME(Axis, SlopeControlLowSide),
+    NAME(Axis, ShortProtectionDisable), NAME(Axis, ShortDetectionTimer), NAME(Axis, Vsense),
+    NAME(Axis, SmartEnergyActualCurrent), NAME(Axis, StopOnStall), NAME(Axis, SmartEnergyThresholdSpeed),
+    NAME(Axis, SmartEnergySlowRunCurrent), NAME(Axis, RandomChopperOffTime), NAME(Axis, ReferenceSearchMode),
+    NAME(Axis, ReferenceSearchSpeed), NAME(Axis, ReferenceSwitchSpeed), NAME(Axis, EndSwitchDistance),
+    NAME(Axis, LastReferencePosition), NAME(Axis, BoostCurrent), NAME(Axis, EncoderMode),
+    NAME(Axis, MotorFullStepResolution), NAME(Axis, FreewheelingDelay), NAME(Axis, LoadValue),
+    NAME(Axis, ExtendedErrorFlags), NAME(Axis, DriverErrorFlags), NAME(Axis, EncoderPosition),
+    NAME(Axis, EncoderResolution), NAME(Axis, MaxEncoderDeviation), NAME(Axis, PowerDownDelay),
+};
+
+static const Name global_params[] = {
+    NAME(Global, EEPROMMagic), NAME(Global, RS485BaudRate), NAME(Global, SerialAddress), NAME(Global, ASCIIMode),
+    NAME(Global, SerialHeartbeat), NAME(Global, CANBitRate), NAME(Global, CANReplyID), NAME(Global, CANID),
+    NAME(Global, ConfigurationEEPROMLock), NAME(Global, TelegramPauseTime), NAME(Global, SerialHostAddress),
+    NAME(Global, AutoStartMode), NAME(Global, EndSwitchPolarity), NAME(Global, ShutdownPinFunction),
+    NAME(Global, TMCLCodeProtection), NAME(Global, CANHeartbeat), NAME(Global, CANSecondaryAddress),
+    NAME(Global, CoordinateStorage), NAME(Global, DoNotRestoreUserVariables), NAME(Global, SerialSecondaryAddress),
+    NAME(Global, ApplicationStatus), NAME(Global, DownloadMode), NAME(Global, ProgramCounter),
+    NAME(Global, TickTimer), NAME(Global, RandomNumber), NAME(Global, SuppressReply),
+};
+
+static const Name analog_inputs[] = {
+    NAME(Input, SupplyVoltage), NAME(Input, Temperature),
+};
+
+#undef NAME
+
+template<std::size_t N>
+static const char * lookup(const Name (&names)[N], int number){
+    for(std::size_t i = 0; i < N; i++){
+        if (names[i].number == number)
+            return names[i].name;
+    }
+    return NULL;
+}
+
+static int32_t value_of(const uint8_t * frame){
+    return (int32_t)((uint32_t)frame[4] << 24 | (uint32_t)frame[5] << 16 | (uint32_t)frame[6] << 8 | frame[7]);
+}
+
+static void print_usage(FILE * out){
+    fprintf(out,
+            "Usage: %s [<options> ...] <capture>\n"
+            "Decode the TMCL exchanges captured with -C (mobspkr-vehicle-ctrl), as dumped on SIGUSR1 or /capture/dump\n"
+            "Options:\n"
+            "\t -s, --stats\t Only print per-instruction statistics\n"
+            "\t -P, --port <name>\t Only exchanges on this port\n"
+            "Examples:\n"
+            "%s -P /dev/ttyUSB0 /tmp/mobspkr-capture-1234.tmcl\n",
+            argv0, argv0);
+}
+
+static void print_entry(const Header & header, const Entry & entry){
+    const uint8_t * command = entry.command;
+    const uint8_t * response = entry.response;
+    const char * opcode = lookup(opcodes, command[MobSpkr::Motor::Command::COMMAND_NUMBER]);
+
+    int64_t unix_ns = header.unix_ns + ((int64_t)entry.written_ns - header.steady_ns);
+    time_t seconds = unix_ns / 1000000000;
+    char time[32];
+    strftime(time, sizeof(time), "%H:%M:%S", localtime(&seconds));
+
+    printf("%8llu %s.%06ld %-14s %3u ", (unsigned long long)entry.sequence.load(), time,
+           (long)(unix_ns % 1000000000 / 1000), header.ports[entry.port], command[MobSpkr::Motor::Command::ADDRESS]);
+    if (opcode)
+        printf("%-10s", opcode);
+    else
+        printf("%-10u", command[MobSpkr::Motor::Command::COMMAND_NUMBER]);
+
+    // the parameter (or input) is the type
+    uint8_t type = command[MobSpkr::Motor::Command::TYPE];
+    const char * param = NULL;
+    switch(command[MobSpkr::Motor::Command::COMMAND_NUMBER]){
+        case TMCL::SAP: case TMCL::GAP: case TMCL::STAP: case TMCL::RSAP:
+            param = lookup(axis_params, type);
+            break;
+        case TMCL::SGP: case TMCL::GGP: case TMCL::STGP: case TMCL::RSGP:
+            param = lookup(global_params, type);
+            break;
+        case TMCL::GIO:
+            if (command[MobSpkr::Motor::Command::MOTOR] == Input::ANALOG_BANK)
+                param = lookup(analog_inputs, type);
+            break;
+    }
+    if (param)
+        printf(" %-26s", param);
+    else
+        printf(" type %-21u", type);
+
+    printf(" bank %u value %11d", command[MobSpkr::Motor::Command::MOTOR], value_of(command));
+
+    if (entry.status == MobSpkr::Motor::Response::Error)
+        printf(" -> no reply");
+    else
+        printf(" -> status %3u value %11d", entry.status, value_of(response));
+
+    printf(" %6u us", entry.response_us);
+    if (entry.attempt)
+        printf(" (retry %u)", entry.attempt);
+    printf("\n");
+}
+
+static double percentile(std::vector<uint32_t> & sorted, double p){
+    if (sorted.empty())
+        return 0;
+    return sorted[std::min(sorted.size() - 1, (std::size_t)(p * sorted.size()))];
+}
+
+static void print_stats(const std::vector<const Entry *> & entries){
+    printf("%-10s %8s %8s %8s %8s %8s %8s\n", "", "count", "errors", "p50 us", "p90 us", "p99 us", "max us");
+
+    for(int opcode = 0; opcode < 256; opcode++){
+        std::vector<uint32_t> times;
+        unsigned long errors = 0;
+
+        for(const Entry * entry : entries){
+            if (entry->command[MobSpkr::Motor::Command::COMMAND_NUMBER] != opcode)
+                continue;
+            times.push_back(entry->response_us);
+            if (entry->status != MobSpkr::Motor::Response::Success && entry->status != MobSpkr::Motor::Response::CommandLoadedIntoEEPROM)
+                errors++;
+        }
+        if (times.empty())
+            continue;
+
+        std::sort(times.begin(), times.end());
+
+        const char * name = lookup(opcodes, opcode);
+        if (name)
+            printf("%-10s", name);
+        else
+            printf("%-10d", opcode);
+        printf(" %8zu %8lu %8.0f %8.0f %8.0f %8u\n", times.size(), errors,
+               percentile(times, .5), percentile(times, .9), percentile(times, .99), times.back());
+    }
+}
+
+int main(int argc, char * argv[]){
+
+    argv0 = argv[0];
+
+    int c;
+
+    while (1) {
+        int option_index = 0;
+        static struct option long_options[] = {
+                {"stats", no_argument, 0, 's'},
+                {"port", required_argument, 0, 'P'},
+                {0,         0,                 0,  0 }
+        };
+
+        c = getopt_long(argc, argv, "h?sP:",
+                        long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+            case 's': opts.stats = true; break;
+            case 'P': opts.port = optarg; break;
+
+            case 'h':
+            case '?':
+                print_usage(stdout);
+                return EXIT_SUCCESS;
+
+            default:
+                printf("?? getopt returned character code 0%o ??\n", c);
+        }
+    }
+
+    if (optind != argc - 1){
+        fprintf(stderr, "Missing capture. Try %s -h\n", argv0);
+        return EXIT_FAILURE;
+    }
+
+    // a dump, or the ring of a running (or crashed) controller
+    int fd = open(argv[optind], O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st)){
+        perror(argv[optind]);
+        return EXIT_FAILURE;
+    }
+    if ((std::size_t)st.st_size < sizeof(Header)){
+        fprintf(stderr, "%s: no capture\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+    void * map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED){
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+
+    const Header & header = *(const Header *)map;
+    if (std::memcmp(header.magic, MobSpkr::Capture::MAGIC, sizeof(header.magic)) != 0
+        || header.version != MobSpkr::Capture::VERSION || header.entry_size != sizeof(Entry)
+        || sizeof(Header) + header.entries * sizeof(Entry) > (std::size_t)st.st_size){
+        fprintf(stderr, "%s: no capture (of this version)\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    const Entry * ring = (const Entry *)((const char *)map + sizeof(Header));
+    std::vector<const Entry *> entries;
+    for(uint64_t i = 0; i < header.entries; i++){
+        if (ring[i].sequence.load() == 0 || ring[i].port >= MobSpkr::Capture::MAX_PORTS)
+            continue;
+        if (opts.port && std::strncmp(header.ports[ring[i].port], opts.port, MobSpkr::Capture::PORT_NAME_SIZE) != 0)
+            continue;
+        entries.push_back(&ring[i]);
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry * a, const Entry * b){
+        return a->sequence.load() < b->sequence.load();
+    });
+
+    if (!opts.stats){
+        for(const Entry * entry : entries)
+            print_entry(header, *entry);
+        printf("\n");
+    }
+
+    printf("%zu of %llu slots used\n", entries.size(), (unsigned long long)header.entries);
+    print_stats(entries);
+
+    munmap(map, st.st_size);
+    return EXIT_SUCCESS;
+}
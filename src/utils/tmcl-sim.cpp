@@ -0,0 +1,532 @@
+#include "../motor.hpp"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <signal.h>
+#include <getopt.h>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+
+/**
+ * Simulates PD60-3-1160 modules (TMCL over USB/RS485) on pseudo-terminals, so the controller can be run and
+ * benchmarked without drives. Each port is served by a thread of its own; a module takes <byte-usec> per byte
+ * received and sent, and <reply-usec> to process a command.
+ */
+
+#define DEFAULT_LINK        "/tmp/ttyTMCL"
+#define DEFAULT_PORTS       1
+#define DEFAULT_MODULES     1
+#define DEFAULT_BYTE_US     0
+#define DEFAULT_REPLY_US    1000
+
+#define HOST_ADDRESS        2
+#define CLOCK_HZ            16000000
+#define MAX_VELOCITY        2047
+
+// partial frames are discarded after a pause this long (as the modules do)
+#define FRAME_GAP_MS        50
+
+#define VERSION_STRING      "1160V130"
+#define VERSION_BINARY      0x04880103
+
+namespace Axis = MobSpkr::PD_1160::Axis;
+namespace Global = MobSpkr::PD_1160::Global;
+namespace Input = MobSpkr::PD_1160::Input;
+
+typedef MobSpkr::Motor::Response::Status Status;
+typedef std::chrono::steady_clock clock_type;
+
+static char * argv0;
+
+static struct {
+    int ports;
+    int modules;
+    const char * link;
+    unsigned int byte_us;
+    unsigned int reply_us;
+} opts {
+    .ports = DEFAULT_PORTS,
+    .modules = DEFAULT_MODULES,
+    .link = DEFAULT_LINK,
+    .byte_us = DEFAULT_BYTE_US,
+    .reply_us = DEFAULT_REPLY_US
+};
+
+static std::atomic<bool> running{true};
+
+static void print_usage(FILE * out){
+    fprintf(out,
+            "Usage: %s [<options> ...]\n"
+            "Simulate PD60-3-1160 modules (TMCL) on pseudo-terminals <link>0, <link>1, ..\n"
+            "Options:\n"
+            "\t -n, --ports <n>\t Number of ports (default %d)\n"
+            "\t -m, --modules <n>\t Modules per port, addressed 1 .. <n> (RS485 bus, default %d)\n"
+            "\t -l, --link <path>\t Prefix of the symlinks to the terminals (default %s)\n"
+            "\t -b, --byte <usec>\t Transmission time per byte, each way (default %d)\n"
+            "\t -r, --reply <usec>\t Processing time per command (default %d)\n"
+            "Examples:\n"
+            "%s -n 2 -b 1042 (9600 baud)\n",
+            argv0, DEFAULT_PORTS, DEFAULT_MODULES, DEFAULT_LINK, DEFAULT_BYTE_US, DEFAULT_REPLY_US, argv0);
+}
+
+static void on_signal(int signal){
+    running = false;
+}
+
+static void sleep_us(unsigned int us){
+    if (us)
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+class Module {
+
+    protected:
+
+        uint8_t m_address;
+
+        int32_t m_axis[256];
+        int32_t m_axis_eeprom[256];
+        int32_t m_global[256];
+        int32_t m_user[Global::USER_VARIABLE_COUNT];
+
+        // in microsteps, advanced on every command
+        double m_position;
+        int32_t m_velocity;
+        bool m_positioning;
+        clock_type::time_point m_updated;
+
+        // microsteps per second at the given velocity
+        double steps_per_second(int32_t velocity) const {
+            return (double)CLOCK_HZ * velocity / ((1 << m_axis[Axis::PulseDivisor]) * 2048.0 * 32.0);
+        }
+
+        void update(){
+            clock_type::time_point now = clock_type::now();
+            double dt = std::chrono::duration<double>(now - m_updated).count();
+            m_updated = now;
+
+            if (m_positioning){
+                int32_t target = m_axis[Axis::TargetPosition];
+                double step = steps_per_second(m_axis[Axis::MaxPositioningSpeed]) * dt;
+                if (std::fabs(target - m_position) <= step){
+                    m_position = target;
+                    m_velocity = 0;
+                    m_positioning = false;
+                } else {
+                    m_velocity = target > m_position ? m_axis[Axis::MaxPositioningSpeed] : -m_axis[Axis::MaxPositioningSpeed];
+                    m_position += target > m_position ? step : -step;
+                }
+            } else {
+                m_position += steps_per_second(m_velocity) * dt;
+            }
+
+            m_axis[Axis::ActualPosition] = (int32_t)std::lround(m_position);
+            m_axis[Axis::ActualSpeed] = m_velocity;
+            m_axis[Axis::TargetPositionReached] = m_positioning ? 0 : 1;
+        }
+
+        void rotate(int32_t velocity){
+            m_velocity = velocity;
+            m_axis[Axis::TargetSpeed] = velocity;
+            m_positioning = false;
+        }
+
+        void move_to(int32_t position){
+            m_axis[Axis::TargetPosition] = position;
+            m_positioning = true;
+        }
+
+    public:
+
+        Module(uint8_t address) : m_address(address), m_position(0), m_velocity(0), m_positioning(false) {
+            std::memset(m_axis, 0, sizeof(m_axis));
+            std::memset(m_global, 0, sizeof(m_global));
+            std::memset(m_user, 0, sizeof(m_user));
+
+            // power-on defaults
+            m_axis[Axis::MaxPositioningSpeed] = 1000;
+            m_axis[Axis::MaxAcceleration] = 100;
+            m_axis[Axis::MaxCurrent] = 128;
+            m_axis[Axis::StandbyCurrent] = 8;
+            m_axis[Axis::MicroStepResolution] = 8;
+            m_axis[Axis::RampDivisor] = 7;
+            m_axis[Axis::PulseDivisor] = 3;
+            m_axis[Axis::PowerDownDelay] = 200;
+            m_axis[Axis::TargetPositionReached] = 1;
+            std::memcpy(m_axis_eeprom, m_axis, sizeof(m_axis));
+
+            m_global[Global::SerialAddress] = address;
+            m_global[Global::SerialHostAddress] = HOST_ADDRESS;
+
+            m_updated = clock_type::now();
+        }
+
+        uint8_t get_address() const { return m_address; }
+
+        /**
+         * Executes a command, returns the status, value as replied.
+         */
+        int execute(uint8_t opcode, uint8_t type, uint8_t bank, int32_t & value){
+            update();
+
+            switch(opcode){
+                case MobSpkr::TMCL::ROR:
+                case MobSpkr::TMCL::ROL:
+                    if (value < -MAX_VELOCITY || MAX_VELOCITY < value)
+                        return Status::InvalidValue;
+                    rotate(opcode == MobSpkr::TMCL::ROR ? value : -value);
+                    return Status::Success;
+
+                case MobSpkr::TMCL::MST:
+                    rotate(0);
+                    return Status::Success;
+
+                case MobSpkr::TMCL::MVP:
+                    if (type == 0)
+                        move_to(value);
+                    else if (type == 1)
+                        move_to(m_axis[Axis::ActualPosition] + value);
+                    else
+                        return Status::WrongType;
+                    return Status::Success;
+
+                case MobSpkr::TMCL::SAP:
+                    if (bank != 0)
+                        return Status::InvalidValue;
+                    if (type == Axis::ActualPosition)
+                        m_position = value;
+                    else if (type == Axis::TargetSpeed)
+                        rotate(value);
+                    else if (type == Axis::TargetPosition)
+                        move_to(value);
+                    m_axis[type] = value;
+                    update();
+                    return Status::Success;
+
+                case MobSpkr::TMCL::GAP:
+                    if (bank != 0)
+                        return Status::InvalidValue;
+                    value = m_axis[type];
+                    return Status::Success;
+
+                case MobSpkr::TMCL::STAP:
+                    m_axis_eeprom[type] = m_axis[type];
+                    return Status::Success;
+
+                case MobSpkr::TMCL::RSAP:
+                    m_axis[type] = m_axis_eeprom[type];
+                    return Status::Success;
+
+                case MobSpkr::TMCL::SGP:
+                case MobSpkr::TMCL::STGP:
+                case MobSpkr::TMCL::RSGP:
+                    if (bank == Global::USER_VARIABLE_BANK){
+                        if (type >= Global::USER_VARIABLE_COUNT)
+                            return Status::WrongType;
+                        if (opcode == MobSpkr::TMCL::SGP)
+                            m_user[type] = value;
+                    } else if (opcode == MobSpkr::TMCL::SGP){
+                        m_global[type] = value;
+                    }
+                    return Status::Success;
+
+                case MobSpkr::TMCL::GGP:
+                    if (bank == Global::USER_VARIABLE_BANK){
+                        if (type >= Global::USER_VARIABLE_COUNT)
+                            return Status::WrongType;
+                        value = m_user[type];
+                    } else {
+                        value = m_global[type];
+                    }
+                    return Status::Success;
+
+                case MobSpkr::TMCL::SIO:
+                    return Status::Success;
+
+                case MobSpkr::TMCL::GIO:
+                    if (bank == Input::ANALOG_BANK && type == Input::SupplyVoltage)
+                        value = 240;
+                    else if (bank == Input::ANALOG_BANK && type == Input::Temperature)
+                        value = 35;
+                    else
+                        value = 0;
+                    return Status::Success;
+
+                case MobSpkr::TMCL::GetVersion:
+                    value = VERSION_BINARY;
+                    return Status::Success;
+
+                default:
+                    return Status::InvalidCommand;
+            }
+        }
+};
+
+class Port {
+
+    protected:
+
+        std::string m_link;
+        int m_master;
+        int m_slave;
+        std::vector<Module> m_modules;
+
+        std::thread m_thread;
+        unsigned long m_commands;
+        unsigned long m_checksum_errors;
+
+        void write_paced(const uint8_t * bytes, std::size_t length){
+            for(std::size_t i = 0; i < length; ){
+                // at line speed, or all at once
+                std::size_t chunk = opts.byte_us ? 1 : length - i;
+                sleep_us(opts.byte_us);
+                ssize_t n = ::write(m_master, bytes + i, chunk);
+                if (n < 0){
+                    if (errno == EINTR || errno == EAGAIN)
+                        continue;
+                    return;
+                }
+                i += n;
+            }
+        }
+
+        void reply(uint8_t address, uint8_t status, uint8_t opcode, int32_t value){
+            uint8_t bytes[MobSpkr::TMCL::FRAME_SIZE] = {
+                HOST_ADDRESS, address, status, opcode,
+                (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value, 0
+            };
+            for(int i = 0; i < MobSpkr::TMCL::FRAME_SIZE - 1; i++)
+                bytes[MobSpkr::TMCL::FRAME_SIZE - 1] += bytes[i];
+
+            write_paced(bytes, sizeof(bytes));
+        }
+
+        void process(const uint8_t * frame){
+            Module * module = NULL;
+            for(Module & m : m_modules){
+                if (m.get_address() == frame[0])
+                    module = &m;
+            }
+            // someone else's on a bus
+            if (module == NULL)
+                return;
+
+            m_commands++;
+            sleep_us(opts.reply_us);
+
+            uint8_t checksum = 0;
+            for(int i = 0; i < MobSpkr::TMCL::FRAME_SIZE - 1; i++)
+                checksum += frame[i];
+            if (checksum != frame[MobSpkr::TMCL::FRAME_SIZE - 1]){
+                m_checksum_errors++;
+                reply(frame[0], Status::WrongChecksum, frame[1], 0);
+                return;
+            }
+
+            uint8_t opcode = frame[1];
+            int32_t value = (int32_t)((uint32_t)frame[4] << 24 | (uint32_t)frame[5] << 16 | (uint32_t)frame[6] << 8 | frame[7]);
+
+            // the only reply that is not a status frame
+            if (opcode == MobSpkr::TMCL::GetVersion && frame[2] == 0){
+                uint8_t bytes[MobSpkr::TMCL::FRAME_SIZE] = {HOST_ADDRESS};
+                std::memcpy(bytes + 1, VERSION_STRING, MobSpkr::TMCL::FRAME_SIZE - 1);
+                write_paced(bytes, sizeof(bytes));
+                return;
+            }
+
+            int status = module->execute(opcode, frame[2], frame[3], value);
+            reply(frame[0], status, opcode, value);
+        }
+
+        void run(){
+            uint8_t frame[MobSpkr::TMCL::FRAME_SIZE];
+            std::size_t received = 0;
+            clock_type::time_point last = clock_type::now();
+
+            while(running){
+                struct pollfd pfd = {m_master, POLLIN, 0};
+                if (::poll(&pfd, 1, 100) <= 0)
+                    continue;
+
+                uint8_t buffer[64];
+                ssize_t n = ::read(m_master, buffer, sizeof(buffer));
+                if (n <= 0)
+                    continue;
+
+                clock_type::time_point now = clock_type::now();
+                if (received && now - last > std::chrono::milliseconds(FRAME_GAP_MS))
+                    received = 0;
+                last = now;
+
+                for(ssize_t i = 0; i < n; i++){
+                    frame[received++] = buffer[i];
+                    if (received < MobSpkr::TMCL::FRAME_SIZE)
+                        continue;
+                    received = 0;
+
+                    sleep_us(opts.byte_us * MobSpkr::TMCL::FRAME_SIZE);
+                    process(frame);
+                }
+            }
+        }
+
+    public:
+
+        Port(std::string link, int modules) : m_link(std::move(link)), m_master(-1), m_slave(-1), m_commands(0), m_checksum_errors(0) {
+            for(int a = 1; a <= modules; a++)
+                m_modules.push_back(Module(a));
+        }
+
+        ~Port(){
+            if (m_thread.joinable())
+                m_thread.join();
+            if (m_slave >= 0)
+                ::close(m_slave);
+            if (m_master >= 0)
+                ::close(m_master);
+            unlink(m_link.c_str());
+        }
+
+        bool open(){
+            m_master = posix_openpt(O_RDWR | O_NOCTTY);
+            if (m_master < 0 || grantpt(m_master) || unlockpt(m_master))
+                return false;
+
+            const char * name = ptsname(m_master);
+            if (name == NULL)
+                return false;
+
+            // held open, or reading fails (EIO) whenever the controller has closed the port
+            m_slave = ::open(name, O_RDWR | O_NOCTTY);
+            if (m_slave < 0)
+                return false;
+
+            struct termios tio;
+            if (tcgetattr(m_slave, &tio))
+                return false;
+            cfmakeraw(&tio);
+            if (tcsetattr(m_slave, TCSANOW, &tio))
+                return false;
+
+            unlink(m_link.c_str());
+            if (symlink(name, m_link.c_str()))
+                return false;
+
+            return true;
+        }
+
+        void start(){
+            m_thread = std::thread(&Port::run, this);
+        }
+
+        const std::string & get_link() const { return m_link; }
+        unsigned long get_commands() const { return m_commands; }
+        unsigned long get_checksum_errors() const { return m_checksum_errors; }
+};
+
+int main(int argc, char * argv[]){
+
+    argv0 = argv[0];
+
+    int c;
+
+    while (1) {
+        int option_index = 0;
+        static struct option long_options[] = {
+                {"ports", required_argument, 0, 'n'},
+                {"modules", required_argument, 0, 'm'},
+                {"link", required_argument, 0, 'l'},
+                {"byte", required_argument, 0, 'b'},
+                {"reply", required_argument, 0, 'r'},
+                {0,         0,                 0,  0 }
+        };
+
+        c = getopt_long(argc, argv, "h?n:m:l:b:r:",
+                        long_options, &option_index);
+        if (c == -1)
+            break;
+
+        switch (c) {
+
+            case 'n':
+                opts.ports = std::atoi(optarg);
+                if (opts.ports < 1){
+                    fprintf(stderr, "invalid number of ports: %s\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'm':
+                opts.modules = std::atoi(optarg);
+                if (opts.modules < 1 || 255 < opts.modules){
+                    fprintf(stderr, "invalid number of modules: %s (1 - 255)\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'l':
+                opts.link = optarg;
+                break;
+
+            case 'b':
+                opts.byte_us = std::atoi(optarg);
+                break;
+
+            case 'r':
+                opts.reply_us = std::atoi(optarg);
+                break;
+
+            case 'h':
+            case '?':
+                print_usage(stdout);
+                return EXIT_SUCCESS;
+
+            default:
+                printf("?? getopt returned character code 0%o ??\n", c);
+        }
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    std::vector<Port *> ports;
+    for(int i = 0; i < opts.ports; i++){
+        Port * port = new Port(std::string(opts.link) + std::to_string(i), opts.modules);
+        ports.push_back(port);
+
+        if (!port->open()){
+            fprintf(stderr, "failed to open %s: %s\n", port->get_link().c_str(), strerror(errno));
+            running = false;
+            break;
+        }
+        printf("%s\n", port->get_link().c_str());
+    }
+
+    if (running){
+        for(Port * port : ports)
+            port->start();
+
+        printf("ready\n");
+        fflush(stdout);
+
+        while(running)
+            pause();
+    }
+
+    for(Port * port : ports){
+        fprintf(stderr, "%s: %lu commands, %lu checksum errors\n", port->get_link().c_str(), port->get_commands(), port->get_checksum_errors());
+        delete port;
+    }
+
+    return EXIT_SUCCESS;
+}